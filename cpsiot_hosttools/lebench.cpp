@@ -0,0 +1,359 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Sweep network size, K, T and topology over the simulator and write the
+ *          results as CSV and JSON. Node rows use the master's columns, so they
+ *          line up with testbed runs; run rows and per-setting means come after.
+ *
+ * Usage: lebench [-n <sizes>] [-k <Ks>] [-T <Ts>] [-t <topologies>] [-r <reps>]
+ *                [-L <loss%s>] [-s <seed>] [-p <threads>] [-o <prefix>] [-f csv|json|both]
+ *
+ *        Lists are comma separated or min:max:step, T is in seconds as in
+ *        generate_binaries.sh. Topologies are line, ring, tree, mesh, grid,
+ *        gen (a random geometric overlay in gen mode) and file:<edge list>.
+ *        Loss is swept too, the other impairments of lesim apply to every run.
+ */
+
+// Standard C++ includes
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "simcore.h"
+
+// one finished run
+struct Run {
+    int n;
+    int k;
+    double t;
+    double loss;
+    std::string topology;
+    int rep;
+    uint64_t seed;
+    RunResult res;
+};
+
+static void usage(void) {
+    std::cerr << "Usage: lebench [options]\n"
+              << "  -n  network sizes, 10,50,100 by default\n"
+              << "  -k  rounds K, 5,10 by default\n"
+              << "  -T  round periods T in seconds, 0.11 by default\n"
+              << "  -t  topologies, line,ring,tree,mesh,gen by default\n"
+              << "  -L  link loss in %, 0 by default\n"
+              << "  -B, -D, -U, -O  burst loss, delay, duplication and reordering, as in lesim\n"
+              << "  -r  repetitions of every setting, 3 by default\n"
+              << "  -d  mean degree of gen, 8 by default\n"
+              << "  -s  seed of the first repetition, 1 by default\n"
+              << "  -p  simulator threads, 1 by default\n"
+              << "  -o  output prefix, lebench by default, writes <prefix>.csv,\n"
+              << "      <prefix>_runs.csv and <prefix>.json\n"
+              << "  -f  csv, json or both (default)\n"
+              << "  lists are comma separated or min:max:step\n";
+    exit(1);
+}
+
+// Purpose: parse "a,b,c" or "min:max:step"
+//
+// arg string, the list
+// out vector<double>&, receives the values
+// return false if it doesn't parse
+static bool parseList(const std::string &arg, std::vector<double> &out) {
+    double lo, hi, step;
+    char end;
+
+    out.clear();
+    if (sscanf(arg.c_str(), "%lf:%lf:%lf%c", &lo, &hi, &step, &end) == 3) {
+        if (step <= 0 || hi < lo) {
+            return false;
+        }
+        // a little slack so 0.3:2.0:0.1 ends on 2.0
+        for (int i = 0; lo + i * step <= hi + step * 1e-6; i++) {
+            out.push_back(lo + i * step);
+        }
+        return true;
+    }
+
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        char *e;
+        double v = strtod(item.c_str(), &e);
+        if (item.empty() || *e != '\0') {
+            return false;
+        }
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+// Purpose: split a comma separated list of names
+//
+// arg string, the list
+// return the names
+static std::vector<std::string> parseNames(const std::string &arg) {
+    std::vector<std::string> out;
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            out.push_back(item);
+        }
+    }
+    return out;
+}
+
+// Purpose: quote a string for JSON, names here never hold control characters
+//
+// s string, the string
+static std::string jsonString(const std::string &s) {
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            q += '\\';
+        }
+        q += c;
+    }
+    return q + "\"";
+}
+
+// Purpose: write the node rows and the run rows
+//
+// prefix string, output prefix
+// runs vector<Run>&, the runs
+// return false if a file can't be written
+static bool writeCsv(const std::string &prefix, const std::vector<Run> &runs) {
+    std::string path = prefix + ".csv";
+    FILE *f = fopen(path.c_str(), "w");
+    char addr[LE_ADDR_LEN], leader[LE_ADDR_LEN];
+
+    if (f == NULL) {
+        std::cerr << "lebench: can't write " << path << "\n";
+        return false;
+    }
+    fprintf(f, "n,K,T,loss,topology,rep,seed,node,m,elected,correct,startTime,runTime,messages,degree\n");
+    for (const Run &run : runs) {
+        for (size_t i = 0; i < run.res.node.size(); i++) {
+            const NodeResult &nr = run.res.node[i];
+            simAddr((int)i, addr);
+            simAddr(nr.leader, leader);
+            fprintf(f, "%d,%d,%g,%g,%s,%d,%" PRIu64 ",%s,%" PRIu32 ",%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu32 ",%d\n",
+                    run.n, run.k, run.t, run.loss, run.topology.c_str(), run.rep, run.seed, addr, nr.m, leader,
+                    nr.correct ? "yes" : "no", nr.startUs, nr.converged ? nr.endUs - nr.startUs : 0,
+                    nr.msgsIn + nr.msgsOut, nr.degree);
+        }
+    }
+    fclose(f);
+
+    path = prefix + "_runs.csv";
+    f = fopen(path.c_str(), "w");
+    if (f == NULL) {
+        std::cerr << "lebench: can't write " << path << "\n";
+        return false;
+    }
+    fprintf(f, "n,K,T,loss,topology,rep,seed,nodes,converged,correct,leaders,globalTime,meanRunTime,messages,messagesPerNode,lost,wallTime\n");
+    for (const Run &run : runs) {
+        const RunResult &r = run.res;
+        fprintf(f, "%d,%d,%g,%g,%s,%d,%" PRIu64 ",%d,%d,%d,%d,%" PRIu64 ",%.0f,%" PRIu64 ",%.2f,%" PRIu64 ",%.4f\n",
+                run.n, run.k, run.t, run.loss, run.topology.c_str(), run.rep, run.seed, r.nodes, r.converged,
+                r.correct, r.leaders, r.globalUs, r.meanUs, r.messages, (double)r.messages / r.nodes, r.lost,
+                r.wallSec);
+    }
+    fclose(f);
+    return true;
+}
+
+// Purpose: write the runs and the means of every setting as JSON
+//
+// prefix string, output prefix
+// runs vector<Run>&, the runs
+// return false if the file can't be written
+static bool writeJson(const std::string &prefix, const std::vector<Run> &runs) {
+    std::string path = prefix + ".json";
+    FILE *f = fopen(path.c_str(), "w");
+
+    if (f == NULL) {
+        std::cerr << "lebench: can't write " << path << "\n";
+        return false;
+    }
+    fprintf(f, "{\n  \"runs\": [\n");
+    for (size_t i = 0; i < runs.size(); i++) {
+        const Run &run = runs[i];
+        const RunResult &r = run.res;
+        fprintf(f, "    {\"n\": %d, \"K\": %d, \"T\": %g, \"loss\": %g, \"topology\": %s, \"rep\": %d, "
+                   "\"seed\": %" PRIu64 ", \"nodes\": %d, \"converged\": %d, \"correct\": %d, \"leaders\": %d, "
+                   "\"globalTime\": %" PRIu64 ", \"meanRunTime\": %.0f, \"messages\": %" PRIu64 ", "
+                   "\"messagesPerNode\": %.2f, \"lost\": %" PRIu64 ", \"wallTime\": %.4f}%s\n",
+                run.n, run.k, run.t, run.loss, jsonString(run.topology).c_str(), run.rep, run.seed, r.nodes,
+                r.converged, r.correct, r.leaders, r.globalUs, r.meanUs, r.messages, (double)r.messages / r.nodes,
+                r.lost, r.wallSec, (i + 1 < runs.size()) ? "," : "");
+    }
+    fprintf(f, "  ],\n  \"settings\": [\n");
+
+    // repetitions of a setting are consecutive
+    bool first = true;
+    for (size_t i = 0; i < runs.size(); ) {
+        size_t j = i;
+        double sumG = 0, sumG2 = 0, sumM = 0, sumR = 0;
+        int ok = 0;
+        while (j < runs.size() && runs[j].n == runs[i].n && runs[j].k == runs[i].k &&
+               runs[j].t == runs[i].t && runs[j].loss == runs[i].loss && runs[j].topology == runs[i].topology) {
+            const RunResult &r = runs[j].res;
+            sumG += r.globalUs;
+            sumG2 += (double)r.globalUs * r.globalUs;
+            sumM += (double)r.messages;
+            sumR += r.meanUs;
+            ok += (r.correct == r.nodes);
+            j++;
+        }
+        int reps = (int)(j - i);
+        double meanG = sumG / reps;
+        double sdG = (reps > 1) ? sqrt(std::max(0.0, (sumG2 - reps * meanG * meanG) / (reps - 1))) : 0;
+        fprintf(f, "%s    {\"n\": %d, \"K\": %d, \"T\": %g, \"loss\": %g, \"topology\": %s, \"reps\": %d, "
+                   "\"correctRuns\": %d, \"globalTime\": %.0f, \"globalTimeStdDev\": %.0f, \"meanRunTime\": %.0f, "
+                   "\"messages\": %.1f, \"messagesPerNode\": %.2f}",
+                first ? "" : ",\n", runs[i].n, runs[i].k, runs[i].t, runs[i].loss, jsonString(runs[i].topology).c_str(),
+                reps, ok,
+                meanG, sdG, sumR / reps, sumM / reps, sumM / reps / runs[i].n);
+        first = false;
+        i = j;
+    }
+    fprintf(f, "\n  ]\n}\n");
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::vector<double> sizes = { 10, 50, 100 }, ks = { 5, 10 }, ts = { 0.11 }, losses = { 0 };
+    impair_conf_t impair = {};
+    std::vector<std::string> topologies = { "line", "ring", "tree", "mesh", "gen" };
+    int reps = 3;
+    double degree = 8;
+    uint64_t seed = 1;
+    int threads = 1;
+    std::string prefix = "lebench", format = "both";
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool more = (i+1 < argc);
+        bool ok = true;
+        if (arg == "-n" && more) {
+            ok = parseList(argv[++i], sizes);
+        } else if (arg == "-k" && more) {
+            ok = parseList(argv[++i], ks);
+        } else if (arg == "-T" && more) {
+            ok = parseList(argv[++i], ts);
+        } else if (arg == "-L" && more) {
+            ok = parseList(argv[++i], losses);
+        } else if ((arg == "-B" || arg == "-D" || arg == "-U" || arg == "-O") && more) {
+            static const char *names[] = { "ge", "delay", "dup", "reorder" };
+            ok = parseImpair(names[std::string("BDUO").find(arg[1])], argv[++i], impair);
+        } else if (arg == "-t" && more) {
+            topologies = parseNames(argv[++i]);
+            ok = !topologies.empty();
+        } else if (arg == "-r" && more) {
+            reps = atoi(argv[++i]);
+        } else if (arg == "-d" && more) {
+            degree = atof(argv[++i]);
+        } else if (arg == "-s" && more) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (arg == "-p" && more) {
+            threads = atoi(argv[++i]);
+        } else if (arg == "-o" && more) {
+            prefix = argv[++i];
+        } else if (arg == "-f" && more) {
+            format = argv[++i];
+            ok = (format == "csv" || format == "json" || format == "both");
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            usage();
+        }
+    }
+    if (reps < 1 || threads < 1) {
+        usage();
+    }
+
+    std::vector<Run> runs;
+    std::set<std::string> skipped;
+    printf("%6s %4s %6s %6s %-8s %5s %10s %10s %10s %8s\n",
+           "n", "K", "T", "loss%", "topology", "ok", "global(s)", "mean(s)", "msgs", "msgs/n");
+    for (const std::string &topoName : topologies) {
+        bool gen = (topoName == "gen");
+        std::string spec = gen ? "rgg" : topoName;
+        for (double nv : sizes) {
+            for (double kv : ks) {
+                for (double tv : ts) {
+                    for (double lv : losses) {
+                        int n = (int)nv;
+                        size_t firstRun = runs.size();
+                        for (int rep = 0; rep < reps; rep++) {
+                            Topology topo;
+                            std::string err;
+                            if (!buildTopology(spec, n, degree, seed + rep, topo, err)) {
+                                if (skipped.insert(err).second) {
+                                    std::cerr << "lebench: " << topoName << " n=" << n << " skipped, " << err << "\n";
+                                }
+                                break;
+                            }
+
+                            // the worker's defaults, trickle in gen mode
+                            SimConf conf;
+                            conf.le.rounds = (int)kv;
+                            conf.le.period = (uint32_t)(tv * 1000000);
+                            conf.le.clusterHops = 0;
+                            conf.le.trickle = gen;
+                            conf.le.trickleImin = conf.le.period / 4;
+                            conf.le.trickleDoublings = 8;
+                            conf.le.trickleK = 2;
+                            conf.gen = gen;
+                            conf.seed = seed + rep;
+                            conf.shards = threads;
+                            conf.impair = impair;
+                            if (!parseImpair("loss", std::to_string(lv), conf.impair)) {
+                                std::cerr << "lebench: bad loss " << lv << "\n";
+                                return 1;
+                            }
+
+                            Simulator sim(topo, conf);
+                            runs.push_back({ (int)topo.adj.size(), (int)kv, tv, lv, topoName, rep, conf.seed, sim.run() });
+                        }
+                        if (runs.size() == firstRun) {
+                            continue;
+                        }
+
+                        int ok = 0;
+                        double g = 0, m = 0, msgs = 0;
+                        for (size_t i = firstRun; i < runs.size(); i++) {
+                            const RunResult &r = runs[i].res;
+                            ok += (r.correct == r.nodes);
+                            g += r.globalUs / 1e6;
+                            m += r.meanUs / 1e6;
+                            msgs += (double)r.messages;
+                        }
+                        int done = (int)(runs.size() - firstRun);
+                        printf("%6d %4d %6g %6g %-8s %2d/%-2d %10.3f %10.3f %10.0f %8.1f\n",
+                               runs.back().n, (int)kv, tv, lv, topoName.c_str(), ok, done, g / done, m / done,
+                               msgs / done, msgs / done / runs.back().n);
+                        fflush(stdout);
+                    }
+                }
+            }
+        }
+    }
+
+    bool written = true;
+    if (format == "csv" || format == "both") {
+        written = writeCsv(prefix, runs) && written;
+    }
+    if (format == "json" || format == "both") {
+        written = writeJson(prefix, runs) && written;
+    }
+    return written ? 0 : 1;
+}
@@ -0,0 +1,418 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Time the worker's hot primitives on the host at neighbor counts from
+ *          a handful to the thousand the simulator goes up to: parsing messages,
+ *          finding a neighbor, the address tie-break, building le_ack and the
+ *          round reduction. One operation is what a node does with n neighbors:
+ *          an ips message listing them, or one le_ack, lookup, tie-break or
+ *          build for each of them, or one round. Reports ns per operation, per
+ *          neighbor and the bytes the operation allocated, so a change to a data
+ *          structure or the codec can be argued with numbers.
+ *
+ * Usage: lemicro [-n <counts>] [-b <benchmarks>] [-t <ms>] [-o <csv>]
+ */
+
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "le_engine.h"
+#include "lecodec.h"
+
+#define MSG_LEN                 (64)        // room for one le_ack
+#define ADDR_BUF_LEN            (46)        // as the worker parses into
+
+// Allocation counting, every malloc in the timed loop is added up. glibc lets
+// a program replace malloc and still reach its own.
+static bool counting = false;
+static uint64_t allocBytes = 0;
+static uint64_t allocCalls = 0;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+extern "C" void *malloc(size_t size) {
+    if (counting) {
+        allocBytes += size;
+        allocCalls++;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size) {
+    if (counting) {
+        allocBytes += n * size;
+        allocCalls++;
+    }
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) {
+    if (counting) {
+        allocBytes += size;
+        allocCalls++;
+    }
+    return __libc_realloc(p, size);
+}
+#endif
+
+// what every benchmark at one neighbor count works on
+struct Fixture {
+    int n = 0;
+    std::vector<std::string> addr;      // the neighbors, as the master hands out suffixes
+    std::vector<int> order;             // the order their messages come in
+    std::string ips;                    // ips;<addr>;...; listing all of them
+    std::vector<std::string> acks;      // an le_ack from each of them
+    le_engine_t *eng = NULL;            // knows all of them, every one has a value
+    uint32_t now = 0;
+    uint64_t sink = 0;                  // results go here so nothing is optimized away
+};
+
+static void noSend(le_engine_t *e, const char *to, const le_msg_t *msg) {
+    (void)to;
+    ((Fixture *)e->ctx)->sink += msg->m;
+}
+
+static uint32_t noRandom(le_engine_t *e) {
+    (void)e;
+    return 0;
+}
+
+// Purpose: build the fixture for n neighbors
+//
+// f Fixture&, receives it
+// n int, neighbors
+// seed uint32_t, for the m values and the order
+static void setUp(Fixture &f, int n, uint32_t seed) {
+    static const le_engine_ops_t ops = { noSend, NULL, noRandom, NULL };
+    std::mt19937 rng(seed);
+    char buf[32];
+
+    f.n = n;
+    f.addr.clear();
+    f.order.clear();
+    f.acks.clear();
+    f.ips = "ips;";
+    for (int i = 0; i < n; i++) {
+        // same prefix as iot-lab nodes, so comparisons run to the last group
+        snprintf(buf, sizeof(buf), "1711:6b10:65fa:%04x", 0x1000 + i);
+        f.addr.push_back(buf);
+        f.order.push_back(i);
+        f.ips += f.addr.back() + ";";
+    }
+    std::shuffle(f.order.begin(), f.order.end(), rng);
+
+    le_engine_conf_t conf = {};
+    conf.rounds = 1 << 30;              // never converges, every round reduces
+    conf.period = 110000;
+    if (f.eng == NULL) {
+        f.eng = new le_engine_t;
+    }
+    le_engine_init(f.eng, &conf, &ops, &f);
+    le_engine_set_identity(f.eng, 255, "1711:6b10:65fa:ffff");
+    for (int i = 0; i < n; i++) {
+        uint32_t m = 1 + rng() % 254;
+        int hops = 1 + (int)(rng() % 8);
+        const std::string &leader = f.addr[rng() % n];
+        le_engine_add_neighbor(f.eng, f.addr[i].c_str());
+        le_engine_on_ack(f.eng, 0, f.addr[i].c_str(), m, leader.c_str(), hops);
+
+        char msg[MSG_LEN];
+        buildLeAck(msg, m, leader.c_str(), hops);
+        f.acks.push_back(msg);
+    }
+    le_engine_start(f.eng, 0);
+    f.eng->state = LE_STATE_ROUND;
+    f.now = 0;
+}
+
+// Purpose: parse an ips message the way the worker does
+static void benchParseIps(Fixture &f) {
+    static char msgP[32768];
+    char codeBuf[ADDR_BUF_LEN];
+    char IPv6_2[ADDR_BUF_LEN];
+
+    strcpy(msgP, f.ips.c_str());
+    char *mem = msgP;
+    extractMsgSegment(&mem, codeBuf);
+    while (strlen(mem) > 1) {
+        memset(IPv6_2, 0, ADDR_BUF_LEN);
+        extractMsgSegment(&mem, IPv6_2);
+        f.sink += (uint8_t)IPv6_2[18];
+    }
+}
+
+// Purpose: parse an le_ack from every neighbor the way the worker does
+static void benchParseAck(Fixture &f) {
+    char msgP[MSG_LEN];
+    char codeBuf[ADDR_BUF_LEN];
+    char mStr[5];
+    char IPv6_2[ADDR_BUF_LEN];
+
+    for (int i = 0; i < f.n; i++) {
+        strcpy(msgP, f.acks[f.order[i]].c_str());
+        char *mem = msgP;
+        memset(IPv6_2, 0, ADDR_BUF_LEN);
+        memset(mStr, 0, 5);
+
+        extractMsgSegment(&mem, codeBuf);
+        extractMsgSegment(&mem, mStr);
+        extractMsgSegment(&mem, IPv6_2);
+        int hops = 0;
+        if (strlen(mem) > 1) {
+            extractMsgSegment(&mem, codeBuf);
+            hops = atoi(codeBuf);
+        }
+        f.sink += (uint32_t)atoi(mStr) + (uint32_t)hops + (uint8_t)IPv6_2[18];
+    }
+}
+
+// Purpose: find the sender of every neighbor's message
+static void benchLookup(Fixture &f) {
+    for (int i = 0; i < f.n; i++) {
+        f.sink += (uint32_t)le_engine_find_neighbor(f.eng, f.addr[f.order[i]].c_str());
+    }
+}
+
+// Purpose: break a tie against every neighbor with minIPv6
+static void benchMinIPv6(Fixture &f) {
+    for (int i = 0; i < f.n; i++) {
+        f.sink += (uint32_t)minIPv6((char *)f.addr[f.order[i]].c_str(), (char *)f.addr[i].c_str());
+    }
+}
+
+// Purpose: break a tie against every neighbor with strcmp, as the engine does
+static void benchStrcmp(Fixture &f) {
+    for (int i = 0; i < f.n; i++) {
+        f.sink += (uint32_t)strcmp(f.addr[f.order[i]].c_str(), f.addr[i].c_str());
+    }
+}
+
+// Purpose: build an le_ack for every neighbor, with the hop count of cluster mode
+static void benchBuildAck(Fixture &f) {
+    char msg[MSG_LEN];
+    for (int i = 0; i < f.n; i++) {
+        buildLeAck(msg, (uint32_t)(1 + i % 254), f.addr[f.order[i]].c_str(), i % 8);
+        f.sink += (uint8_t)msg[9];
+    }
+}
+
+// Purpose: end one round, the reduction over every neighbor's value
+static void benchReduce(Fixture &f) {
+    f.now += f.eng->conf.period + 1;
+    f.sink += (uint32_t)le_engine_tick(f.eng, f.now);
+}
+
+// one benchmark
+struct Bench {
+    const char *name;
+    void (*run)(Fixture &f);
+    const char *what;
+};
+
+static const Bench benches[] = {
+    { "parse_ips", benchParseIps, "extractMsgSegment over an ips message listing n neighbors" },
+    { "parse_ack", benchParseAck, "extractMsgSegment over n le_acks" },
+    { "lookup", benchLookup, "le_engine_find_neighbor for n senders" },
+    { "minipv6", benchMinIPv6, "minIPv6 tie-break against n neighbors" },
+    { "strcmp", benchStrcmp, "strcmp tie-break against n neighbors, as the engine does" },
+    { "build_ack", benchBuildAck, "buildLeAck for n neighbors" },
+    { "reduce", benchReduce, "one round's reduction, le_engine_tick over n neighbors" },
+};
+
+// one measurement
+struct Result {
+    uint64_t iters;
+    double nsOp;
+    double bytesOp;
+    double allocsOp;
+};
+
+// Purpose: run a benchmark a number of times
+//
+// b Bench&, the benchmark
+// f Fixture&, its fixture
+// iters uint64_t, how many operations
+// return the seconds it took
+static double timeIt(const Bench &b, Fixture &f, uint64_t iters) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < iters; i++) {
+        b.run(f);
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Purpose: measure a benchmark for about the target time
+//
+// b Bench&, the benchmark
+// f Fixture&, its fixture
+// target double, seconds
+static Result measure(const Bench &b, Fixture &f, double target) {
+    // warm up and grow the count until a run is long enough to scale from
+    uint64_t iters = 1;
+    double t = timeIt(b, f, iters);
+    while (t < target / 20 && iters < (1ULL << 40)) {
+        iters *= 4;
+        t = timeIt(b, f, iters);
+    }
+    iters = (uint64_t)(iters * target / (t > 0 ? t : 1e-9)) + 1;
+
+    allocBytes = 0;
+    allocCalls = 0;
+    counting = true;
+    t = timeIt(b, f, iters);
+    counting = false;
+
+    Result r;
+    r.iters = iters;
+    r.nsOp = t * 1e9 / iters;
+    r.bytesOp = (double)allocBytes / iters;
+    r.allocsOp = (double)allocCalls / iters;
+    return r;
+}
+
+// Purpose: parse "a,b,c" or "min:max:step"
+//
+// arg string, the list
+// out vector<int>&, receives the values
+// return false if it doesn't parse
+static bool parseCounts(const std::string &arg, std::vector<int> &out) {
+    int lo, hi, step;
+    char end;
+
+    out.clear();
+    if (sscanf(arg.c_str(), "%d:%d:%d%c", &lo, &hi, &step, &end) == 3) {
+        if (step <= 0 || hi < lo) {
+            return false;
+        }
+        for (int v = lo; v <= hi; v += step) {
+            out.push_back(v);
+        }
+    } else {
+        std::stringstream ss(arg);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            out.push_back(atoi(item.c_str()));
+        }
+    }
+    for (int v : out) {
+        if (v < 1 || v > LE_MAX_NEIGHBORS) {
+            return false;
+        }
+    }
+    return !out.empty();
+}
+
+static void usage(void) {
+    std::cerr << "Usage: lemicro [options]\n"
+              << "  -n  neighbor counts, 2,5,10,20,50,100,200,500,1000 by default, up to "
+              << LE_MAX_NEIGHBORS << "\n"
+              << "  -b  benchmarks, all by default:\n";
+    for (const Bench &b : benches) {
+        std::cerr << "        " << b.name << ", " << b.what << "\n";
+    }
+    std::cerr << "  -t  ms to spend on each measurement, 200 by default\n"
+              << "  -o  also write the results to this CSV file\n"
+              << "  lists are comma separated or min:max:step\n";
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> counts = { 2, 5, 10, 20, 50, 100, 200, 500, 1000 };
+    std::vector<const Bench *> chosen;
+    double target = 0.2;
+    std::string csvPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool more = (i+1 < argc);
+        if (arg == "-n" && more) {
+            if (!parseCounts(argv[++i], counts)) {
+                usage();
+            }
+        } else if (arg == "-b" && more) {
+            std::stringstream ss(argv[++i]);
+            std::string name;
+            while (std::getline(ss, name, ',')) {
+                const Bench *found = NULL;
+                for (const Bench &b : benches) {
+                    if (name == b.name) {
+                        found = &b;
+                    }
+                }
+                if (found == NULL) {
+                    std::cerr << "lemicro: no benchmark " << name << "\n";
+                    usage();
+                }
+                chosen.push_back(found);
+            }
+        } else if (arg == "-t" && more) {
+            target = atof(argv[++i]) / 1000;
+        } else if (arg == "-o" && more) {
+            csvPath = argv[++i];
+        } else {
+            usage();
+        }
+    }
+    if (chosen.empty()) {
+        for (const Bench &b : benches) {
+            chosen.push_back(&b);
+        }
+    }
+    if (target <= 0) {
+        usage();
+    }
+
+    FILE *csv = NULL;
+    if (!csvPath.empty()) {
+        csv = fopen(csvPath.c_str(), "w");
+        if (csv == NULL) {
+            std::cerr << "lemicro: cannot write " << csvPath << "\n";
+            return 1;
+        }
+        fprintf(csv, "bench,n,iters,nsPerOp,nsPerNeighbor,bytesPerOp,allocsPerOp\n");
+    }
+
+    printf("le_engine_t is %zu bytes with room for %d neighbors, %zu a neighbor\n",
+           sizeof(le_engine_t), LE_MAX_NEIGHBORS, sizeof(le_neighbor_t));
+    printf("%-10s %5s %12s %14s %14s %10s %10s\n", "bench", "n", "iters", "ns/op", "ns/neighbor",
+           "bytes/op", "allocs/op");
+
+    Fixture f;
+    for (const Bench *b : chosen) {
+        for (int n : counts) {
+            setUp(f, n, (uint32_t)n);
+            Result r = measure(*b, f, target);
+            printf("%-10s %5d %12" PRIu64 " %14.1f %14.2f %10.1f %10.2f\n", b->name, n, r.iters, r.nsOp,
+                   r.nsOp / n, r.bytesOp, r.allocsOp);
+            if (csv != NULL) {
+                fprintf(csv, "%s,%d,%" PRIu64 ",%.1f,%.3f,%.1f,%.3f\n", b->name, n, r.iters, r.nsOp,
+                        r.nsOp / n, r.bytesOp, r.allocsOp);
+            }
+            fflush(stdout);
+        }
+    }
+    if (csv != NULL) {
+        fclose(csv);
+    }
+
+    // keep the results alive
+    if (f.sink == 1) {
+        printf("\n");
+    }
+    delete f.eng;
+    return 0;
+}
@@ -0,0 +1,516 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Run a recorded election again. Each worker `record` dump (LE_RECORD 1)
+ *          is fed back through the worker's election engine: the same calls at
+ *          the same times, with the recorded random draws. Everything the engine
+ *          sends and reports must match what it did on the node, so a failed or
+ *          slow experiment can be stepped through offline, and a change to the
+ *          engine that alters its decisions shows up as a divergence.
+ *
+ * Usage: lereplay [-e <epoch>] [-n <node>] [-v] <log> [<log> ...]
+ */
+
+// Standard C++ includes
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "le_engine.h"
+#include "record.h"
+
+static const char *msgNames[] = { "le_ack", "le_m?" };
+static const char *evNames[] = { "round", "leader", "tie", "silent", "warm" };
+
+// one decoded record
+struct Rec {
+    int type = 0;               // LE_REC_*, RECORD_PARAMS or RECORD_DRAW
+    uint32_t time = 0;
+    std::string addr;           // empty = multicast or none
+    uint32_t value = 0;
+    std::string leader;
+    int hops = 0;
+    int op = 0;                 // message, event or draw tag
+    le_engine_conf_t conf = {};
+};
+
+// one worker's dump of one experiment
+struct Dump {
+    std::string node;
+    uint32_t epoch = 0;
+    bool full = false;
+    std::vector<uint8_t> bytes;
+};
+
+// Purpose: read a little endian value
+//
+// b vector&, the bytes
+// at size_t&, where, moved past it
+// n int, 1, 2 or 4
+// ok bool&, cleared if the bytes run out
+static uint32_t take(const std::vector<uint8_t> &b, size_t &at, int n, bool &ok) {
+    uint32_t v = 0;
+    if (at + n > b.size()) {
+        ok = false;
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        v |= (uint32_t)b[at + i] << (8*i);
+    }
+    at += n;
+    return v;
+}
+
+// Purpose: unpack a dump into records, see record.h for the layout
+//
+// d Dump&, the dump
+// recs vector&, receives the records
+// return false if it ends in the middle of a record, the records before are kept
+static bool decode(const Dump &d, std::vector<Rec> &recs) {
+    std::vector<std::string> addrs;
+    const std::vector<uint8_t> &b = d.bytes;
+    size_t at = 0;
+    bool ok = true;
+
+    auto addrOf = [&](uint32_t i) {
+        return (i < addrs.size()) ? addrs[i] : std::string();
+    };
+
+    while (at < b.size() && ok) {
+        Rec r;
+        r.type = b[at++];
+        switch (r.type) {
+        case RECORD_ADDR: {
+            uint32_t len = take(b, at, 1, ok);
+            if (!ok || at + len > b.size()) {
+                return false;
+            }
+            addrs.push_back(std::string(b.begin() + at, b.begin() + at + len));
+            at += len;
+            continue;
+        }
+        case RECORD_PARAMS:
+            r.conf.rounds = (int)take(b, at, 1, ok);
+            r.conf.period = take(b, at, 4, ok);
+            r.conf.clusterHops = (int)take(b, at, 1, ok);
+            r.conf.trickle = take(b, at, 1, ok) != 0;
+            r.conf.trickleImin = take(b, at, 4, ok);
+            r.conf.trickleDoublings = (int)take(b, at, 1, ok);
+            r.conf.trickleK = (int)take(b, at, 1, ok);
+            break;
+        case RECORD_DRAW:
+            r.op = (int)take(b, at, 1, ok);
+            r.value = take(b, at, 4, ok);
+            break;
+        case LE_REC_IDENTITY:
+            r.value = take(b, at, 2, ok);
+            r.addr = addrOf(take(b, at, 1, ok));
+            break;
+        case LE_REC_ADD:
+        case LE_REC_DROP:
+        case LE_REC_POLL:
+            r.addr = addrOf(take(b, at, 1, ok));
+            break;
+        case LE_REC_RESTART:
+            r.addr = addrOf(take(b, at, 1, ok));
+            r.value = take(b, at, 1, ok);
+            break;
+        case LE_REC_START:
+            r.time = take(b, at, 4, ok);
+            r.value = take(b, at, 1, ok);
+            break;
+        case LE_REC_WARM:
+            r.value = take(b, at, 2, ok);
+            r.leader = addrOf(take(b, at, 1, ok));
+            r.hops = (int)take(b, at, 1, ok);
+            break;
+        case LE_REC_ACK:
+            r.time = take(b, at, 4, ok);
+            r.addr = addrOf(take(b, at, 1, ok));
+            r.value = take(b, at, 2, ok);
+            r.leader = addrOf(take(b, at, 1, ok));
+            r.hops = (int)take(b, at, 1, ok);
+            break;
+        case LE_REC_TICK:
+            r.time = take(b, at, 4, ok);
+            break;
+        case LE_REC_RANDOM:
+            r.value = take(b, at, 4, ok);
+            break;
+        case LE_REC_SEND:
+            r.op = (int)take(b, at, 1, ok);
+            r.addr = addrOf(take(b, at, 1, ok));
+            r.value = take(b, at, 2, ok);
+            r.leader = addrOf(take(b, at, 1, ok));
+            r.hops = (int)take(b, at, 1, ok);
+            break;
+        case LE_REC_EVENT:
+            r.op = (int)take(b, at, 1, ok);
+            r.value = take(b, at, 2, ok);
+            break;
+        case LE_REC_CLEAR:
+        case LE_REC_MAINTAIN:
+            break;
+        default:
+            return false;
+        }
+        if (ok) {
+            recs.push_back(r);
+        }
+    }
+    return ok;
+}
+
+// Purpose: a value as the record keeps it, see record.c
+//
+// v uint32_t, the value
+// bytes int, 2 or 4
+static uint32_t clamp(uint32_t v, int bytes) {
+    return (bytes == 2 && v > 0xFFFF) ? 0xFFFF : v;
+}
+
+// the state of one replay, the engine's ctx
+struct Replay {
+    const std::vector<Rec> *recs;
+    size_t at = 0;              // next record
+    bool verbose = false;
+    uint32_t start = 0;         // when the election started, for relative times
+    uint32_t now = 0;           // time of the call being replayed
+    std::string diverged;       // what went wrong, empty while it matches
+    int leaderChanges = 0;
+    int rounds = 0;
+    bool converged = false;
+    uint32_t convergedAt = 0;
+};
+
+// Purpose: print a line of the timeline
+//
+// rp Replay&, the replay
+// what string, the line
+static void say(const Replay &rp, const std::string &what) {
+    if (rp.verbose) {
+        printf("  %9.3f  %s\n", (double)(rp.now - rp.start) / 1000, what.c_str());
+    }
+}
+
+// Purpose: the next record must be an answer of this type
+//
+// rp Replay&, the replay
+// type int, LE_REC_*
+// return the record, NULL after a divergence
+static const Rec *expect(Replay &rp, int type, const std::string &got) {
+    if (!rp.diverged.empty()) {
+        return NULL;
+    }
+    if (rp.at >= rp.recs->size()) {
+        rp.diverged = "record ends, the engine " + got;
+        return NULL;
+    }
+    const Rec *r = &(*rp.recs)[rp.at];
+    if (r->type != type) {
+        rp.diverged = "record " + std::to_string(rp.at) + " has type " + std::to_string(r->type) +
+                      ", the engine " + got;
+        return NULL;
+    }
+    rp.at++;
+    return r;
+}
+
+// Purpose: the engine's send, checked against the record
+static void replaySend(le_engine_t *e, const char *to, const le_msg_t *msg) {
+    Replay &rp = *(Replay *)e->ctx;
+    char got[128];
+    snprintf(got, sizeof(got), "sent %s %" PRIu32 " %s %d to %s", msgNames[msg->type], msg->m,
+             msg->leader ? msg->leader : "-", msg->hops, to ? to : "all");
+
+    const Rec *r = expect(rp, LE_REC_SEND, got);
+    if (r == NULL) {
+        return;
+    }
+    uint32_t hops = (msg->hops < 0) ? 0 : (msg->hops > 255) ? 255 : (uint32_t)msg->hops;
+    if (r->op != msg->type || r->addr != (to ? to : "") || r->leader != (msg->leader ? msg->leader : "") ||
+            r->value != clamp(msg->m, 2) || (uint32_t)r->hops != hops) {
+        rp.diverged = std::string("the engine ") + got + ", the node sent " + msgNames[r->op & 1] + " " +
+                      std::to_string(r->value) + " " + r->leader + " to " + (r->addr.empty() ? "all" : r->addr);
+        return;
+    }
+    say(rp, std::string("tx ") + (got + 5));
+}
+
+// Purpose: the engine's events, checked against the record
+static void replayEvent(le_engine_t *e, int event, uint32_t value) {
+    Replay &rp = *(Replay *)e->ctx;
+    std::string got = std::string("reported ") + evNames[event] + " " + std::to_string((int32_t)value);
+
+    const Rec *r = expect(rp, LE_REC_EVENT, got);
+    if (r == NULL) {
+        return;
+    }
+    if (r->op != event || r->value != clamp(value, 2)) {
+        rp.diverged = "the engine " + got + ", the node reported " + evNames[r->op % 5] + " " +
+                      std::to_string(r->value);
+        return;
+    }
+    if (event == LE_EV_LEADER) {
+        rp.leaderChanges++;
+    } else if (event == LE_EV_ROUND) {
+        rp.rounds++;
+    }
+    say(rp, got);
+}
+
+// Purpose: the engine's random numbers, the ones the node drew
+static uint32_t replayRandom(le_engine_t *e) {
+    Replay &rp = *(Replay *)e->ctx;
+    const Rec *r = expect(rp, LE_REC_RANDOM, "drew a random number");
+    return (r == NULL) ? 0 : r->value;
+}
+
+// Purpose: feed one dump through the engine
+//
+// d Dump&, the dump
+// verbose bool, print the timeline
+// return true if the engine did what the node did
+static bool replay(const Dump &d, bool verbose) {
+    static const le_engine_ops_t ops = { replaySend, replayEvent, replayRandom, NULL };
+    static const char *drawNames[] = { "pong delay", "results backoff" };
+    std::vector<Rec> recs;
+    bool whole = decode(d, recs);
+    le_engine_t eng;
+    Replay rp;
+    rp.recs = &recs;
+    rp.verbose = verbose;
+    bool ready = false;
+    int replayed = 0;
+
+    printf("%s epoch %" PRIu32 ": %zu bytes, %zu records%s\n", d.node.c_str(), d.epoch, d.bytes.size(),
+           recs.size(), d.full ? ", the node ran out of room" : "");
+    if (!whole) {
+        printf("  the dump is cut short, replaying what is there\n");
+    }
+
+    while (rp.at < recs.size() && rp.diverged.empty()) {
+        const Rec &r = recs[rp.at++];
+        if (!ready && r.type != RECORD_PARAMS) {
+            rp.diverged = "the record does not open with the parameters";
+            break;
+        }
+        if (r.time != 0) {
+            rp.now = r.time;
+        }
+        replayed++;
+
+        switch (r.type) {
+        case RECORD_PARAMS:
+            le_engine_init(&eng, &r.conf, &ops, &rp);
+            ready = true;
+            if (verbose) {
+                printf("  K=%d T=%" PRIu32 " us h=%d trickle %d\n", r.conf.rounds, r.conf.period,
+                       r.conf.clusterHops, r.conf.trickle);
+            }
+            break;
+        case RECORD_DRAW:
+            say(rp, std::string(drawNames[r.op & 1]) + " " + std::to_string(r.value) + " us");
+            break;
+        case LE_REC_IDENTITY:
+            le_engine_set_identity(&eng, r.value, r.addr.c_str());
+            if (verbose) {
+                printf("  I am %s, m=%" PRIu32 "\n", r.addr.c_str(), r.value);
+            }
+            break;
+        case LE_REC_ADD:
+            le_engine_add_neighbor(&eng, r.addr.c_str());
+            break;
+        case LE_REC_DROP:
+            le_engine_drop_neighbor(&eng, r.addr.c_str());
+            say(rp, "drop " + r.addr);
+            break;
+        case LE_REC_CLEAR:
+            le_engine_clear_neighbors(&eng);
+            break;
+        case LE_REC_START:
+            rp.start = r.time;
+            eng.gen = (r.value != 0);
+            say(rp, "start, " + std::to_string(eng.numNeighbors) + " neighbors" + (eng.gen ? ", gen" : ""));
+            le_engine_start(&eng, r.time);
+            break;
+        case LE_REC_WARM:
+            say(rp, "warm start from " + r.leader + " m=" + std::to_string(r.value));
+            le_engine_warm(&eng, r.value, r.leader.c_str(), r.hops);
+            break;
+        case LE_REC_RESTART:
+            say(rp, "re-elect without " + r.addr + " in " + std::to_string(r.value) + " rounds");
+            le_engine_restart(&eng, r.addr.c_str(), (int)r.value);
+            break;
+        case LE_REC_ACK:
+            say(rp, "rx le_ack " + std::to_string(r.value) + " " + r.leader + " " + std::to_string(r.hops) +
+                    " from " + r.addr);
+            le_engine_on_ack(&eng, r.time, r.addr.c_str(), r.value, r.leader.c_str(), r.hops);
+            break;
+        case LE_REC_POLL:
+            say(rp, "rx le_m? from " + r.addr);
+            le_engine_on_poll(&eng, r.addr.c_str());
+            break;
+        case LE_REC_TICK: {
+            uint32_t at;
+            if (!le_engine_next(&eng, r.time, &at) || at != r.time) {
+                rp.diverged = "the node's engine was due at " + std::to_string(r.time) + ", this one isn't";
+                break;
+            }
+            if (le_engine_tick(&eng, r.time) == 1) {
+                rp.converged = true;
+                rp.convergedAt = r.time;
+                say(rp, "converged on " + std::string(eng.leader) + " m=" + std::to_string(eng.localMin));
+            }
+            break;
+        }
+        case LE_REC_MAINTAIN:
+            le_engine_maintain(&eng);
+            say(rp, "maintenance");
+            break;
+        default:
+            rp.diverged = "the node's engine answered with record type " + std::to_string(r.type) +
+                          " where this one did nothing";
+            break;
+        }
+    }
+
+    if (!rp.diverged.empty()) {
+        printf("  DIVERGED after %d calls: %s\n", replayed, rp.diverged.c_str());
+        return false;
+    }
+    if (ready) {
+        printf("  replay matches, %d calls, %d rounds, %d leader changes, ", replayed, rp.rounds, rp.leaderChanges);
+        if (rp.converged) {
+            printf("converged on %s m=%" PRIu32 " after %.3f s\n", eng.leader, eng.localMin,
+                   (double)(rp.convergedAt - rp.start) / 1e6);
+        } else {
+            printf("not converged, leader %s m=%" PRIu32 "\n", eng.leader, eng.localMin);
+        }
+    }
+    return true;
+}
+
+// Purpose: read every record dump in a log, and the master's m draws
+//
+// path string, the log, plain shell output or an iot-lab serial aggregator log
+// dumps map&, dumps by node and epoch, a later dump replaces an earlier one
+// mDraws map&, the master's m by node and epoch
+static void readLog(const std::string &path, std::map<std::pair<std::string, uint32_t>, Dump> &dumps,
+                    std::map<std::pair<std::string, uint32_t>, uint32_t> &mDraws) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "lereplay: cannot open " << path << "\n";
+        exit(1);
+    }
+
+    std::string line;
+    Dump cur;
+    bool inDump = false;
+    while (std::getline(in, line)) {
+        size_t at = line.find("REC: ");
+        if (at == std::string::npos) {
+            continue;
+        }
+        const char *rest = line.c_str() + at + 5;
+
+        char node[64];
+        unsigned epoch, bytes, m;
+        int full;
+        if (sscanf(rest, "node %63s epoch %u bytes %u full %d", node, &epoch, &bytes, &full) == 4) {
+            cur = Dump();
+            cur.node = node;
+            cur.epoch = epoch;
+            cur.full = (full != 0);
+            inDump = true;
+        } else if (inDump && strncmp(rest, "d ", 2) == 0) {
+            for (const char *p = rest + 2; p[0] && p[1] && p[0] != '\r'; p += 2) {
+                char hex[3] = { p[0], p[1], '\0' };
+                cur.bytes.push_back((uint8_t)strtoul(hex, NULL, 16));
+            }
+        } else if (inDump && strncmp(rest, "end", 3) == 0) {
+            dumps[std::make_pair(cur.node, cur.epoch)] = cur;
+            inDump = false;
+        } else if (sscanf(rest, "m %u %63s %u", &epoch, node, &m) == 3) {
+            mDraws[std::make_pair(std::string(node), (uint32_t)epoch)] = m;
+        }
+    }
+}
+
+static void usage(void) {
+    std::cerr << "Usage: lereplay [-e <epoch>] [-n <node>] [-v] <log> [<log> ...]\n"
+              << "  -e  only this experiment\n"
+              << "  -n  only this node, its address as the master hands it out\n"
+              << "  -v  print the timeline of every replay, in ms after the start\n";
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> logs;
+    long onlyEpoch = -1;
+    std::string onlyNode;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-e" && i+1 < argc) {
+            onlyEpoch = atol(argv[++i]);
+        } else if (arg == "-n" && i+1 < argc) {
+            onlyNode = argv[++i];
+        } else if (arg == "-v") {
+            verbose = true;
+        } else if (arg[0] == '-') {
+            usage();
+        } else {
+            logs.push_back(arg);
+        }
+    }
+    if (logs.empty()) {
+        usage();
+    }
+
+    std::map<std::pair<std::string, uint32_t>, Dump> dumps;
+    std::map<std::pair<std::string, uint32_t>, uint32_t> mDraws;
+    for (const std::string &path : logs) {
+        readLog(path, dumps, mDraws);
+    }
+
+    int replayed = 0, diverged = 0;
+    for (auto &kv : dumps) {
+        const Dump &d = kv.second;
+        if ((onlyEpoch >= 0 && d.epoch != (uint32_t)onlyEpoch) || (!onlyNode.empty() && d.node != onlyNode)) {
+            continue;
+        }
+        replayed++;
+        if (!replay(d, verbose)) {
+            diverged++;
+        }
+
+        // the m the node elected with should be the one the master drew for it
+        auto m = mDraws.find(kv.first);
+        if (m != mDraws.end()) {
+            std::vector<Rec> recs;
+            decode(d, recs);
+            for (const Rec &r : recs) {
+                if (r.type == LE_REC_IDENTITY && r.value != m->second) {
+                    printf("  the master drew m=%" PRIu32 " for it, the node used %" PRIu32 "\n", m->second, r.value);
+                }
+            }
+        }
+    }
+
+    if (replayed == 0) {
+        std::cerr << "lereplay: no record dumps found\n";
+        return 1;
+    }
+    printf("%d replayed, %d diverged\n", replayed, diverged);
+    return (diverged == 0) ? 0 : 2;
+}
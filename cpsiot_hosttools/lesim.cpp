@@ -0,0 +1,185 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Run the worker election on thousands of virtual nodes and report
+ *          correctness, convergence time and message counts, to choose K, T
+ *          and the topology before spending testbed time.
+ *
+ * Usage: lesim [-n <nodes>] [-t <topology>] [-d <degree>] [-k <K>] [-T <ms>] [-H <hops>]
+ *              [-g | -G] [-l <us>] [-j <us>] [-x <us>] [-s <seed>] [-r <runs>] [-p <threads>] [-v]
+ *              [-L <loss%>] [-B <p%>,<r%>[,<bad%>[,<good%>]]] [-D <us>[,<jitter>]] [-U <dup%>]
+ *              [-O <reorder%>[,<us>]] [-R <node>]
+ */
+
+// Standard C++ includes
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "simcore.h"
+#include "record.h"
+
+static void usage(void) {
+    std::cerr << "Usage: lesim [options]\n"
+              << "  -n  nodes, 100 by default\n"
+              << "  -t  topology, line, ring, grid, tree, mesh, rgg (default) or file:<edge list>\n"
+              << "  -d  mean degree of rgg, 8 by default\n"
+              << "  -k  rounds K, 10 by default\n"
+              << "  -T  round period T in ms, 110 by default\n"
+              << "  -H  cluster hops, 0 (a single leader) by default\n"
+              << "  -g  gen mode, announce by multicast on a trickle timer\n"
+              << "  -G  gen mode, multicast every leader change immediately\n"
+              << "  -l  link latency in us, 3000 by default\n"
+              << "  -j  uniform latency jitter in us, 2000 by default\n"
+              << "  -x  airtime of a message in us, 1000 by default\n"
+              << "  -s  seed, 1 by default, run i uses seed+i\n"
+              << "  -r  runs, 1 by default\n"
+              << "  -p  threads, the overlay is split into that many shards, 1 by default\n"
+              << "  -v  print a row per node, in the master's column order\n"
+              << "  impairments of every link, as the worker's impair command:\n"
+              << "  -L  independent loss in %\n"
+              << "  -B  Gilbert-Elliott burst loss, p%,r%[,loss while bad%[,loss while good%]]\n"
+              << "  -D  extra delay in us[,uniform jitter in us]\n"
+              << "  -U  duplication in %\n"
+              << "  -O  reordering in %[,how far back in us, 10000 by default]\n"
+              << "  -R  record a node's election like a worker with LE_RECORD 1, dumped for lereplay\n";
+    exit(1);
+}
+
+// Purpose: print every node of a run like the master's results rows
+//
+// r RunResult&, the run
+static void printNodes(const RunResult &r) {
+    char addr[LE_ADDR_LEN], leader[LE_ADDR_LEN];
+
+    printf("node,m,elected,correct,startTime,runTime,messages,degree\n");
+    for (size_t i = 0; i < r.node.size(); i++) {
+        const NodeResult &nr = r.node[i];
+        simAddr((int)i, addr);
+        simAddr(nr.leader, leader);
+        printf("%s,%" PRIu32 ",%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu32 ",%d\n",
+               addr, nr.m, leader, nr.correct ? "yes" : "no", nr.startUs,
+               nr.converged ? nr.endUs - nr.startUs : 0, nr.msgsIn + nr.msgsOut, nr.degree);
+    }
+}
+
+int main(int argc, char **argv) {
+    int n = 100;
+    std::string spec = "rgg";
+    double degree = 8;
+    int runs = 1;
+    bool verbose = false;
+    SimConf conf;
+    conf.le.rounds = 10;
+    conf.le.period = 110000;
+    conf.le.clusterHops = 0;
+    conf.le.trickle = false;
+    conf.le.trickleDoublings = 8;
+    conf.le.trickleK = 2;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool more = (i+1 < argc);
+        if (arg == "-n" && more) {
+            n = atoi(argv[++i]);
+        } else if (arg == "-t" && more) {
+            spec = argv[++i];
+        } else if (arg == "-d" && more) {
+            degree = atof(argv[++i]);
+        } else if (arg == "-k" && more) {
+            conf.le.rounds = atoi(argv[++i]);
+        } else if (arg == "-T" && more) {
+            conf.le.period = (uint32_t)(atof(argv[++i]) * 1000);
+        } else if (arg == "-H" && more) {
+            conf.le.clusterHops = atoi(argv[++i]);
+        } else if (arg == "-g" || arg == "-G") {
+            conf.gen = true;
+            conf.le.trickle = (arg == "-g");
+        } else if (arg == "-l" && more) {
+            conf.latencyUs = (uint32_t)atoi(argv[++i]);
+        } else if (arg == "-j" && more) {
+            conf.jitterUs = (uint32_t)atoi(argv[++i]);
+        } else if (arg == "-x" && more) {
+            conf.txUs = (uint32_t)atoi(argv[++i]);
+        } else if (arg == "-s" && more) {
+            conf.seed = strtoull(argv[++i], NULL, 10);
+        } else if (arg == "-r" && more) {
+            runs = atoi(argv[++i]);
+        } else if (arg == "-p" && more) {
+            conf.shards = atoi(argv[++i]);
+        } else if (arg == "-R" && more) {
+            conf.record = atoi(argv[++i]);
+        } else if (arg == "-v") {
+            verbose = true;
+        } else if ((arg == "-L" || arg == "-B" || arg == "-D" || arg == "-U" || arg == "-O") && more) {
+            static const char *names[] = { "loss", "ge", "delay", "dup", "reorder" };
+            const char *what = names[std::string("LBDUO").find(arg[1])];
+            if (!parseImpair(what, argv[++i], conf.impair)) {
+                usage();
+            }
+        } else {
+            usage();
+        }
+    }
+    if (n < 1 || runs < 1 || conf.le.period < 4 || conf.shards < 1) {
+        usage();
+    }
+    conf.le.trickleImin = conf.le.period / 4;
+
+    int correctRuns = 0;
+    double sumGlobal = 0, sumMsgs = 0, sumWall = 0;
+    uint64_t seed = conf.seed;
+    for (int run = 0; run < runs; run++) {
+        Topology topo;
+        std::string err;
+        if (!buildTopology(spec, n, degree, seed + run, topo, err)) {
+            std::cerr << "lesim: " << err << "\n";
+            return 1;
+        }
+        if (run == 0) {
+            std::vector<int> comp;
+            int diam = diameterBound(topo);
+            printf("%s, %zu nodes, %d components, diameter >= %d", spec.c_str(), topo.adj.size(),
+                   components(topo, comp), diam);
+            if (topo.dropped > 0) {
+                printf(", %d edges over the %d neighbor limit dropped", topo.dropped, LE_MAX_NEIGHBORS);
+            }
+            printf("\n");
+            if (conf.le.clusterHops == 0 && conf.le.rounds < diam) {
+                printf("warning: K=%d is below the diameter, the minimum can't reach everyone\n", conf.le.rounds);
+            }
+        }
+
+        conf.seed = seed + run;
+        record_epoch((uint32_t)run + 1);
+        Simulator sim(topo, conf);
+        RunResult r = sim.run();
+        if (verbose) {
+            printNodes(r);
+        }
+
+        printf("run %d: %d/%d converged, %d correct, %d leaders, global %.3f s, mean %.3f s, "
+               "%" PRIu64 " msgs (%.1f per node), %" PRIu64 " events, %.3f s wall, %.0f node-rounds/s\n",
+               run, r.converged, r.nodes, r.correct, r.leaders, r.globalUs / 1e6, r.meanUs / 1e6,
+               r.messages, (double)r.messages / r.nodes, r.events, r.wallSec, r.nodeRounds / r.wallSec);
+        if (r.lost > 0 || r.duplicated > 0) {
+            printf("run %d: impairments lost %" PRIu64 " and duplicated %" PRIu64 " packets\n",
+                   run, r.lost, r.duplicated);
+        }
+        correctRuns += (r.correct == r.nodes);
+        sumGlobal += r.globalUs / 1e6;
+        sumMsgs += (double)r.messages;
+        sumWall += r.wallSec;
+    }
+
+    if (conf.record >= 0) {
+        record_dump();
+    }
+    if (runs > 1) {
+        printf("summary: %d/%d runs correct, global %.3f s, %.0f msgs, %.3f s wall, on average\n",
+               correctRuns, runs, sumGlobal / runs, sumMsgs / runs, sumWall / runs);
+    }
+    return (correctRuns == runs) ? 0 : 2;
+}
@@ -0,0 +1,596 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Checks of the worker's election engine on the host. Small networks
+ *          of engines are wired together with a fixed link delay and stepped
+ *          a millisecond at a time, and single engines are handed crafted
+ *          le_acks, then the result is compared with what the protocol must
+ *          elect. Prints a line per check and exits non-zero if any failed.
+ *
+ * Usage: letest
+ */
+
+// Standard C++ includes
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "le_engine.h"
+#include "simcore.h"
+
+#define STEP_US                 (1000)      // how far time moves per step
+#define LINK_US                 (1000)      // delay of every link
+#define LIMIT_US                (30000000)  // give up on an election after this long
+#define ROUNDS                  (10)
+#define PERIOD_US               (110000)
+
+// a message on its way
+struct Msg {
+    uint32_t at;
+    int from;
+    int to;
+    int type;                   // LE_MSG_*
+    uint32_t m;
+    std::string leader;
+    int hops;
+};
+
+struct Net;
+
+// one worker
+struct Node {
+    Net *net = NULL;
+    int id = 0;
+    std::string addr;
+    std::vector<int> nbrs;
+    bool alive = true;
+    le_engine_t e;
+    std::vector<std::pair<int, uint32_t>> events;
+};
+
+// the network, every node's engine and the messages in flight
+struct Net {
+    std::vector<Node> nodes;
+    std::map<std::string, int> byAddr;
+    std::vector<Msg> inFlight;
+    uint32_t now = 0;
+    uint32_t rng = 1;
+    int sends = 0;              // calls to send, a multicast counts once
+};
+
+static int failures = 0;
+
+// Purpose: report one check
+//
+// name string, what was checked
+// ok bool, did it hold
+// why string, printed when it did not
+static void check(const std::string &name, bool ok, const std::string &why = "") {
+    printf("%s %s%s%s\n", ok ? "PASS" : "FAIL", name.c_str(), ok ? "" : ": ", ok ? "" : why.c_str());
+    if (!ok) {
+        failures++;
+    }
+}
+
+// Purpose: the engine's send, delivered to the neighbors after LINK_US
+static void netSend(le_engine_t *e, const char *to, const le_msg_t *msg) {
+    Node *n = (Node *)e->ctx;
+    Net *net = n->net;
+    net->sends++;
+    for (int nb : n->nbrs) {
+        if (to != NULL && net->nodes[nb].addr != to) {
+            continue;
+        }
+        Msg m = { net->now + LINK_US, n->id, nb, msg->type, msg->m,
+                  msg->leader != NULL ? msg->leader : "", msg->hops };
+        net->inFlight.push_back(m);
+    }
+}
+
+// Purpose: the engine's events, kept to check later
+static void netEvent(le_engine_t *e, int event, uint32_t value) {
+    ((Node *)e->ctx)->events.push_back(std::make_pair(event, value));
+}
+
+// Purpose: the engine's random numbers, only trickle draws them
+static uint32_t netRandom(le_engine_t *e) {
+    Net *net = ((Node *)e->ctx)->net;
+    net->rng = net->rng * 1103515245 + 12345;
+    return net->rng >> 8;
+}
+
+static const le_engine_ops_t netOps = { netSend, netEvent, netRandom, NULL };
+
+// Purpose: build a network, every engine started at time 0
+//
+// net Net&, receives it
+// ms vector, every node's m value, the node count
+// edges vector, undirected links between node indexes
+// hops int, cluster hops, 0 for a single leader
+// gen int, 0 = unicast to each neighbor, 1 = multicast every change, 2 = multicast on a trickle timer
+static void build(Net &net, const std::vector<uint32_t> &ms, const std::vector<std::pair<int, int>> &edges,
+                  int hops, int gen = 0) {
+    le_engine_conf_t conf = {};
+    conf.rounds = ROUNDS;
+    conf.period = PERIOD_US;
+    conf.clusterHops = hops;
+    conf.trickle = (gen == 2);
+    conf.trickleImin = PERIOD_US / 4;   // the worker's settings
+    conf.trickleDoublings = 8;
+    conf.trickleK = 2;
+
+    net.nodes.clear();
+    net.byAddr.clear();
+    net.inFlight.clear();
+    net.now = 0;
+    net.sends = 0;
+    net.nodes.resize(ms.size());
+    for (size_t i = 0; i < ms.size(); i++) {
+        Node &n = net.nodes[i];
+        char addr[LE_ADDR_LEN];
+        snprintf(addr, sizeof(addr), "0000:%04x", (unsigned)(i + 1));
+        n.net = &net;
+        n.id = (int)i;
+        n.addr = addr;
+        net.byAddr[n.addr] = (int)i;
+    }
+    for (const auto &ed : edges) {
+        net.nodes[ed.first].nbrs.push_back(ed.second);
+        net.nodes[ed.second].nbrs.push_back(ed.first);
+    }
+    for (size_t i = 0; i < ms.size(); i++) {
+        Node &n = net.nodes[i];
+        le_engine_init(&n.e, &conf, &netOps, &n);
+        le_engine_set_identity(&n.e, ms[i], n.addr.c_str());
+        for (int nb : n.nbrs) {
+            le_engine_add_neighbor(&n.e, net.nodes[nb].addr.c_str());
+        }
+        n.e.gen = (gen > 0);
+        le_engine_start(&n.e, 0);
+    }
+}
+
+// Purpose: links of a line or ring
+//
+// count int, nodes
+// ring bool, close it
+static std::vector<std::pair<int, int>> chain(int count, bool ring) {
+    std::vector<std::pair<int, int>> edges;
+    for (int i = 0; i + 1 < count; i++) {
+        edges.push_back(std::make_pair(i, i + 1));
+    }
+    if (ring && count > 2) {
+        edges.push_back(std::make_pair(count - 1, 0));
+    }
+    return edges;
+}
+
+// Purpose: step the network until every live engine is done
+//
+// net Net&, the network
+// return usec it took, 0 if it ran out of time
+static uint32_t run(Net &net) {
+    uint32_t begin = net.now;
+    while (net.now - begin < LIMIT_US) {
+        // deliver what has arrived, in the order it was sent
+        std::vector<Msg> due;
+        std::vector<Msg> later;
+        for (const Msg &m : net.inFlight) {
+            (m.at <= net.now ? due : later).push_back(m);
+        }
+        net.inFlight.swap(later);
+        for (const Msg &m : due) {
+            Node &to = net.nodes[m.to];
+            if (!to.alive || !net.nodes[m.from].alive) {
+                continue;
+            }
+            const char *from = net.nodes[m.from].addr.c_str();
+            if (m.type == LE_MSG_ACK) {
+                le_engine_on_ack(&to.e, net.now, from, m.m, m.leader.c_str(), m.hops);
+            } else {
+                le_engine_on_poll(&to.e, from);
+            }
+        }
+
+        bool done = true;
+        for (Node &n : net.nodes) {
+            if (n.alive && n.e.state < LE_STATE_DONE) {
+                le_engine_tick(&n.e, net.now);
+                done = done && n.e.state >= LE_STATE_DONE;
+            }
+        }
+        if (done) {
+            return net.now - begin;
+        }
+        net.now += STEP_US;
+    }
+    return 0;
+}
+
+// Purpose: hop distance from one node to every other over live nodes
+//
+// net Net&, the network
+// from int, where to start
+static std::vector<int> distances(const Net &net, int from) {
+    std::vector<int> dist(net.nodes.size(), -1);
+    std::vector<int> queue = { from };
+    dist[from] = 0;
+    for (size_t q = 0; q < queue.size(); q++) {
+        for (int nb : net.nodes[queue[q]].nbrs) {
+            if (net.nodes[nb].alive && dist[nb] < 0) {
+                dist[nb] = dist[queue[q]] + 1;
+                queue.push_back(nb);
+            }
+        }
+    }
+    return dist;
+}
+
+// Purpose: did a node report an event
+//
+// n Node&, the node
+// event int, LE_EV_*
+// value int, the value it must carry, -1 for any
+static bool reported(const Node &n, int event, int value) {
+    for (const auto &ev : n.events) {
+        if (ev.first == event && (value < 0 || ev.second == (uint32_t)value)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Purpose: is the parent a neighbor one hop closer to the same leader
+//
+// net Net&, the network
+// n Node&, the node
+static bool parentFits(const Net &net, const Node &n) {
+    if (n.e.leaderHops == 0) {
+        return n.e.parent == -1;
+    }
+    if (n.e.parent < 0 || n.e.parent >= n.e.numNeighbors) {
+        return false;
+    }
+    auto it = net.byAddr.find(n.e.nbr[n.e.parent].addr);
+    if (it == net.byAddr.end()) {
+        return false;
+    }
+    const le_engine_t &p = net.nodes[it->second].e;
+    return strcmp(p.leader, n.e.leader) == 0 && p.leaderHops + 1 == n.e.leaderHops;
+}
+
+// Purpose: every live node elected the given node over a shortest path
+//
+// net Net&, the network
+// leader int, the node that must win
+// why string&, receives the first node that did not
+// parents bool, check the parents too, a warm start keeps only the hops
+static bool electedEverywhere(const Net &net, int leader, std::string &why, bool parents = true) {
+    std::vector<int> dist = distances(net, leader);
+    const Node &l = net.nodes[leader];
+    for (const Node &n : net.nodes) {
+        if (!n.alive) {
+            continue;
+        }
+        char buf[128];
+        if (n.e.leader != l.addr || n.e.localMin != l.e.m) {
+            snprintf(buf, sizeof(buf), "node %d elected %s m=%" PRIu32 ", not %s m=%" PRIu32,
+                     n.id, n.e.leader, n.e.localMin, l.addr.c_str(), l.e.m);
+        } else if (n.e.leaderHops != dist[n.id]) {
+            snprintf(buf, sizeof(buf), "node %d is %d hops from the leader, not %d", n.id, n.e.leaderHops, dist[n.id]);
+        } else if (parents && !parentFits(net, n)) {
+            snprintf(buf, sizeof(buf), "node %d has parent %d at %d hops", n.id, n.e.parent, n.e.leaderHops);
+        } else {
+            continue;
+        }
+        why = buf;
+        return false;
+    }
+    return true;
+}
+
+// Purpose: judge a cluster election by lesim's rule, every head heads itself
+//
+// net Net&, the network
+// h int, cluster hops
+// why string&, receives the first node that failed
+// return the number of nodes that failed
+static int clusterFails(const Net &net, int h, std::string &why) {
+    int n = (int)net.nodes.size();
+    Topology t;
+    std::vector<int> head(n);
+    std::vector<uint32_t> m(n);
+    std::vector<bool> ok;
+    t.adj.resize(n);
+    for (const Node &nd : net.nodes) {
+        t.adj[nd.id] = nd.nbrs;
+        auto it = net.byAddr.find(nd.e.leader);
+        head[nd.id] = (it == net.byAddr.end()) ? -1 : it->second;
+        m[nd.id] = nd.e.m;
+    }
+
+    int fails = clusterCheck(t, head, m, h, ok);
+    for (int i = 0; i < n && fails > 0; i++) {
+        char buf[128];
+        if (ok[i]) {
+            continue;
+        }
+        if (head[i] >= 0 && head[head[i]] != head[i]) {
+            snprintf(buf, sizeof(buf), "node %d follows %d, which follows %d", i, head[i], head[head[i]]);
+        } else {
+            snprintf(buf, sizeof(buf), "node %d has the wrong head %d", i, head[i]);
+        }
+        why = buf;
+        break;
+    }
+    return fails;
+}
+
+// Purpose: a line and a ring converge on the minimum m over shortest paths
+static void testConverge(void) {
+    std::vector<uint32_t> ms = { 40, 12, 77, 90, 5, 61, 33, 120 };
+    std::string why;
+
+    Net line;
+    build(line, ms, chain((int)ms.size(), false), 0);
+    bool ok = run(line) > 0;
+    check("line converges to the minimum m", ok && electedEverywhere(line, 4, why), ok ? why : "did not finish");
+
+    Net ring;
+    build(ring, ms, chain((int)ms.size(), true), 0);
+    ok = run(ring) > 0;
+    check("ring converges to the minimum m", ok && electedEverywhere(ring, 4, why), ok ? why : "did not finish");
+}
+
+// Purpose: equal m values go to the lower address
+static void testTie(void) {
+    std::vector<uint32_t> ms = { 7, 30, 40, 30, 7 };
+    std::string why;
+
+    Net line;
+    build(line, ms, chain((int)ms.size(), false), 0);
+    bool ok = run(line) > 0;
+    check("a tie goes to the lower address", ok && electedEverywhere(line, 0, why), ok ? why : "did not finish");
+    check("the higher address reports losing the tie", reported(line.nodes[4], LE_EV_TIE, 7));
+}
+
+// Purpose: cluster mode keeps every head within h hops and parents on the path to it
+static void testCluster(void) {
+    // node 3 is out of node 0's reach and heads the far end
+    std::vector<uint32_t> ms = { 10, 50, 60, 20, 40, 80 };
+    std::vector<int> heads = { 0, 0, 0, 3, 3, 3 };
+    const int h = 2;
+
+    Net line;
+    build(line, ms, chain((int)ms.size(), false), h);
+    bool ok = run(line) > 0;
+    std::string why = ok ? "" : "did not finish";
+    for (const Node &n : line.nodes) {
+        if (!ok) {
+            break;
+        }
+        const Node &head = line.nodes[heads[n.id]];
+        char buf[128];
+        if (n.e.leader != head.addr) {
+            snprintf(buf, sizeof(buf), "node %d chose %s, not %s", n.id, n.e.leader, head.addr.c_str());
+        } else if (!parentFits(line, n)) {
+            snprintf(buf, sizeof(buf), "node %d has parent %d at %d hops", n.id, n.e.parent, n.e.leaderHops);
+        } else {
+            continue;
+        }
+        why = buf;
+        ok = false;
+    }
+    ok = ok && clusterFails(line, h, why) == 0;
+    check("cluster heads are within h hops, parents on the path", ok, why);
+
+    // rings of random m values used to leave heads following other heads
+    int strays = 0;
+    for (uint32_t seed = 1; seed <= 3; seed++) {
+        std::vector<uint32_t> rms(70);
+        uint32_t draw = seed;
+        for (uint32_t &m : rms) {
+            draw = draw * 1103515245 + 12345;
+            m = 1 + (draw >> 8) % 254;
+        }
+        Net ring;
+        build(ring, rms, chain((int)rms.size(), true), h);
+        if (run(ring) == 0) {
+            why = "did not finish";
+            strays++;
+            break;
+        }
+        for (const Node &n : ring.nodes) {
+            auto it = ring.byAddr.find(n.e.leader);
+            const Node &head = ring.nodes[it == ring.byAddr.end() ? n.id : it->second];
+            if (strcmp(head.e.leader, head.addr.c_str()) != 0) {
+                why = "node " + std::to_string(n.id) + " follows a head that follows " + head.e.leader;
+                strays++;
+            }
+        }
+        strays += clusterFails(ring, h, why);
+    }
+    check("every cluster head heads itself", strays == 0, why);
+
+    // same head heard further first, then closer, in one round
+    le_engine_conf_t conf = {};
+    conf.rounds = ROUNDS;
+    conf.period = PERIOD_US;
+    conf.clusterHops = 4;
+    Net sink;
+    Node n;
+    n.net = &sink;
+    le_engine_init(&n.e, &conf, &netOps, &n);
+    le_engine_set_identity(&n.e, 90, "0000:0009");
+    le_engine_add_neighbor(&n.e, "0000:0001");
+    le_engine_add_neighbor(&n.e, "0000:0002");
+    le_engine_start(&n.e, 0);
+    le_engine_tick(&n.e, 0);
+    le_engine_on_ack(&n.e, 1000, "0000:0001", 5, "0000:0005", 3);
+    le_engine_on_ack(&n.e, 1000, "0000:0002", 5, "0000:0005", 1);
+    for (uint32_t t = 0; n.e.state == LE_STATE_POLL || n.e.counter == ROUNDS; t += STEP_US) {
+        le_engine_tick(&n.e, t);
+    }
+    char buf[128];
+    snprintf(buf, sizeof(buf), "leader %s at %d hops through neighbor %d", n.e.leader, n.e.leaderHops, n.e.parent);
+    check("the shorter path to the same head becomes the parent",
+          strcmp(n.e.leader, "0000:0005") == 0 && n.e.leaderHops == 2 && n.e.parent == 1, buf);
+}
+
+// Purpose: warm start ends early when the neighborhood agrees and runs in full when not
+static void testWarm(void) {
+    std::vector<uint32_t> ms = { 40, 12, 77, 90, 5 };
+    std::string why;
+
+    Net cold;
+    build(cold, ms, chain((int)ms.size(), false), 0);
+    uint32_t coldTime = run(cold);
+
+    // everyone opens with the last result, taken from the cold run
+    Net warm;
+    build(warm, ms, chain((int)ms.size(), false), 0);
+    for (Node &n : warm.nodes) {
+        const le_engine_t &c = cold.nodes[n.id].e;
+        le_engine_warm(&n.e, c.localMin, c.leader, c.leaderHops);
+    }
+    uint32_t warmTime = run(warm);
+    bool agreed = true;
+    for (const Node &n : warm.nodes) {
+        agreed = agreed && reported(n, LE_EV_WARM, 1);
+    }
+    bool ok = coldTime > 0 && warmTime > 0 && electedEverywhere(warm, 4, why, false);
+    check("warm start agreed keeps the incumbent", ok && agreed, ok ? "not every node agreed" : why);
+    char buf[128];
+    snprintf(buf, sizeof(buf), "warm %" PRIu32 " us, cold %" PRIu32 " us", warmTime, coldTime);
+    check("warm start agreed is faster than cold", ok && warmTime < coldTime, buf);
+
+    // the middle node comes back with a lower m than the incumbent and starts cold
+    std::vector<uint32_t> ms3 = { 20, 3, 30 };
+    Net mixed;
+    build(mixed, ms3, chain(3, false), 0);
+    for (int i : { 0, 2 }) {
+        le_engine_warm(&mixed.nodes[i].e, 20, mixed.nodes[0].addr.c_str(), i);
+    }
+    ok = run(mixed) > 0;
+    bool disagreed = reported(mixed.nodes[0], LE_EV_WARM, 0) && reported(mixed.nodes[2], LE_EV_WARM, 0);
+    check("warm start disagreed runs in full", ok && disagreed, ok ? "a warm node agreed" : "did not finish");
+    check("warm start disagreed elects the new minimum", ok && electedEverywhere(mixed, 1, why), why);
+}
+
+// Purpose: after the leader drops out the survivors elect the next lowest m
+static void testRestart(void) {
+    std::vector<uint32_t> ms = { 40, 12, 77, 90, 5, 61, 33, 120 };
+    std::string why;
+
+    Net ring;
+    build(ring, ms, chain((int)ms.size(), true), 0);
+    uint32_t cold = run(ring);
+    bool ok = cold > 0 && electedEverywhere(ring, 4, why);
+
+    // the worker's re-election, as udp.c does it when heartbeats stop, bounded by
+    // the depth the heartbeats carried instead of K
+    int depth = 0;
+    for (const Node &n : ring.nodes) {
+        depth = std::max(depth, n.e.leaderHops);
+    }
+    const std::string failed = ring.nodes[4].addr;
+    ring.nodes[4].alive = false;
+    for (Node &n : ring.nodes) {
+        if (n.alive) {
+            le_engine_maintain(&n.e);
+            le_engine_restart(&n.e, failed.c_str(), 2*depth + 1);
+        }
+    }
+    uint32_t warm = run(ring);
+    ok = ok && warm > 0;
+    check("restart after a leader drop elects the next lowest m", ok && electedEverywhere(ring, 1, why),
+          why.empty() ? "did not finish" : why);
+    check("restart from the runner-up is quicker than the first election", ok && warm < cold,
+          std::to_string(warm) + " us against " + std::to_string(cold) + " us");
+
+    // only some nodes lost the heartbeats, the live leader is told to step down too
+    Net split;
+    build(split, ms, chain((int)ms.size(), true), 0);
+    ok = run(split) > 0;
+    for (Node &n : split.nodes) {
+        le_engine_maintain(&n.e);
+        le_engine_restart(&n.e, failed.c_str(), 2*depth + 1);
+    }
+    ok = ok && run(split) > 0;
+    why.clear();
+    check("a live leader steps down and follows the new one", ok && electedEverywhere(split, 1, why),
+          why.empty() ? "did not finish" : why);
+
+    // cluster mode, only the lost head's members re-elect, the other cluster carries on
+    std::vector<uint32_t> lineMs = { 10, 50, 60, 20, 40, 80 };
+    Net line;
+    build(line, lineMs, chain((int)lineMs.size(), false), 2);
+    ok = run(line) > 0;
+    const std::string head = line.nodes[3].addr;
+    line.nodes[3].alive = false;
+    int restarted = 0;
+    for (Node &n : line.nodes) {
+        le_engine_maintain(&n.e);
+        if (n.alive && n.e.leader == head) {
+            le_engine_restart(&n.e, head.c_str(), 2*2 + 1);
+            restarted++;
+        }
+    }
+    ok = ok && restarted == 2 && run(line) > 0;
+    for (int i = 0; ok && i < 6; i++) {
+        int want = (i < 3) ? 0 : 4;
+        if (i != 3 && line.nodes[i].e.leader != line.nodes[want].addr) {
+            why = "node " + std::to_string(i) + " follows " + line.nodes[i].e.leader;
+            ok = false;
+        }
+    }
+    check("a cluster re-elects only the lost head's members", ok, why.empty() ? "did not finish" : why);
+}
+
+// Purpose: trickle holds back what the neighborhood already repeated
+static void testTrickle(void) {
+    std::vector<uint32_t> ms = { 40, 12, 77, 90, 5, 61, 33, 120, 18, 54, 26, 99 };
+    std::vector<std::pair<int, int>> clique;
+    for (int i = 0; i < (int)ms.size(); i++) {
+        for (int j = i + 1; j < (int)ms.size(); j++) {
+            clique.push_back(std::make_pair(i, j));
+        }
+    }
+    std::string why;
+
+    Net immediate;
+    build(immediate, ms, clique, 0, 1);
+    bool ok = run(immediate) > 0 && electedEverywhere(immediate, 4, why);
+    check("gen mode multicast converges on a clique", ok, why.empty() ? "did not finish" : why);
+
+    Net trickle;
+    build(trickle, ms, clique, 0, 2);
+    ok = run(trickle) > 0 && electedEverywhere(trickle, 4, why);
+    check("trickle converges on a clique", ok, why.empty() ? "did not finish" : why);
+
+    int suppressed = 0;
+    for (const Node &n : trickle.nodes) {
+        suppressed += n.e.trickle.suppressed;
+    }
+    check("trickle suppresses announcements the neighborhood already made", suppressed > 0,
+          "nothing suppressed");
+    check("trickle sends less than announcing every change", trickle.sends < immediate.sends,
+          std::to_string(trickle.sends) + " against " + std::to_string(immediate.sends));
+}
+
+int main(void) {
+    testConverge();
+    testTie();
+    testCluster();
+    testWarm();
+    testRestart();
+    testTrickle();
+
+    printf("%d failed\n", failures);
+    return failures == 0 ? 0 : 1;
+}
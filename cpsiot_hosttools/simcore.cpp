@@ -0,0 +1,737 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Discrete-event simulation of the worker election, see simcore.h.
+ */
+
+// Standard C++ includes
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#include "simcore.h"
+#include "record.h"
+
+// Purpose: connect two nodes, unless one of them has no room left, as on a worker
+//
+// t Topology&, the overlay
+// a int, one node
+// b int, the other
+static void addEdge(Topology &t, int a, int b) {
+    if (a == b || std::find(t.adj[a].begin(), t.adj[a].end(), b) != t.adj[a].end()) {
+        return;
+    }
+    if ((int)t.adj[a].size() >= LE_MAX_NEIGHBORS || (int)t.adj[b].size() >= LE_MAX_NEIGHBORS) {
+        t.dropped++;
+        return;
+    }
+    t.adj[a].push_back(b);
+    t.adj[b].push_back(a);
+}
+
+// Purpose: random geometric graph on the unit square, what gen mode discovers
+//
+// t Topology&, receives the overlay
+// n int, nodes
+// degree double, mean degree wanted
+// seed uint64_t, placement seed
+static void randomGeometric(Topology &t, int n, double degree, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> uni(0.0, 1.0);
+    double r = sqrt(degree / (M_PI * n));
+    int cells = std::max(1, (int)(1.0 / r));
+    std::vector<double> x(n), y(n);
+    std::vector<std::vector<int>> grid(cells * cells);
+    std::vector<std::pair<double, double>> pts(n);
+
+    // number the nodes in strips across the square, so a shard of consecutive
+    // nodes is a region and most of its links stay inside it
+    for (auto &p : pts) {
+        p.second = uni(rng);
+        p.first = uni(rng);
+    }
+    std::sort(pts.begin(), pts.end(), [cells](const std::pair<double, double> &a, const std::pair<double, double> &b) {
+        int ra = std::min(cells-1, (int)(a.second * cells)), rb = std::min(cells-1, (int)(b.second * cells));
+        return ra != rb ? ra < rb : a.first < b.first;
+    });
+
+    for (int i = 0; i < n; i++) {
+        x[i] = pts[i].first;
+        y[i] = pts[i].second;
+        int cx = std::min(cells-1, (int)(x[i] * cells));
+        int cy = std::min(cells-1, (int)(y[i] * cells));
+        grid[cy * cells + cx].push_back(i);
+    }
+
+    for (int i = 0; i < n; i++) {
+        int cx = std::min(cells-1, (int)(x[i] * cells));
+        int cy = std::min(cells-1, (int)(y[i] * cells));
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int gx = cx + dx, gy = cy + dy;
+                if (gx < 0 || gy < 0 || gx >= cells || gy >= cells) {
+                    continue;
+                }
+                for (int j : grid[gy * cells + gx]) {
+                    double ddx = x[i] - x[j], ddy = y[i] - y[j];
+                    if (j > i && ddx*ddx + ddy*ddy <= r*r) {
+                        addEdge(t, i, j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Purpose: read an edge list, one "<a> <b>" pair of node indexes per line, '#' comments
+//
+// t Topology&, receives the overlay
+// path string, the file
+// err string&, receives the problem
+// return false on a bad file
+static bool readEdges(Topology &t, const std::string &path, std::string &err) {
+    std::ifstream in(path);
+    std::string line;
+    std::vector<std::pair<int, int>> edges;
+    int n = 0;
+
+    if (!in) {
+        err = "can't open " + path;
+        return false;
+    }
+    while (std::getline(in, line)) {
+        int a, b;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line.c_str(), "%d %d", &a, &b) != 2 || a < 0 || b < 0) {
+            err = "bad edge \"" + line + "\" in " + path;
+            return false;
+        }
+        edges.push_back({ a, b });
+        n = std::max(n, std::max(a, b) + 1);
+    }
+
+    t.adj.assign(n, {});
+    for (auto &e : edges) {
+        addEdge(t, e.first, e.second);
+    }
+    return true;
+}
+
+// Purpose: build an overlay
+//
+// spec string, line, ring, grid, tree, mesh, rgg or file:<path>
+// n int, nodes, a file decides for itself
+// degree double, mean degree of rgg
+// seed uint64_t, placement seed of rgg
+// t Topology&, receives the overlay
+// err string&, receives the problem
+// return false on a bad spec
+bool buildTopology(const std::string &spec, int n, double degree, uint64_t seed, Topology &t, std::string &err) {
+    t.name = spec;
+    t.dropped = 0;
+    t.adj.assign(n, {});
+
+    if (spec == "line" || spec == "ring") {
+        for (int i = 0; i + 1 < n; i++) {
+            addEdge(t, i, i+1);
+        }
+        if (spec == "ring" && n > 2) {
+            addEdge(t, n-1, 0);
+        }
+    } else if (spec == "grid") {
+        int w = (int)ceil(sqrt((double)n));
+        for (int i = 0; i < n; i++) {
+            if ((i+1) % w != 0 && i+1 < n) {
+                addEdge(t, i, i+1);
+            }
+            if (i + w < n) {
+                addEdge(t, i, i+w);
+            }
+        }
+    } else if (spec == "tree") {
+        for (int i = 1; i < n; i++) {
+            addEdge(t, i, (i-1)/2);
+        }
+    } else if (spec == "mesh") {
+        if (n - 1 > LE_MAX_NEIGHBORS) {
+            err = "a mesh of more than " + std::to_string(LE_MAX_NEIGHBORS + 1) + " nodes overflows the neighbor table";
+            return false;
+        }
+        for (int i = 0; i < n; i++) {
+            for (int j = i+1; j < n; j++) {
+                addEdge(t, i, j);
+            }
+        }
+    } else if (spec == "rgg") {
+        randomGeometric(t, n, degree, seed);
+    } else if (spec.compare(0, 5, "file:") == 0) {
+        return readEdges(t, spec.substr(5), err);
+    } else {
+        err = "unknown topology " + spec;
+        return false;
+    }
+    return true;
+}
+
+// Purpose: judge cluster heads, by the rule the master applies too. Every head
+//          heads itself, every node reaches its head within h hops through
+//          members of that cluster, and no lower m (then address) head reaches
+//          it that way
+//
+// t Topology&, the overlay
+// head vector<int>&, each node's head, -1 for none
+// m vector<uint32_t>&, each node's m value
+// h int, cluster hops
+// ok vector<bool>&, receives whether each node's head passes
+// return how many nodes fail
+int clusterCheck(const Topology &t, const std::vector<int> &head, const std::vector<uint32_t> &m, int h,
+                 std::vector<bool> &ok) {
+    int n = (int)t.adj.size();
+    std::vector<int> best(n, -1), dist(n, -1), queue;
+
+    // from each head out through its own members, the best head to reach each node
+    for (int c = 0; c < n; c++) {
+        if (head[c] != c) {
+            continue;
+        }
+        queue.assign(1, c);
+        dist[c] = 0;
+        for (size_t q = 0; q < queue.size(); q++) {
+            int u = queue[q];
+            if (best[u] < 0 || m[c] < m[best[u]] || (m[c] == m[best[u]] && c < best[u])) {
+                best[u] = c;
+            }
+            if (dist[u] >= h || (u != c && head[u] != c)) {
+                continue;
+            }
+            for (int v : t.adj[u]) {
+                if (dist[v] < 0) {
+                    dist[v] = dist[u] + 1;
+                    queue.push_back(v);
+                }
+            }
+        }
+        for (int u : queue) {
+            dist[u] = -1;
+        }
+    }
+
+    int fails = 0;
+    ok.assign(n, false);
+    for (int i = 0; i < n; i++) {
+        int c = head[i];
+        ok[i] = (c >= 0 && c < n && head[c] == c && best[i] == c);
+        fails += ok[i] ? 0 : 1;
+    }
+    return fails;
+}
+
+// Purpose: label the connected components
+//
+// t Topology&, the overlay
+// comp vector<int>&, receives each node's component
+// return the number of components
+int components(const Topology &t, std::vector<int> &comp) {
+    int n = (int)t.adj.size();
+    int count = 0;
+    std::vector<int> stack;
+
+    comp.assign(n, -1);
+    for (int s = 0; s < n; s++) {
+        if (comp[s] >= 0) {
+            continue;
+        }
+        comp[s] = count;
+        stack.push_back(s);
+        while (!stack.empty()) {
+            int u = stack.back();
+            stack.pop_back();
+            for (int v : t.adj[u]) {
+                if (comp[v] < 0) {
+                    comp[v] = count;
+                    stack.push_back(v);
+                }
+            }
+        }
+        count++;
+    }
+    return count;
+}
+
+// Purpose: hop distances from one node
+//
+// t Topology&, the overlay
+// src int, the node
+// limit int, stop past this many hops, -1 = no limit
+// dist vector<int>&, receives the distances, -1 = not reached
+// return the farthest node reached
+static int bfs(const Topology &t, int src, int limit, std::vector<int> &dist) {
+    std::vector<int> frontier = { src }, next;
+    int far = src;
+
+    dist.assign(t.adj.size(), -1);
+    dist[src] = 0;
+    for (int d = 1; !frontier.empty() && (limit < 0 || d <= limit); d++) {
+        next.clear();
+        for (int u : frontier) {
+            for (int v : t.adj[u]) {
+                if (dist[v] < 0) {
+                    dist[v] = d;
+                    next.push_back(v);
+                    far = v;
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+    return far;
+}
+
+// Purpose: a lower bound on the diameter of node 0's component, by a double sweep,
+//          K should be at least this for the global minimum to reach everyone
+//
+// t Topology&, the overlay
+int diameterBound(const Topology &t) {
+    std::vector<int> dist;
+    if (t.adj.empty()) {
+        return 0;
+    }
+    int far = bfs(t, 0, -1, dist);
+    far = bfs(t, far, -1, dist);
+    return dist[far];
+}
+
+// Purpose: set one impairment the way the worker's impair command does
+//
+// what string, loss, ge, delay, dup or reorder
+// values string, its values, comma separated
+// conf impair_conf_t&, updated
+// return false on bad values
+bool parseImpair(const std::string &what, const std::string &values, impair_conf_t &conf) {
+    std::vector<std::string> words = { "impair", what };
+    std::stringstream ss(values);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        words.push_back(item);
+    }
+
+    std::vector<char *> argv;
+    for (std::string &w : words) {
+        argv.push_back(&w[0]);
+    }
+    impair_t im;
+    impair_init(&im, 1);
+    im.conf = conf;
+    if (what == "link" || what == "seed" || impair_cmd(&im, (int)argv.size(), argv.data()) != 0) {
+        return false;
+    }
+    conf = im.conf;
+    return true;
+}
+
+// Purpose: the address of a virtual node, fixed width so address order is index order
+//
+// i int, node index
+// buf char*, room for LE_ADDR_LEN chars
+void simAddr(int i, char *buf) {
+    snprintf(buf, LE_ADDR_LEN, "1711:6b10:%04x:%04x", (i >> 16) & 0xffff, i & 0xffff);
+}
+
+// Purpose: the index of a virtual node
+//
+// addr char*, its address
+// return the index, -1 if it isn't one of ours
+int simIndex(const char *addr) {
+    char *end;
+    if (strncmp(addr, "1711:6b10:", 10) != 0) {
+        return -1;
+    }
+    unsigned long hi = strtoul(addr + 10, &end, 16);
+    if (*end != ':') {
+        return -1;
+    }
+    unsigned long lo = strtoul(end + 1, &end, 16);
+    return (int)((hi << 16) | lo);
+}
+
+// Purpose: wait until every shard thread is here
+void Barrier::wait() {
+    int g = gen.load(std::memory_order_acquire);
+    if (count.fetch_add(1, std::memory_order_acq_rel) == parties - 1) {
+        count.store(0, std::memory_order_relaxed);
+        gen.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    for (int spins = 0; gen.load(std::memory_order_acquire) == g; spins++) {
+        if (spins > 1000) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+Simulator::Simulator(const Topology &t, const SimConf &c) : topo(t), conf(c) {
+    // a window needs a link delay to be long, without one everything runs in one shard
+    lookahead = (uint64_t)conf.txUs + conf.latencyUs;
+    if (lookahead == 0 || conf.shards < 1) {
+        conf.shards = 1;
+    }
+    int n = (int)topo.adj.size();
+    conf.shards = std::max(1, std::min(conf.shards, n));
+    perShard = std::max(1, (n + conf.shards - 1) / conf.shards);
+}
+
+// Purpose: the output function of splitmix64
+//
+// z uint64_t, the stream position
+static uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Purpose: the next number of a node's random stream, splitmix64
+//
+// n Node&, the node
+uint64_t Simulator::draw(Node &n) {
+    return mix64(n.rng += 0x9e3779b97f4a7c15ULL);
+}
+
+// Purpose: queue an event, on our shard or in the mailbox of the node's shard
+//
+// origin Node&, the node queueing it
+// time uint64_t, when it happens
+// node int, the node it happens to
+// kind int, EV_*
+void Simulator::push(Node &origin, uint64_t time, int node, int kind, int from, uint32_t m, int leader, int hops) {
+    Event ev = { time, origin.id, origin.seq++, node, kind, from, m, leader, hops };
+    int dst = node / perShard;
+    if (dst == origin.shard->id) {
+        origin.shard->queue.push(ev);
+    } else {
+        mail[origin.shard->id][dst].push_back(ev);
+    }
+}
+
+// Purpose: put a message on the link to one neighbor
+//
+// src Node&, the sender
+// to int, the receiver
+// msg le_msg_t*, the message
+// depart uint64_t, when it left the sender's radio
+void Simulator::deliver(Node &src, int to, const le_msg_t *msg, uint64_t depart) {
+    uint32_t delay[2] = { 0, 0 };
+    int copies = 1;
+
+    // impairments only add delay, so the window lookahead still holds
+    if (src.imp != NULL) {
+        char addr[LE_ADDR_LEN];
+        simAddr(to, addr);
+        copies = impair_packet(src.imp, addr, delay);
+    }
+
+    for (int c = 0; c < copies; c++) {
+        uint64_t arrive = depart + conf.latencyUs + (conf.jitterUs ? draw(src) % (conf.jitterUs + 1) : 0) + delay[c];
+        if (msg->type == LE_MSG_ACK) {
+            push(src, arrive, to, EV_ACK, src.id, msg->m, simIndex(msg->leader), msg->hops);
+        } else {
+            push(src, arrive, to, EV_POLL, src.id);
+        }
+    }
+}
+
+// Purpose: the engine's send, one transmission whether unicast or multicast
+void Simulator::engineSend(le_engine_t *e, const char *to, const le_msg_t *msg) {
+    Node *n = (Node *)e->ctx;
+    Simulator *sim = n->sim;
+    uint64_t depart = std::max(n->shard->now, n->txFree) + sim->conf.txUs;
+
+    n->txFree = depart;
+    n->res.msgsOut++;
+    if (to == NULL) {
+        for (int v : sim->topo.adj[n->id]) {
+            sim->deliver(*n, v, msg, depart);
+        }
+    } else {
+        int v = simIndex(to);
+        if (v >= 0 && v < (int)sim->nodes.size()) {
+            sim->deliver(*n, v, msg, depart);
+        }
+    }
+}
+
+// Purpose: the engine's events
+void Simulator::engineEvent(le_engine_t *e, int event, uint32_t value) {
+    (void)value;
+    if (event == LE_EV_LEADER) {
+        ((Node *)e->ctx)->res.leaderChanges++;
+    } else if (event == LE_EV_ROUND) {
+        ((Node *)e->ctx)->res.rounds++;
+    }
+}
+
+// Purpose: the engine's random numbers, from the node's own stream
+uint32_t Simulator::engineRandom(le_engine_t *e) {
+    return (uint32_t)draw(*(Node *)e->ctx);
+}
+
+// Purpose: make sure a node's next tick is queued
+//
+// n Node&, the node
+void Simulator::schedule(Node &n) {
+    uint64_t now = n.shard->now;
+    uint32_t at;
+    if (!n.started || !le_engine_next(&n.eng, (uint32_t)now, &at)) {
+        n.tickAt = UINT64_MAX;
+        return;
+    }
+    uint64_t t = now + (uint32_t)(at - (uint32_t)now);
+    if (t != n.tickAt) {
+        n.tickAt = t;
+        push(n, t, n.id, EV_TICK);
+    }
+}
+
+// Purpose: run one event
+//
+// sh Shard&, the node's shard
+// ev Event&, the event
+void Simulator::handle(Shard &sh, const Event &ev) {
+    char from[LE_ADDR_LEN], leader[LE_ADDR_LEN];
+    Node &nd = nodes[ev.node];
+    uint32_t now = (uint32_t)ev.time;
+
+    sh.now = ev.time;
+    sh.events++;
+    switch (ev.kind) {
+    case EV_START:
+        nd.started = true;
+        nd.res.startUs = ev.time;
+        le_engine_start(&nd.eng, now);
+        break;
+    case EV_TICK:
+        if (ev.time != nd.tickAt) {
+            return;     // superseded
+        }
+        nd.tickAt = UINT64_MAX;
+        if (le_engine_tick(&nd.eng, now) == 1) {
+            nd.res.converged = true;
+            nd.res.endUs = ev.time;
+        }
+        break;
+    case EV_ACK:
+        nd.res.msgsIn++;
+        simAddr(ev.from, from);
+        simAddr(ev.leader, leader);
+        le_engine_on_ack(&nd.eng, now, from, ev.m, leader, ev.hops);
+        break;
+    case EV_POLL:
+        nd.res.msgsIn++;
+        simAddr(ev.from, from);
+        le_engine_on_poll(&nd.eng, from);
+        break;
+    }
+    schedule(nd);
+}
+
+// Purpose: one shard's thread, a window at a time until no shard has anything left
+//
+// sh Shard&, the shard
+void Simulator::runShard(Shard &sh) {
+    int nShards = (int)shards.size();
+    int parity = 0;
+
+    if (nShards == 1) {
+        while (!sh.queue.empty() && sh.queue.top().time <= conf.limitUs) {
+            Event ev = sh.queue.top();
+            sh.queue.pop();
+            handle(sh, ev);
+        }
+        return;
+    }
+
+    while (true) {
+        // what the other shards sent us last window
+        for (int s = 0; s < nShards; s++) {
+            for (const Event &ev : mail[s][sh.id]) {
+                sh.queue.push(ev);
+            }
+            mail[s][sh.id].clear();
+        }
+        next[parity][sh.id] = sh.queue.empty() ? UINT64_MAX : sh.queue.top().time;
+        barrier->wait();
+
+        // every shard agrees on the window, idle time is skipped
+        uint64_t start = *std::min_element(next[parity].begin(), next[parity].end());
+        parity ^= 1;
+        if (start == UINT64_MAX || start > conf.limitUs) {
+            break;
+        }
+        uint64_t end = std::min(start + lookahead, conf.limitUs + 1);
+
+        while (!sh.queue.empty() && sh.queue.top().time < end) {
+            Event ev = sh.queue.top();
+            sh.queue.pop();
+            handle(sh, ev);
+        }
+        sh.windows++;
+        barrier->wait();
+    }
+}
+
+// Purpose: judge the leaders, the lowest m (then address) of the component, or in
+//          cluster mode by clusterCheck
+//
+// r RunResult&, the run
+void Simulator::check(RunResult &r) {
+    int n = (int)nodes.size();
+    std::set<int> leaders;
+    std::vector<int> comp;
+
+    if (conf.le.clusterHops == 0) {
+        int count = components(topo, comp);
+        std::vector<int> best(count, -1);
+        for (int i = 0; i < n; i++) {
+            int &b = best[comp[i]];
+            if (b < 0 || nodes[i].res.m < nodes[b].res.m) {
+                b = i;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            nodes[i].res.correct = (nodes[i].res.leader == best[comp[i]]);
+        }
+    } else {
+        std::vector<int> head(n);
+        std::vector<uint32_t> m(n);
+        std::vector<bool> ok;
+        for (int i = 0; i < n; i++) {
+            head[i] = nodes[i].res.leader;
+            m[i] = nodes[i].res.m;
+        }
+        clusterCheck(topo, head, m, conf.le.clusterHops, ok);
+        for (int i = 0; i < n; i++) {
+            nodes[i].res.correct = ok[i];
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        NodeResult &nr = nodes[i].res;
+        leaders.insert(nr.leader);
+        if (nr.converged) {
+            r.converged++;
+            r.meanUs += (double)(nr.endUs - nr.startUs);
+            r.globalUs = std::max(r.globalUs, nr.endUs);
+        }
+        if (nr.correct) {
+            r.correct++;
+        }
+        r.messages += nr.msgsIn + nr.msgsOut;
+        r.nodeRounds += (uint64_t)nr.rounds;
+    }
+    if (r.converged > 0) {
+        r.meanUs /= r.converged;
+    }
+    r.leaders = (int)leaders.size();
+}
+
+// Purpose: run one election, from the start multicast until nothing is left to do
+//
+// return how it went
+RunResult Simulator::run() {
+    static const le_engine_ops_t ops = { engineSend, engineEvent, engineRandom, NULL };
+    static const le_engine_ops_t recordOps = { engineSend, engineEvent, engineRandom, record_journal };
+    auto wallStart = std::chrono::steady_clock::now();
+    int n = (int)topo.adj.size();
+    int nShards = conf.shards;
+    std::mt19937_64 rng(conf.seed);
+    char addr[LE_ADDR_LEN];
+    RunResult r;
+
+    shards.assign(nShards, Shard());
+    for (int s = 0; s < nShards; s++) {
+        shards[s].id = s;
+        shards[s].first = std::min(n, s * perShard);
+        shards[s].last = std::min(n, (s + 1) * perShard);
+    }
+    mail.assign(nShards, std::vector<std::vector<Event>>(nShards));
+    next[0].assign(nShards, UINT64_MAX);
+    next[1].assign(nShards, UINT64_MAX);
+
+    nodes.assign(n, Node());
+    impair_t perfect;
+    impair_init(&perfect, 0);
+    perfect.conf = conf.impair;
+    bool impaired = impair_active(&perfect);
+    imps.assign(impaired ? n : 0, perfect);
+    for (int i = 0; i < n; i++) {
+        Node &nd = nodes[i];
+        le_engine_init(&nd.eng, &conf.le, (i == conf.record) ? &recordOps : &ops, &nd);
+        nd.sim = this;
+        nd.shard = &shards[i / perShard];
+        nd.id = i;
+        nd.started = false;
+        nd.seq = 0;
+        nd.rng = rng();
+        nd.txFree = 0;
+        nd.tickAt = UINT64_MAX;
+        nd.imp = NULL;
+        if (impaired) {
+            // a stream of its own, so turning impairments on leaves every other draw alone
+            nd.imp = &imps[i];
+            impair_seed(nd.imp, (uint32_t)mix64(mix64(conf.seed) + 0x9e3779b97f4a7c15ULL * (uint64_t)(i + 1)));
+        }
+
+        // random m values as the master hands them out, ties happen
+        simAddr(i, addr);
+        nd.res.m = 1 + (uint32_t)(rng() % 254);
+        nd.res.degree = (int)topo.adj[i].size();
+        le_engine_set_identity(&nd.eng, nd.res.m, addr);
+        nd.eng.gen = conf.gen;
+        for (int v : topo.adj[i]) {
+            simAddr(v, addr);
+            le_engine_add_neighbor(&nd.eng, addr);
+        }
+        push(nd, conf.startJitterUs ? rng() % (conf.startJitterUs + 1) : 0, i, EV_START);
+    }
+
+    Barrier bar(nShards);
+    barrier = &bar;
+    std::vector<std::thread> threads;
+    for (int s = 1; s < nShards; s++) {
+        threads.emplace_back(&Simulator::runShard, this, std::ref(shards[s]));
+    }
+    runShard(shards[0]);
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    barrier = nullptr;
+
+    for (Shard &sh : shards) {
+        r.events += sh.events;
+        r.windows = std::max(r.windows, sh.windows);
+        sh.queue = decltype(sh.queue)();
+    }
+    for (impair_t &im : imps) {
+        r.lost += im.lost;
+        r.duplicated += im.duplicated;
+    }
+    for (Node &nd : nodes) {
+        nd.res.leader = simIndex(nd.eng.leader);
+        nd.res.hops = nd.eng.leaderHops;
+    }
+    r.nodes = n;
+    check(r);
+    for (Node &nd : nodes) {
+        r.node.push_back(nd.res);
+    }
+    r.wallSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    return r;
+}
@@ -0,0 +1,186 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Discrete-event simulation of the worker election on the host. Every
+ *          virtual node runs the worker's own le_engine, messages cross modeled
+ *          links, and idle time is skipped, so thousands of nodes and whole
+ *          K/T/topology sweeps run in one process in seconds.
+ *
+ *          Big overlays are split into shards of consecutive nodes, one thread
+ *          each. Shards run in windows as long as the shortest link delay: nothing
+ *          sent inside a window can arrive before it ends, so a shard only hears
+ *          from the others at the barrier between windows, through one mailbox per
+ *          pair of shards that is never written and read in the same window. Every
+ *          node draws from its own random stream and events at the same time run
+ *          in the order their senders queued them, so a run comes out the same on
+ *          any number of shards.
+ */
+
+#ifndef SIMCORE_H
+#define SIMCORE_H
+
+// Standard C++ includes
+#include <atomic>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "le_engine.h"
+#include "impair.h"
+
+// an overlay, adj[i] are the nodes node i hears
+struct Topology {
+    std::string name;
+    std::vector<std::vector<int>> adj;
+    int dropped = 0;        // edges left out because a node's neighbor table was full
+};
+
+// the network and protocol being simulated
+struct SimConf {
+    le_engine_conf_t le;
+    bool gen = false;               // neighbors found by multicast, announce by multicast
+    uint32_t latencyUs = 3000;      // link latency, usec
+    uint32_t jitterUs = 2000;       // uniform extra latency, usec
+    uint32_t txUs = 1000;           // airtime of one message, a node sends one at a time
+    uint32_t startJitterUs = 5000;  // spread of when the nodes hear the start multicast
+    uint64_t limitUs = 3600000000ULL;   // give up at this simulated time
+    uint64_t seed = 1;
+    int shards = 1;                 // threads
+    impair_conf_t impair = {};      // loss, delay and duplication on every link, seeded per node
+    int record = -1;                // node whose election goes to the worker's record, -1 = none
+};
+
+// how one node did
+struct NodeResult {
+    uint32_t m = 0;
+    int leader = -1;                // node index of its leader
+    int hops = 0;                   // its hops to the leader, cluster mode
+    bool converged = false;
+    bool correct = false;
+    uint64_t startUs = 0;           // when it heard the start multicast
+    uint64_t endUs = 0;             // when it converged
+    uint32_t msgsIn = 0;
+    uint32_t msgsOut = 0;
+    int leaderChanges = 0;
+    int rounds = 0;
+    int degree = 0;
+};
+
+// how one run did
+struct RunResult {
+    int nodes = 0;
+    int converged = 0;
+    int correct = 0;
+    int leaders = 0;                // distinct leaders elected
+    uint64_t globalUs = 0;          // last node converged, after the start multicast
+    double meanUs = 0;              // mean per-node runtime, as the workers report it
+    uint64_t messages = 0;          // in plus out, as the workers count them
+    uint64_t events = 0;
+    uint64_t nodeRounds = 0;        // rounds run, summed over the nodes
+    uint64_t lost = 0;              // packets the impairments dropped
+    uint64_t duplicated = 0;
+    uint64_t windows = 0;           // barriers crossed, sharded runs
+    double wallSec = 0;
+    std::vector<NodeResult> node;
+};
+
+bool buildTopology(const std::string &spec, int n, double degree, uint64_t seed, Topology &t, std::string &err);
+int components(const Topology &t, std::vector<int> &comp);
+int clusterCheck(const Topology &t, const std::vector<int> &head, const std::vector<uint32_t> &m, int h,
+                 std::vector<bool> &ok);
+int diameterBound(const Topology &t);
+bool parseImpair(const std::string &what, const std::string &values, impair_conf_t &conf);
+void simAddr(int i, char *buf);
+int simIndex(const char *addr);
+
+// a barrier for the shard threads, they spin since windows are short
+class Barrier {
+public:
+    explicit Barrier(int n) : count(0), gen(0), parties(n) {}
+    void wait();
+
+private:
+    std::atomic<int> count;
+    std::atomic<int> gen;
+    int parties;
+};
+
+class Simulator {
+public:
+    Simulator(const Topology &t, const SimConf &c);
+    RunResult run();
+
+private:
+    enum Kind { EV_START, EV_TICK, EV_ACK, EV_POLL };
+
+    // a pending event, msg fields only for EV_ACK
+    struct Event {
+        uint64_t time;
+        int origin;                 // node that queued it
+        uint32_t seq;               // the origin's count, orders events at the same time
+        int node;
+        int kind;
+        int from;
+        uint32_t m;
+        int leader;
+        int hops;
+        bool operator>(const Event &o) const {
+            if (time != o.time) return time > o.time;
+            if (origin != o.origin) return origin > o.origin;
+            return seq > o.seq;
+        }
+    };
+
+    // a slice of the overlay and its thread's state
+    struct Shard {
+        int id;
+        int first, last;            // nodes [first, last)
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> queue;
+        uint64_t now = 0;
+        uint64_t events = 0;
+        uint64_t windows = 0;
+    };
+
+    // one virtual worker
+    struct Node {
+        le_engine_t eng;
+        Simulator *sim;
+        Shard *shard;
+        int id;
+        bool started;               // heard the start multicast
+        uint32_t seq;               // events queued
+        uint64_t rng;               // its random stream
+        uint64_t txFree;            // its radio is busy until then
+        uint64_t tickAt;            // its pending tick, UINT64_MAX = none
+        impair_t *imp;              // its outgoing links, NULL = perfect
+        NodeResult res;
+    };
+
+    static void engineSend(le_engine_t *e, const char *to, const le_msg_t *msg);
+    static void engineEvent(le_engine_t *e, int event, uint32_t value);
+    static uint32_t engineRandom(le_engine_t *e);
+    static uint64_t draw(Node &n);
+
+    void push(Node &origin, uint64_t time, int node, int kind, int from = -1, uint32_t m = 0,
+              int leader = -1, int hops = 0);
+    void deliver(Node &src, int to, const le_msg_t *msg, uint64_t depart);
+    void schedule(Node &n);
+    void handle(Shard &sh, const Event &ev);
+    void runShard(Shard &sh);
+    void check(RunResult &r);
+
+    const Topology &topo;
+    SimConf conf;
+    std::vector<Node> nodes;
+    std::vector<impair_t> imps;
+    std::vector<Shard> shards;
+    int perShard = 1;
+    uint64_t lookahead = 1;         // shortest link delay, the window length
+    std::vector<std::vector<std::vector<Event>>> mail;  // [from shard][to shard]
+    std::vector<uint64_t> next[2];  // each shard's earliest event, alternating windows
+    Barrier *barrier = nullptr;
+};
+
+#endif
@@ -0,0 +1,396 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Merge the `trace` dumps of every worker into one timeline and measure
+ *          how fast the winning minimum spread, hop by hop. Nodes are aligned on
+ *          the master's start multicast, which they all hear at the same time.
+ *
+ * Usage: tracemerge [-e <epoch>] [-s <unix-start>] [-q] <log> [<log> ...]
+ */
+
+// Standard C++ includes
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Event types and opcodes, as in trace.h and metrics.h on the worker
+#define TRACE_EPOCH             (1)
+#define TRACE_RX                (2)
+#define TRACE_TX                (3)
+#define TRACE_STATE             (4)
+#define TRACE_ROUND             (5)
+#define TRACE_LEADER            (6)
+#define TRACE_START             (7)
+#define TRACE_END               (8)
+
+#define OP_START                (4)
+#define OP_LE_ACK               (6)
+#define PEER_MULTICAST          (0xFFFF)
+
+static const char *typeNames[] = {
+    "?", "epoch", "rx", "tx", "state", "round", "leader", "start", "end"
+};
+static const char *opNames[] = {
+    "ping", "pong", "conf", "ips", "start", "disc", "le_ack", "le_m?",
+    "hb", "reelect", "results", "rack", "other"
+};
+
+// one trace record
+struct Event {
+    uint32_t time;
+    uint8_t type;
+    uint8_t op;
+    uint16_t peer;
+    uint32_t value;
+    int epoch;          // experiment the event happened in, -1 if its marker was overwritten
+};
+
+// one node's dump
+struct Node {
+    std::string addr;
+    uint16_t id = 0;
+    uint32_t overwritten = 0;
+    std::vector<Event> events;
+    bool anchored = false;
+    uint32_t anchor = 0;
+};
+
+// an event on the merged timeline
+struct Global {
+    int64_t time;
+    uint16_t node;
+    Event ev;
+};
+
+// Purpose: parse a "TRACE: r <24 hex>" record
+//
+// hex char*, the 24 hex digits
+// ev Event&, receives the record
+// return true if the record was well formed
+static bool parseRecord(const char *hex, Event &ev) {
+    if (strlen(hex) < 24) {
+        return false;
+    }
+    char part[9];
+    auto field = [&](int at, int len) {
+        memcpy(part, hex + at, len);
+        part[len] = '\0';
+        return (uint32_t)strtoul(part, nullptr, 16);
+    };
+    ev.time = field(0, 8);
+    ev.type = (uint8_t)field(8, 2);
+    ev.op = (uint8_t)field(10, 2);
+    ev.peer = (uint16_t)field(12, 4);
+    ev.value = field(16, 8);
+    ev.epoch = -1;
+    return true;
+}
+
+// Purpose: read every trace dump in a log, a later dump of a node replaces an earlier one
+//
+// path string, the log, plain shell output or an iot-lab serial aggregator log
+// nodes map&, dumps by node id
+static void readLog(const std::string &path, std::map<uint16_t, Node> &nodes) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "tracemerge: cannot open " << path << "\n";
+        exit(1);
+    }
+
+    std::string line;
+    Node cur;
+    bool inDump = false;
+    while (std::getline(in, line)) {
+        size_t at = line.find("TRACE: ");
+        if (at == std::string::npos) {
+            continue;
+        }
+        const char *rest = line.c_str() + at + 7;
+
+        char addr[64];
+        unsigned id;
+        unsigned events, overwritten;
+        if (sscanf(rest, "node %63s id %x events %u overwritten %u", addr, &id, &events, &overwritten) == 4) {
+            cur = Node();
+            cur.addr = addr;
+            cur.id = (uint16_t)id;
+            cur.overwritten = overwritten;
+            inDump = true;
+        } else if (inDump && strncmp(rest, "r ", 2) == 0) {
+            Event ev;
+            if (parseRecord(rest + 2, ev)) {
+                cur.events.push_back(ev);
+            }
+        } else if (inDump && strncmp(rest, "end", 3) == 0) {
+            nodes[cur.id] = cur;
+            inDump = false;
+        }
+    }
+}
+
+// Purpose: tag each event with its experiment and find the node's start multicast
+//
+// n Node&, the node
+// epoch int, experiment to align on
+static void alignNode(Node &n, int epoch) {
+    int curEpoch = -1;
+    for (Event &ev : n.events) {
+        if (ev.type == TRACE_EPOCH) {
+            curEpoch = (int)ev.value;
+        }
+        ev.epoch = curEpoch;
+    }
+
+    // the start multicast is the shared instant, our own start event is a fallback
+    for (Event &ev : n.events) {
+        if (ev.epoch == epoch && ev.type == TRACE_RX && ev.op == OP_START) {
+            n.anchor = ev.time;
+            n.anchored = true;
+            return;
+        }
+    }
+    for (Event &ev : n.events) {
+        if (ev.epoch == epoch && ev.type == TRACE_START) {
+            n.anchor = ev.time;
+            n.anchored = true;
+            return;
+        }
+    }
+}
+
+// Purpose: print one event of the merged timeline
+//
+// g Global&, the event
+// unixStart double, experiment start in unix seconds, 0 for relative times only
+static void printEvent(const Global &g, double unixStart) {
+    const Event &ev = g.ev;
+    if (unixStart > 0) {
+        printf("%17.6f ", unixStart + g.time / 1e6);
+    }
+    printf("%10" PRId64 " us  %04x  %-6s", g.time, g.node, typeNames[ev.type <= TRACE_END ? ev.type : 0]);
+
+    if (ev.type == TRACE_RX || ev.type == TRACE_TX) {
+        const char *op = (ev.op < sizeof(opNames)/sizeof(opNames[0])) ? opNames[ev.op] : "?";
+        const char *dir = (ev.type == TRACE_RX) ? "from" : "to";
+        if (ev.peer == PEER_MULTICAST) {
+            printf(" %-8s %s all", op, dir);
+        } else {
+            printf(" %-8s %s %04x", op, dir, ev.peer);
+        }
+        if (ev.op == OP_LE_ACK) {
+            printf(" m=%" PRIu32, ev.value);
+        }
+    } else if (ev.type == TRACE_LEADER || ev.type == TRACE_END) {
+        printf(" leader %04x m=%" PRIu32, ev.peer, ev.value);
+    } else {
+        printf(" %" PRIu32, ev.value);
+    }
+    printf("\n");
+}
+
+// Purpose: hops from the origin of the winning minimum, following who told whom
+//
+// id uint16_t, the node
+// parent map&, the neighbor each node first heard the winner from
+// hops map&, memoized hop counts, -1 while being computed
+static int hopsOf(uint16_t id, std::map<uint16_t, uint16_t> &parent, std::map<uint16_t, int> &hops) {
+    auto h = hops.find(id);
+    if (h != hops.end()) {
+        return h->second;
+    }
+    auto p = parent.find(id);
+    if (p == parent.end()) {
+        return hops[id] = -1;
+    }
+
+    hops[id] = -1;      // guards against cycles
+    int ph = hopsOf(p->second, parent, hops);
+    return hops[id] = (ph < 0) ? -1 : ph + 1;
+}
+
+// Purpose: print how the winning minimum spread
+//
+// nodes map&, every node's dump, aligned
+// epoch int, the experiment
+static void propagation(std::map<uint16_t, Node> &nodes, int epoch) {
+    // the winner is the smallest m any node finished with, or started with
+    uint32_t winner = UINT32_MAX;
+    for (auto &kv : nodes) {
+        for (Event &ev : kv.second.events) {
+            if (ev.epoch == epoch && ev.type == TRACE_END && ev.value < winner) {
+                winner = ev.value;
+            }
+        }
+    }
+    if (winner == UINT32_MAX) {
+        for (auto &kv : nodes) {
+            for (Event &ev : kv.second.events) {
+                if (ev.epoch == epoch && ev.type == TRACE_START && ev.value < winner) {
+                    winner = ev.value;
+                }
+            }
+        }
+    }
+    if (winner == UINT32_MAX) {
+        printf("\nno election found in epoch %d\n", epoch);
+        return;
+    }
+
+    // when each node took on the winner, and who it first heard it from
+    std::map<uint16_t, int64_t> adopted;
+    std::map<uint16_t, uint16_t> parent;
+    std::map<uint16_t, int> hops;
+    for (auto &kv : nodes) {
+        Node &n = kv.second;
+        if (!n.anchored) {
+            continue;
+        }
+        uint16_t heardFrom = 0;
+        bool heard = false;
+        for (Event &ev : n.events) {
+            if (ev.epoch != epoch) {
+                continue;
+            }
+            int64_t t = (int32_t)(ev.time - n.anchor);
+            if (ev.type == TRACE_START && ev.value == winner) {
+                adopted[n.id] = t;
+                hops[n.id] = 0;
+                break;
+            }
+            if (ev.type == TRACE_RX && ev.op == OP_LE_ACK && ev.value == winner && !heard) {
+                heardFrom = ev.peer;
+                heard = true;
+            }
+            if (ev.type == TRACE_LEADER && ev.value == winner) {
+                adopted[n.id] = t;
+                if (heard) {
+                    parent[n.id] = heardFrom;
+                }
+                break;
+            }
+        }
+    }
+
+    printf("\nwinning m=%" PRIu32 ", spread over %zu of %zu nodes\n", winner, adopted.size(), nodes.size());
+    printf("node  hops  from  adopted_us  hop_delay_us\n");
+
+    std::map<int, std::vector<int64_t>> perHop;
+    for (auto &kv : adopted) {
+        uint16_t id = kv.first;
+        int h = hopsOf(id, parent, hops);
+        auto p = parent.find(id);
+        if (p != parent.end() && adopted.count(p->second) > 0) {
+            int64_t delay = kv.second - adopted[p->second];
+            printf("%04x  %4d  %04x  %10" PRId64 "  %12" PRId64 "\n", id, h, p->second, kv.second, delay);
+            if (h > 0) {
+                perHop[h].push_back(delay);
+            }
+        } else {
+            printf("%04x  %4d     -  %10" PRId64 "             -\n", id, h, kv.second);
+        }
+    }
+
+    printf("\nhop  nodes  mean_delay_us  max_delay_us\n");
+    for (auto &kv : perHop) {
+        int64_t sum = 0;
+        int64_t max = 0;
+        for (int64_t d : kv.second) {
+            sum += d;
+            max = std::max(max, d);
+        }
+        printf("%3d  %5zu  %13" PRId64 "  %12" PRId64 "\n", kv.first, kv.second.size(),
+               sum / (int64_t)kv.second.size(), max);
+    }
+}
+
+// Purpose: print the usage message and quit
+static void usage(void) {
+    std::cerr << "Usage: tracemerge [-e <epoch>] [-s <unix-start>] [-q] <log> [<log> ...]\n"
+              << "  -e  experiment to merge, the newest one in the dumps by default\n"
+              << "  -s  unix time the experiment started (the master's startTime column)\n"
+              << "  -q  skip the timeline, only print the propagation summary\n";
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    int epoch = -1;
+    double unixStart = 0;
+    bool quiet = false;
+    std::vector<std::string> logs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-e" && i+1 < argc) {
+            epoch = atoi(argv[++i]);
+        } else if (arg == "-s" && i+1 < argc) {
+            unixStart = atof(argv[++i]);
+        } else if (arg == "-q") {
+            quiet = true;
+        } else if (arg[0] == '-') {
+            usage();
+        } else {
+            logs.push_back(arg);
+        }
+    }
+    if (logs.empty()) {
+        usage();
+    }
+
+    std::map<uint16_t, Node> nodes;
+    for (const std::string &path : logs) {
+        readLog(path, nodes);
+    }
+    if (nodes.empty()) {
+        std::cerr << "tracemerge: no trace dumps found\n";
+        return 1;
+    }
+
+    // newest experiment any node saw
+    if (epoch < 0) {
+        for (auto &kv : nodes) {
+            for (Event &ev : kv.second.events) {
+                if (ev.type == TRACE_EPOCH && (int)ev.value > epoch) {
+                    epoch = (int)ev.value;
+                }
+            }
+        }
+    }
+
+    std::vector<Global> timeline;
+    for (auto &kv : nodes) {
+        Node &n = kv.second;
+        alignNode(n, epoch);
+        if (!n.anchored) {
+            std::cerr << "tracemerge: node " << n.addr << " has no start in epoch " << epoch << ", skipped\n";
+            continue;
+        }
+        if (n.overwritten > 0) {
+            std::cerr << "tracemerge: node " << n.addr << " lost its " << n.overwritten << " oldest events\n";
+        }
+        for (Event &ev : n.events) {
+            if (ev.epoch == epoch) {
+                timeline.push_back({ (int32_t)(ev.time - n.anchor), n.id, ev });
+            }
+        }
+    }
+    std::stable_sort(timeline.begin(), timeline.end(),
+                     [](const Global &a, const Global &b) { return a.time < b.time; });
+
+    printf("epoch %d, %zu nodes, %zu events\n", epoch, nodes.size(), timeline.size());
+    if (!quiet) {
+        for (const Global &g : timeline) {
+            printEvent(g, unixStart);
+        }
+    }
+    propagation(nodes, epoch);
+
+    return 0;
+}
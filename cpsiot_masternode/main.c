@@ -17,6 +17,10 @@
 #include "shell_commands.h"
 #include "xtimer.h"
 
+// Experiment statistics and the results log
+#include "stats.h"
+#include "reslog.h"
+
 // Networking includes
 #include "net/gnrc/pktdump.h"
 #include "net/gnrc.h"
@@ -118,6 +122,121 @@ static int setDiscoverRounds(int argc, char **argv) {
     return 0;
 }
 
+// nodes shell command, ends discovery as soon as this many nodes answered
+static int setExpectedNodes(int argc, char **argv) {
+    if (hasSynced == true) {
+        printf("MAIN: clock was already synced, cannot change discover configs\n");
+        return 0;
+    }
+
+    if (argc < 2) {
+        printf("USAGE: nodes <num-nodes>\n");
+        return 0;
+    }
+
+    int nodes = atoi(argv[1]);
+    printf("MAIN: set expected nodes to %d\n", nodes);
+
+    char* msg = (char*)calloc(32, sizeof(char));
+    sprintf(msg, "nodes;%d;", nodes);
+    ipc_msg_send(msg, serverPid, true);
+
+    return 0;
+}
+
+// registry shell command, keeps the discovered nodes between experiments
+static int setRegistry(int argc, char **argv) {
+    if (hasSynced == true) {
+        printf("MAIN: clock was already synced, cannot change discover configs\n");
+        return 0;
+    }
+
+    int mode = -1;
+    if (argc >= 2) {
+        if (strcmp(argv[1], "off") == 0) {
+            mode = 0;
+        } else if (strcmp(argv[1], "reuse") == 0) {
+            mode = 1;
+        } else if (strcmp(argv[1], "rerand") == 0) {
+            mode = 2;
+        }
+    }
+
+    if (mode < 0) {
+        printf("USAGE: registry <off|reuse|rerand>\n");
+        return 0;
+    }
+
+    printf("MAIN: set node registry to %s\n", argv[1]);
+
+    char* msg = (char*)calloc(32, sizeof(char));
+    sprintf(msg, "registry;%d;", mode);
+    ipc_msg_send(msg, serverPid, true);
+
+    return 0;
+}
+
+// stats shell command, summary of the results so far
+static int dumpStats(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    stats_dump();
+
+    return 0;
+}
+
+// log shell command, prints or clears the results saved on flash
+static int resultsLog(int argc, char **argv) {
+    if (argc < 2) {
+        printf("USAGE: log <dump|clear>\n");
+        return 0;
+    }
+
+    if (strcmp(argv[1], "dump") == 0) {
+        reslog_print(0, true);
+    } else if (strcmp(argv[1], "clear") == 0) {
+        reslog_clear();
+        printf("MAIN: results log cleared\n");
+    } else {
+        printf("USAGE: log <dump|clear>\n");
+    }
+
+    return 0;
+}
+
+// mpolicy shell command, chooses how the master assigns m values
+static int setMPolicy(int argc, char **argv) {
+    if (hasSynced == true) {
+        printf("MAIN: clock was already synced, cannot change the m value policy\n");
+        return 0;
+    }
+
+    int policy = -1;
+    if (argc >= 2) {
+        if (strcmp(argv[1], "random") == 0) {
+            policy = 0;
+        } else if (strcmp(argv[1], "rr") == 0) {
+            policy = 1;
+        } else if (strcmp(argv[1], "metric") == 0) {
+            policy = 2;
+        }
+    }
+
+    if (policy < 0) {
+        printf("USAGE: mpolicy <random|rr|metric>\n");
+        return 0;
+    }
+
+    printf("MAIN: set m value policy to %s\n", argv[1]);
+
+    char* msg = (char*)calloc(32, sizeof(char));
+    sprintf(msg, "mpolicy;%d;", policy);
+    ipc_msg_send(msg, serverPid, true);
+
+    return 0;
+}
+
 // IPC HELPER FUNCTIONS
 
 // Purpose: send message to destinationPID, blocking or not
@@ -168,7 +287,12 @@ int ipc_msg_reply(char *message, msg_t incoming) {
 const shell_command_t shell_commands[] = {
     {"hello", "prints hello world", hello_world},
     {"sync", "syncronize to unix time and starts experiment", myUnixSync},
-    {"rounds", "set the number of two-second node discover rounds", setDiscoverRounds},
+    {"rounds", "set the maximum number of node discover rounds", setDiscoverRounds},
+    {"nodes", "end discovery once this many nodes answered", setExpectedNodes},
+    {"mpolicy", "set the m value policy: random, rr, or metric", setMPolicy},
+    {"registry", "keep discovered nodes between experiments: off, reuse, or rerand", setRegistry},
+    {"stats", "print convergence time and message statistics", dumpStats},
+    {"log", "dump or clear the results saved on flash", resultsLog},
     { NULL, NULL, NULL }
 };
 
@@ -0,0 +1,399 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Results log for the master. Records are collected in RAM and appended
+ *          to a littlefs file on MTD_0 (the m3's SPI flash, a host file on native)
+ *          when an experiment ends. The file opens with a header giving the layout
+ *          of the records.
+ */
+
+// Standard C includes
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Standard RIOT includes
+#include "board.h"
+#include "mtd.h"
+#include "mutex.h"
+#include "vfs.h"
+#include "fs/littlefs2_fs.h"
+
+#include "reslog.h"
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static littlefs2_desc_t fs_desc = {
+    .lock = MUTEX_INIT,
+};
+
+static vfs_mount_t flash_mount = {
+    .fs = &littlefs2_file_system,
+    .mount_point = RESLOG_MOUNT,
+    .private_data = &fs_desc,
+};
+
+static mutex_t lock = MUTEX_INIT;          // the server thread writes, the shell dumps
+static uint8_t buf[RESLOG_BUF_SIZE];
+static uint32_t bufLen = 0;
+static uint32_t fileLen = 0;
+static uint32_t dropped = 0;                // bytes lost to failed writes
+static bool enabled = false;
+
+// Purpose: size of a record from its type
+//
+// type uint8_t, the first byte of the record
+static uint32_t recordSize(uint8_t type) {
+    if (type == RESLOG_ROW) {
+        return sizeof(reslog_row_t);
+    } else if (type == RESLOG_EXPERIMENT || type == RESLOG_CAMPAIGN) {
+        return sizeof(reslog_summary_t);
+    } else if (type == RESLOG_HEADER) {
+        return sizeof(reslog_header_t);
+    }
+    return 0;
+}
+
+// Purpose: print one result row
+//
+// row reslog_row_t*, the row
+// dump bool, prefix the experiment number
+static void printRow(reslog_row_t *row, bool dump) {
+    if (dump) {
+        printf("%u,", row->exp);
+    }
+    printf("%s,%"PRIu32",%s,%s,%"PRIu32",%"PRIu32".%06"PRIu32",%"PRIu32",%u,%u,%s,%"PRIu32"",
+           row->node, row->m, row->elected, row->correct ? "yes" : "no", row->start,
+           row->runUsec / 1000000, row->runUsec % 1000000, row->msgs, row->degree,
+           row->mPolicy, row->source, row->energyUJ);
+    if (row->syncErrUs == RESLOG_NO_SYNC) {
+        printf(",-,-,-");
+    } else {
+        printf(",%"PRId32",%"PRId32",%"PRIu32"", row->syncStartUs, row->syncEndUs, row->syncErrUs);
+    }
+    for (int i = 0; i < RESLOG_COUNTERS; i++) {
+        printf(",%u", row->counters[i]);
+    }
+    printf("\n");
+}
+
+// Purpose: print one experiment or campaign summary
+//
+// s reslog_summary_t*, the summary
+static void printSummary(reslog_summary_t *s) {
+    if (s->type == RESLOG_CAMPAIGN) {
+        printf("LOG: campaign, %u/%u correct experiments\n", s->reported, s->exp);
+    } else {
+        printf("LOG: experiment %u %s, %u/%u nodes reported, start=%"PRIu32"\n", s->exp,
+               s->correct ? "correct" : "FAILED", s->reported, s->nodes, s->start);
+    }
+    printf("LOG:   converge_us mean=%"PRIu32" p50=%"PRIu32" p90=%"PRIu32" p99=%"PRIu32" max=%"PRIu32"\n",
+           s->runMean, s->runP50, s->runP90, s->runP99, s->runMax);
+    printf("LOG:   messages mean=%"PRIu32" max=%"PRIu32"\n", s->msgsMean, s->msgsMax);
+    if (s->energyCount > 0) {
+        printf("LOG:   energy_uj mean=%"PRIu32" total=%"PRIu32" over %"PRIu32" nodes\n", s->energyMean,
+               s->energyMean * s->energyCount, s->energyCount);
+    }
+}
+
+// Purpose: print the buffered records a failed write left off the flash
+//
+// written uint32_t, bytes of the buffer that made it, a record cut short is printed too
+static void printBuffered(uint32_t written) {
+    union {
+        uint8_t type;
+        reslog_row_t row;
+        reslog_summary_t summary;
+    } rec;
+
+    printf("LOG: unsaved records follow\n");
+    uint32_t off = 0;
+    while (off < bufLen) {
+        uint32_t size = recordSize(buf[off]);
+        if (size == 0 || off + size > bufLen) {
+            break;
+        }
+        if (off + size > written) {
+            memcpy(&rec, buf + off, size);
+            if (rec.type == RESLOG_ROW) {
+                printRow(&rec.row, false);
+            } else if (rec.type != RESLOG_HEADER) {
+                printSummary(&rec.summary);
+            }
+        }
+        off += size;
+    }
+}
+
+// Purpose: start the file with a header, lock must be held and the file empty
+static void writeHeader(void) {
+    reslog_header_t h = { RESLOG_HEADER, RESLOG_VERSION, sizeof(reslog_row_t) };
+    int fd = vfs_open(RESLOG_FILE, O_WRONLY | O_CREAT | O_APPEND, 0);
+    if (fd < 0) {
+        printf("LOG: Error - could not open %s, %d\n", RESLOG_FILE, fd);
+        return;
+    }
+    int res = vfs_write(fd, &h, sizeof(h));
+    if (res > 0) {
+        fileLen += res;
+    }
+    vfs_close(fd);
+}
+
+// Purpose: write out the buffered records, lock must be held. The buffer is
+//          emptied either way, what could not be written is printed, since it
+//          can't be read back later, and counted
+//
+// return 0 on success, negative if records were dropped
+static int flushLocked(void) {
+    if (bufLen == 0) {
+        return 0;
+    }
+
+    int fd = vfs_open(RESLOG_FILE, O_WRONLY | O_CREAT | O_APPEND, 0);
+    if (fd < 0) {
+        dropped += bufLen;
+        printf("LOG: Error - could not open %s, %d, dropped %"PRIu32" bytes (%"PRIu32" total)\n",
+               RESLOG_FILE, fd, bufLen, dropped);
+        printBuffered(0);
+        bufLen = 0;
+        return fd;
+    }
+
+    int ret = 0;
+    int res = vfs_write(fd, buf, bufLen);
+    if (res < (int)bufLen) {
+        dropped += (res > 0) ? bufLen - res : bufLen;
+        printf("LOG: Error - wrote %d of %"PRIu32" bytes (%"PRIu32" dropped total)\n", res, bufLen, dropped);
+        ret = (res < 0) ? res : -EIO;
+        printBuffered((res > 0) ? (uint32_t)res : 0);
+    }
+    if (res > 0) {
+        fileLen += res;
+    }
+    vfs_close(fd);
+    bufLen = 0;
+    return ret;
+}
+
+// Purpose: buffer one record, writes the buffer out first if it won't fit. If
+//          that fails the record is printed rather than kept
+//
+// rec void*, the record
+// size uint32_t, its size
+static void append(void *rec, uint32_t size) {
+    mutex_lock(&lock);
+    if (bufLen + size > RESLOG_BUF_SIZE && flushLocked() < 0) {
+        mutex_unlock(&lock);
+        if (((uint8_t *)rec)[0] == RESLOG_ROW) {
+            printRow((reslog_row_t *)rec, false);
+        } else {
+            printSummary((reslog_summary_t *)rec);
+        }
+        return;
+    }
+    if (bufLen + size <= RESLOG_BUF_SIZE) {
+        memcpy(buf + bufLen, rec, size);
+        bufLen += size;
+    }
+    mutex_unlock(&lock);
+}
+
+// Purpose: mount the flash, formatting it if it has no file system yet
+//
+// return 0 on success, negative if results will only be printed
+int reslog_init(void) {
+    if (enabled) {
+        return 0;
+    }
+
+    fs_desc.dev = MTD_0;
+    int res = vfs_mount(&flash_mount);
+    if (res < 0) {
+        printf("LOG: no file system on flash, formatting\n");
+        res = vfs_format(&flash_mount);
+        if (res == 0) {
+            res = vfs_mount(&flash_mount);
+        }
+    }
+    if (res < 0) {
+        printf("LOG: Error - could not mount %s (%d), results will not be saved\n", RESLOG_MOUNT, res);
+        return res;
+    }
+
+    // a log in another layout can't be read by this build, move it aside
+    reslog_header_t h = { 0 };
+    int fd = vfs_open(RESLOG_FILE, O_RDONLY, 0);
+    if (fd >= 0) {
+        if (vfs_read(fd, &h, sizeof(h)) != (ssize_t)sizeof(h) || h.type != RESLOG_HEADER) {
+            h.version = 0;
+        }
+        off_t end = vfs_lseek(fd, 0, SEEK_END);
+        fileLen = (end > 0) ? (uint32_t)end : 0;
+        vfs_close(fd);
+    }
+    if (fileLen > 0 && (h.version != RESLOG_VERSION || h.rowSize != sizeof(reslog_row_t))) {
+        printf("LOG: %s is layout %u, this build writes %u, moving it to %s\n", RESLOG_FILE,
+               h.version, RESLOG_VERSION, RESLOG_OLD_FILE);
+        vfs_unlink(RESLOG_OLD_FILE);
+        res = vfs_rename(RESLOG_FILE, RESLOG_OLD_FILE);
+        if (res < 0) {
+            printf("LOG: Error - could not move it (%d), clearing it\n", res);
+            vfs_unlink(RESLOG_FILE);
+        }
+        fileLen = 0;
+    }
+    if (fileLen == 0) {
+        writeHeader();
+    }
+
+    enabled = true;
+    printf("LOG: saving results to %s, %"PRIu32" bytes already logged\n", RESLOG_FILE, fileLen);
+    return 0;
+}
+
+// Purpose: log one node's results, printed later by reslog_print
+//
+// row reslog_row_t*, the row, type is filled in here
+void reslog_row(reslog_row_t *row) {
+    row->type = RESLOG_ROW;
+    if (!enabled) {
+        printRow(row, false); // nowhere to keep it
+        return;
+    }
+    append(row, sizeof(reslog_row_t));
+}
+
+// Purpose: log an experiment or campaign summary
+//
+// type uint8_t, RESLOG_EXPERIMENT or RESLOG_CAMPAIGN
+// exp int, experiment number, or experiments run for a campaign
+// correct int, whether the experiment was correct
+// reported int, nodes that reported, or correct experiments for a campaign
+// nodes int, nodes in the experiment
+// start uint32_t, unix time the experiment started
+// run stats_t*, convergence times
+// msgs stats_t*, message counts
+// energy stats_t*, radio energy estimates
+void reslog_summary(uint8_t type, int exp, int correct, int reported, int nodes,
+                    uint32_t start, stats_t *run, stats_t *msgs, stats_t *energy) {
+    if (!enabled) {
+        return;
+    }
+
+    reslog_summary_t s;
+    memset(&s, 0, sizeof(s));
+    s.type = type;
+    s.correct = (correct != 0);
+    s.exp = (uint16_t)exp;
+    s.reported = (uint16_t)reported;
+    s.nodes = (uint16_t)nodes;
+    s.start = start;
+    s.runMean = stats_mean(run);
+    s.runP50 = stats_percentile(run, 50);
+    s.runP90 = stats_percentile(run, 90);
+    s.runP99 = stats_percentile(run, 99);
+    s.runMax = run->max;
+    s.msgsMean = stats_mean(msgs);
+    s.msgsMax = msgs->max;
+    s.energyMean = stats_mean(energy);
+    s.energyCount = energy->count;
+    append(&s, sizeof(s));
+}
+
+// Purpose: position of the next record, to print from later
+uint32_t reslog_mark(void) {
+    mutex_lock(&lock);
+    uint32_t mark = fileLen + bufLen;
+    mutex_unlock(&lock);
+    return mark;
+}
+
+// Purpose: write out whatever is buffered
+void reslog_flush(void) {
+    if (!enabled) {
+        return;
+    }
+    mutex_lock(&lock);
+    flushLocked();
+    mutex_unlock(&lock);
+}
+
+// Purpose: print the log from a mark to the end
+//
+// from uint32_t, where to start, 0 for the whole log
+// dump bool, print everything with experiment numbers rather than just the rows
+void reslog_print(uint32_t from, bool dump) {
+    if (!enabled) {
+        if (dump) {
+            printf("LOG: no flash mounted, nothing saved\n");
+        }
+        return;
+    }
+
+    mutex_lock(&lock);
+    flushLocked();
+
+    int fd = vfs_open(RESLOG_FILE, O_RDONLY, 0);
+    if (fd < 0) {
+        mutex_unlock(&lock);
+        if (dump) {
+            printf("LOG: empty\n");
+        }
+        return;
+    }
+    vfs_lseek(fd, from, SEEK_SET);
+
+    if (dump) {
+        printf("exp,node,m,elected,correct,startTime,runTime,messages,degree,mPolicy,mSource,energyUJ,syncStart,syncEnd,syncErr,%s\n", RESLOG_COUNTER_NAMES);
+    } else {
+        printf("node,m,elected,correct,startTime,runTime,messages,degree,mPolicy,mSource,energyUJ,syncStart,syncEnd,syncErr,%s\n", RESLOG_COUNTER_NAMES);
+    }
+
+    union {
+        uint8_t type;
+        reslog_header_t header;
+        reslog_row_t row;
+        reslog_summary_t summary;
+    } rec;
+    while (vfs_read(fd, &rec.type, 1) == 1) {
+        uint32_t size = recordSize(rec.type);
+        if (size == 0 || vfs_read(fd, (uint8_t*)&rec + 1, size - 1) != (ssize_t)(size - 1)) {
+            printf("LOG: Error - damaged record, stopping\n");
+            break;
+        }
+
+        if (rec.type == RESLOG_ROW) {
+            printRow(&rec.row, dump);
+        } else if (rec.type == RESLOG_HEADER) {
+            if (dump) {
+                printf("LOG: layout %u\n", rec.header.version);
+            }
+        } else if (dump) {
+            printSummary(&rec.summary);
+        }
+    }
+
+    vfs_close(fd);
+    mutex_unlock(&lock);
+}
+
+// Purpose: throw away everything logged so far
+void reslog_clear(void) {
+    if (!enabled) {
+        return;
+    }
+
+    mutex_lock(&lock);
+    bufLen = 0;
+    int res = vfs_unlink(RESLOG_FILE);
+    if (res < 0 && res != -ENOENT) {
+        printf("LOG: Error - could not remove %s, %d\n", RESLOG_FILE, res);
+    }
+    fileLen = 0;
+    writeHeader();
+    mutex_unlock(&lock);
+}
@@ -0,0 +1,96 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Results log for the master. Result rows and experiment summaries are
+ *          kept as fixed size records in a file on flash, so they survive the
+ *          iot-lab terminal closing.
+ */
+
+#ifndef RESLOG_H
+#define RESLOG_H
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "stats.h"
+
+// Log definitions
+#define RESLOG_MOUNT            "/reslog"
+#define RESLOG_FILE             "/reslog/results.bin"
+#define RESLOG_OLD_FILE         "/reslog/results.old"  // a log in an older layout is moved here
+#define RESLOG_VERSION          (2)         // layout of the records, bump it when one changes
+#define RESLOG_MAX_ROWS         (70)        // rows of one experiment, the master's MAX_NODES
+#define RESLOG_NODE_LEN         (20)        // an address suffix, as the master keeps them
+#define RESLOG_SOURCE_LEN       (32)
+#define RESLOG_COUNTERS         (7)
+#define RESLOG_COUNTER_NAMES    "sendFail,recvErr,sockQHigh,msgQHigh,rounds,leaderChanges,pktbufHigh"
+#define RESLOG_NO_SYNC          (0xFFFFFFFF)    // syncErrUs of a worker that never synchronized
+
+// Record types, the first byte of every record
+#define RESLOG_ROW              (1)         // one node's results
+#define RESLOG_EXPERIMENT       (2)         // summary of one experiment
+#define RESLOG_CAMPAIGN         (3)         // summary of every experiment since sync
+#define RESLOG_HEADER           (4)         // opens the file, a log without one is layout 0
+
+// the first record of the file
+typedef struct {
+    uint8_t type;
+    uint8_t version;                        // RESLOG_VERSION when it was written
+    uint16_t rowSize;                       // sizeof(reslog_row_t), as a check
+} reslog_header_t;
+
+// one node's results for one experiment
+typedef struct {
+    uint8_t type;
+    uint8_t correct;
+    uint8_t mPolicy;
+    uint8_t reserved;
+    uint16_t exp;
+    uint16_t degree;
+    uint32_t m;
+    uint32_t start;                         // unix time the experiment started
+    uint32_t runUsec;
+    uint32_t msgs;
+    uint32_t energyUJ;                      // the worker's radio energy estimate, 0 if it sent none
+    int32_t syncStartUs;                    // the worker's start on our clock, usec after ours
+    int32_t syncEndUs;                      // the worker's convergence on our clock, usec after our start
+    uint32_t syncErrUs;                     // error bound of both, RESLOG_NO_SYNC if it had no estimate
+    uint16_t counters[RESLOG_COUNTERS];     // the worker's own counters, see RESLOG_COUNTER_NAMES
+    char node[RESLOG_NODE_LEN];
+    char elected[RESLOG_NODE_LEN];
+    char source[RESLOG_SOURCE_LEN];         // where the node's m value came from
+} reslog_row_t;
+
+// an experiment or the campaign, exp and reported count experiments for a campaign
+typedef struct {
+    uint8_t type;
+    uint8_t correct;
+    uint16_t exp;
+    uint16_t reported;
+    uint16_t nodes;
+    uint32_t start;
+    uint32_t runMean;
+    uint32_t runP50;
+    uint32_t runP90;
+    uint32_t runP99;
+    uint32_t runMax;
+    uint32_t msgsMean;
+    uint32_t msgsMax;
+    uint32_t energyMean;                    // uJ, over the nodes that reported an estimate
+    uint32_t energyCount;
+} reslog_summary_t;
+
+// a whole experiment is buffered and written when it ends, so collecting results never waits on flash
+#define RESLOG_BUF_SIZE         (RESLOG_MAX_ROWS * sizeof(reslog_row_t) + 2 * sizeof(reslog_summary_t))
+
+int reslog_init(void);
+void reslog_row(reslog_row_t *row);
+void reslog_summary(uint8_t type, int exp, int correct, int reported, int nodes,
+                    uint32_t start, stats_t *run, stats_t *msgs, stats_t *energy);
+uint32_t reslog_mark(void);
+void reslog_flush(void);
+void reslog_print(uint32_t from, bool dump);
+void reslog_clear(void);
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Streaming statistics for the master's experiment results. Every summary
+ *          is a Welford mean/variance plus a log-linear histogram for percentiles,
+ *          all in integer math and constant memory.
+ */
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "stats.h"
+
+// the experiment in progress and everything since sync
+static stats_t expRun;
+static stats_t expMsgs;
+static stats_t campRun;
+static stats_t campMsgs;
+static stats_t expEnergy;
+static stats_t campEnergy;
+static int campExperiments = 0;
+
+// Purpose: map a sample to its histogram bucket, exact below STATS_SUB_BUCKETS
+//
+// x uint32_t, the sample
+static int bucketOf(uint32_t x) {
+    if (x < STATS_SUB_BUCKETS) {
+        return (int)x;
+    }
+
+    int p = 31;
+    while (((x >> p) & 1) == 0) {
+        p--;
+    }
+    int sub = (x >> (p - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1);
+    return (p - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS + sub;
+}
+
+// Purpose: the value in the middle of a histogram bucket
+//
+// b int, the bucket index
+static uint32_t bucketMid(int b) {
+    if (b < STATS_SUB_BUCKETS) {
+        return (uint32_t)b;
+    }
+
+    int p = b / STATS_SUB_BUCKETS + STATS_SUB_BITS - 1;
+    int sub = b % STATS_SUB_BUCKETS;
+    uint64_t low = (uint64_t)(STATS_SUB_BUCKETS + sub) << (p - STATS_SUB_BITS);
+    uint64_t width = (uint64_t)1 << (p - STATS_SUB_BITS);
+    return (uint32_t)(low + width/2);
+}
+
+// Purpose: integer square root
+//
+// x uint64_t, the number to take the root of
+static uint32_t isqrt64(uint64_t x) {
+    uint64_t r = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= r + bit) {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        } else {
+            r >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+// Purpose: clear a summary
+//
+// s stats_t*, the summary to clear
+void stats_reset(stats_t *s) {
+    memset(s, 0, sizeof(stats_t));
+}
+
+// Purpose: add one sample to a summary
+//
+// s stats_t*, the summary to update
+// x uint32_t, the sample
+void stats_add(stats_t *s, uint32_t x) {
+    int64_t xq = (int64_t)x << STATS_MEAN_SHIFT;
+
+    if (s->count == 0 || x < s->min) s->min = x;
+    if (s->count == 0 || x > s->max) s->max = x;
+    s->count++;
+
+    // Welford's update, delta and delta2 always share a sign
+    int64_t delta = xq - s->mean;
+    s->mean += delta / (int64_t)s->count;
+    int64_t delta2 = xq - s->mean;
+    if (delta > INT32_MAX || delta < -INT32_MAX) {
+        s->m2 += (uint64_t)((delta >> STATS_MEAN_SHIFT) * (delta2 >> STATS_MEAN_SHIFT));
+    } else {
+        s->m2 += (uint64_t)((delta * delta2) >> (2 * STATS_MEAN_SHIFT));
+    }
+
+    int b = bucketOf(x);
+    if (s->buckets[b] < UINT16_MAX) {
+        s->buckets[b]++;
+    }
+}
+
+// Purpose: the mean of a summary, rounded
+//
+// s stats_t*, the summary
+uint32_t stats_mean(stats_t *s) {
+    return (uint32_t)((s->mean + (1 << (STATS_MEAN_SHIFT - 1))) >> STATS_MEAN_SHIFT);
+}
+
+// Purpose: the sample standard deviation of a summary
+//
+// s stats_t*, the summary
+uint32_t stats_stddev(stats_t *s) {
+    if (s->count < 2) {
+        return 0;
+    }
+    return isqrt64(s->m2 / (s->count - 1));
+}
+
+// Purpose: estimate a percentile from the histogram, within one bucket (1/8 of a power of two)
+//
+// s stats_t*, the summary
+// pct uint32_t, the percentile, 1 to 100
+uint32_t stats_percentile(stats_t *s, uint32_t pct) {
+    if (s->count == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (pct * s->count + 99) / 100;
+    uint32_t seen = 0;
+    uint32_t value = s->max;
+    for (int b = 0; b < STATS_BUCKETS; b++) {
+        seen += s->buckets[b];
+        if (seen >= rank) {
+            value = bucketMid(b);
+            break;
+        }
+    }
+
+    if (value < s->min) value = s->min;
+    if (value > s->max) value = s->max;
+    return value;
+}
+
+// Purpose: print a summary on one line
+//
+// name char*, label for the metric
+// s stats_t*, the summary
+void stats_print(const char *name, stats_t *s) {
+    printf("%s: n=%"PRIu32" mean=%"PRIu32" sd=%"PRIu32" min=%"PRIu32" p50=%"PRIu32" p90=%"PRIu32" p99=%"PRIu32" max=%"PRIu32"\n",
+           name, s->count, stats_mean(s), stats_stddev(s), s->min,
+           stats_percentile(s, 50), stats_percentile(s, 90), stats_percentile(s, 99), s->max);
+}
+
+// Purpose: record one node's results in the experiment and campaign summaries
+//
+// runUsec uint32_t, the node's convergence time
+// msgs uint32_t, messages the node exchanged
+void stats_record(uint32_t runUsec, uint32_t msgs) {
+    stats_add(&expRun, runUsec);
+    stats_add(&expMsgs, msgs);
+    stats_add(&campRun, runUsec);
+    stats_add(&campMsgs, msgs);
+}
+
+// Purpose: record the radio energy one node estimated for its election
+//
+// energyUJ uint32_t, the estimate, uJ
+void stats_record_energy(uint32_t energyUJ) {
+    stats_add(&expEnergy, energyUJ);
+    stats_add(&campEnergy, energyUJ);
+}
+
+// Purpose: total of a summary's samples, from the rounded mean
+//
+// s stats_t*, the summary
+static uint32_t statsTotal(stats_t *s) {
+    return (uint32_t)(((uint64_t)s->mean * s->count) >> STATS_MEAN_SHIFT);
+}
+
+// Purpose: print the experiment's summaries and start fresh ones
+//
+// expNum int, the experiment that just finished
+void stats_end_experiment(int expNum) {
+    printf("STATS: experiment %d\n", expNum);
+    stats_print("STATS:   converge_us", &expRun);
+    stats_print("STATS:   messages", &expMsgs);
+    if (expEnergy.count > 0) {
+        stats_print("STATS:   energy_uj", &expEnergy);
+        printf("STATS:   energy_uj total=%"PRIu32"\n", statsTotal(&expEnergy));
+    }
+
+    stats_reset(&expRun);
+    stats_reset(&expMsgs);
+    stats_reset(&expEnergy);
+    campExperiments++;
+}
+
+// Purpose: print the campaign so far and the experiment in progress
+void stats_dump(void) {
+    printf("STATS: campaign, %d experiments\n", campExperiments);
+    stats_print("STATS:   converge_us", &campRun);
+    stats_print("STATS:   messages", &campMsgs);
+    stats_print("STATS:   energy_uj", &campEnergy);
+    printf("STATS: current experiment\n");
+    stats_print("STATS:   converge_us", &expRun);
+    stats_print("STATS:   messages", &expMsgs);
+    stats_print("STATS:   energy_uj", &expEnergy);
+}
+
+// Purpose: the summaries of the experiment in progress or of the whole campaign
+//
+// campaign bool, which summaries
+// run stats_t**, receives the convergence time summary
+// msgs stats_t**, receives the message count summary
+// energy stats_t**, receives the radio energy summary
+void stats_current(bool campaign, stats_t **run, stats_t **msgs, stats_t **energy) {
+    *run = campaign ? &campRun : &expRun;
+    *msgs = campaign ? &campMsgs : &expMsgs;
+    *energy = campaign ? &campEnergy : &expEnergy;
+}
+
+// Purpose: convert a "<seconds>.<fraction>" runtime from a worker to microseconds
+//
+// seconds char*, the runtime string
+uint32_t stats_parse_usec(const char *seconds) {
+    uint32_t whole = 0;
+    uint32_t frac = 0;
+    int digits = 0;
+    const char *p = seconds;
+
+    while (*p >= '0' && *p <= '9') {
+        whole = whole*10 + (uint32_t)(*p - '0');
+        p++;
+    }
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9' && digits < 6) {
+            frac = frac*10 + (uint32_t)(*p - '0');
+            digits++;
+            p++;
+        }
+    }
+    while (digits < 6) {
+        frac *= 10;
+        digits++;
+    }
+
+    return whole * 1000000 + frac;
+}
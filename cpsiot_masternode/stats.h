@@ -0,0 +1,46 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Streaming statistics for the master's experiment results.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Histogram definitions, log-linear buckets with STATS_SUB_BUCKETS per power of two
+#define STATS_SUB_BITS          (3)
+#define STATS_SUB_BUCKETS       (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS           ((32 - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS)
+#define STATS_MEAN_SHIFT        (4)         // mean is kept in 1/16ths
+
+// a running summary of one metric, constant size however many samples go in
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    int64_t mean;                       // Welford mean, << STATS_MEAN_SHIFT
+    uint64_t m2;                        // Welford sum of squared differences
+    uint16_t buckets[STATS_BUCKETS];    // samples per histogram bucket
+} stats_t;
+
+// generic summaries
+void stats_reset(stats_t *s);
+void stats_add(stats_t *s, uint32_t x);
+uint32_t stats_mean(stats_t *s);
+uint32_t stats_stddev(stats_t *s);
+uint32_t stats_percentile(stats_t *s, uint32_t pct);
+void stats_print(const char *name, stats_t *s);
+
+// experiment results
+void stats_record(uint32_t runUsec, uint32_t msgs);
+void stats_record_energy(uint32_t energyUJ);
+void stats_end_experiment(int expNum);
+void stats_dump(void);
+void stats_current(bool campaign, stats_t **run, stats_t **msgs, stats_t **energy);
+uint32_t stats_parse_usec(const char *seconds);
+
+#endif
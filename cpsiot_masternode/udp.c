@@ -27,10 +27,14 @@
 // Inlcude leader election parameters
 #include "leaderElectionParams.h"
 
+// Experiment statistics and the results log
+#include "stats.h"
+#include "reslog.h"
+
 #define CHANNEL                 11
 
 #define SERVER_MSG_QUEUE_SIZE   (64)
-#define SERVER_BUFFER_SIZE      (128)
+#define SERVER_BUFFER_SIZE      (256)       // room for a convergecast results batch
 #define MAX_IPC_MESSAGE_SIZE    (128)
 #define IPV6_ADDRESS_LEN        (22)
 
@@ -39,6 +43,71 @@
 
 #define DEBUG                   (0)
 
+// Discovery definitions
+#ifndef LE_DISC_QUIET_ROUNDS
+#define LE_DISC_QUIET_ROUNDS    (2)         // ping rounds without a new pong that end discovery
+#endif
+#define LE_DISC_MIN_WAIT        (250000)    // shortest ping interval while pongs keep coming, us
+#define LE_PONG_WINDOW_MS       (500)       // initial window workers spread their pongs over
+#define LE_PONG_WINDOW_MAX_MS   (8000)      // widest window we will ask for
+#define LE_PONG_MARGIN          (250000)    // time after the window for late pongs to land, us
+#define LE_GEN_DISC_ROUNDS      (3)         // two-second rounds the workers get to find neighbors, gen
+
+// Node registry, change at runtime with "registry"
+#define REGISTRY_OFF            (0)         // rediscover the network every experiment
+#define REGISTRY_REUSE          (1)         // probe the known nodes, keep their m values
+#define REGISTRY_RERAND         (2)         // probe the known nodes, draw new m values
+#ifndef LE_REGISTRY
+#define LE_REGISTRY             REGISTRY_OFF
+#endif
+#define LE_REG_PROBE_ROUNDS     (2)         // unicast pings before a silent node is dropped
+#define LE_REG_PROBE_WAIT       (500000)    // time to wait for probe pongs, us
+
+// Result collection definitions
+#define LE_RACK_PERIOD          (500000)    // how often the bitmap of received results goes out, us
+#define LE_RES_MAX_TRIES        (8)         // result sends a worker makes, one histogram bucket each
+
+// Post-election maintenance definitions
+#ifndef LE_HEARTBEAT
+#define LE_HEARTBEAT            (0)         // 1 = workers stay up, collect failover reports
+#endif
+#ifndef LE_HB_MONITOR
+#define LE_HB_MONITOR           (60000000)  // how long to collect failover reports before the next experiment, us
+#endif
+
+// Warm start definitions
+#ifndef LE_WARM_START
+#define LE_WARM_START           (0)         // 1 = keep m values, let workers start warm
+#endif
+
+// Cluster head definitions
+#ifndef LE_CLUSTER_HOPS
+#define LE_CLUSTER_HOPS         (0)         // h > 0 = workers elect a head within h hops
+#endif
+
+// m value policies, change at runtime with "mpolicy"
+#define M_POLICY_RANDOM         (0)         // uniform in 1..254
+#define M_POLICY_RR             (1)         // nodes that led least often get the lowest m
+#define M_POLICY_METRIC         (2)         // least radio energy spent per hour up gets the lowest m
+#ifndef LE_M_POLICY
+#define LE_M_POLICY             M_POLICY_RANDOM
+#endif
+#define LE_M_RR_STEP            (16)        // m range per time led, round-robin
+#define LE_M_ENERGY_SCALE_UJ    (2000000)   // energy per hour up that maps to m=254, metric
+#define LE_M_TX_SCALE           (4000)      // tx packets per hour up that map to m=254, metric without energy
+#define LE_M_MIN_UPTIME_S       (60)        // shorter uptimes count as this much, so a fresh node isn't all noise
+
+// Time sync, every message carries our clock as the workers' reference
+#ifndef LE_TSYNC
+#define LE_TSYNC                (1)
+#endif
+#define TSYNC_HDR_LEN           (16)        // "@<8 hex>.<4 hex>" and the terminator
+
+// Log the m drawn for each node for replay, 0 = no, 1 = yes
+#ifndef LE_RECORD
+#define LE_RECORD               (0)
+#endif
+
 // Forward declarations
 void *_udp_server(void *args);
 int udp_send(int argc, char **argv);
@@ -46,15 +115,18 @@ int udp_send_multi(int argc, char **argv);
 int udp_server(int argc, char **argv);
 int alreadyANeighbor(char **neighbors, char *ipv6);
 int getNeighborIndex(char **neighbors, char *ipv6);
+int overlayNeighbors(int i, int numNodes, int *out);
+int overlayHops(int from, int to, int numNodes);
+int clusterStrays(int *headOf, int *m, char **nodes, int numNodes);
+int assignM(int policy, int led, uint32_t energy, uint32_t tx, uint32_t uptime, char *source, size_t size);
 
 //External functions defs
-extern void substr(char *s, int a, int b, char *t);
 extern int indexOfSemi(char *ipv6);
 extern void extractMsgSegment(char **s, char *t);
 
 // Data structures (i.e. stacks, queues, message structs, etc)
 static char server_buffer[SERVER_BUFFER_SIZE];
-static char server_stack[THREAD_STACKSIZE_DEFAULT];
+static char server_stack[THREAD_STACKSIZE_LARGE];
 static msg_t server_msg_queue[SERVER_MSG_QUEUE_SIZE];
 static sock_udp_t sock;
 
@@ -63,6 +135,46 @@ static bool server_running = false;
 const int SERVER_PORT = 3142;
 uint32_t unixTime;
 uint32_t syncTime;
+uint32_t epoch = 0;         // current experiment, stamped on every message we send
+uint32_t bootId = 0;        // random per boot, on every ping so workers notice we restarted
+int staleDrops = 0;         // messages dropped for carrying an old epoch
+uint16_t tsyncSeq = 0;      // stamps sent, workers only take samples newer than theirs
+
+// Purpose: write our clock for an epoch header, "@<time>.<seq>"
+//
+// buf char*, room for TSYNC_HDR_LEN chars, left empty with LE_TSYNC 0
+void tsyncStamp(char *buf) {
+    if (LE_TSYNC == 0) {
+        buf[0] = '\0';
+        return;
+    }
+    tsyncSeq++;
+    sprintf(buf, "@%08"PRIx32".%04x", xtimer_now_usec(), tsyncSeq);
+}
+
+// Purpose: strip the "<epoch>[@<time>.<seq>]#" header off a received message,
+//          the workers' time stamps are for each other
+//
+// buffer char*, the received message, the header is removed in place
+// return the epoch the message was sent in, 0 if it has no header
+uint32_t stripEpoch(char *buffer) {
+    uint32_t e = 0;
+    char *p = buffer;
+
+    while (*p >= '0' && *p <= '9') {
+        e = e*10 + (uint32_t)(*p - '0');
+        p++;
+    }
+    if (p != buffer && *p == '@') {
+        while (*p != '\0' && *p != '#') p++;
+    }
+    if (p == buffer || *p != '#') {
+        return 0;
+    }
+
+    memmove(buffer, p+1, strlen(p+1)+1);
+    return e;
+}
 
 // Purpose: determine if an ipv6 address is already registered
 //
@@ -86,6 +198,28 @@ int getNeighborIndex(char **neighbors, char *ipv6) {
     return -1;
 }
 
+// Purpose: build the multicast ack of the results received so far, "rack;<hex bitmap>;"
+//
+// msg char*, receives the message
+// confirmed int*, 1 for every node index whose results we have
+// numNodes int, number of nodes in the experiment
+void buildRack(char *msg, int *confirmed, int numNodes) {
+    const char *hex = "0123456789abcdef";
+
+    strcpy(msg, "rack;");
+    int len = strlen(msg);
+    // node i is bit i%4 of hex digit i/4
+    for (int i = 0; i < numNodes; i += 4) {
+        int nibble = 0;
+        for (int b = 0; b < 4 && i+b < numNodes; b++) {
+            if (confirmed[i+b] == 1) nibble |= (1 << b);
+        }
+        msg[len++] = hex[nibble];
+    }
+    msg[len++] = ';';
+    msg[len] = '\0';
+}
+
 // Purpose: return the log base k of x
 //
 // x, the number to take the log of
@@ -94,6 +228,183 @@ float logk(int x, int k) {
     return log10(x) / log10(k);
 }
 
+// Purpose: list the overlay neighbors of node i for the compiled topology
+//
+// i int, index of the node
+// numNodes int, number of nodes in the overlay
+// out int*, receives the neighbor indexes (room for 4)
+// return the number of neighbors, or -1 if the overlay isn't known (gen)
+int overlayNeighbors(int i, int numNodes, int *out) {
+    int count = 0;
+
+    if (strcmp(MY_TOPO,"ring") == 0) {
+        out[count++] = (i == 0) ? numNodes-1 : i-1;
+        out[count++] = (i == numNodes-1) ? 0 : i+1;
+    } else if (strcmp(MY_TOPO,"line") == 0) {
+        if (i > 0) out[count++] = i-1;
+        if (i < numNodes-1) out[count++] = i+1;
+    } else if (strcmp(MY_TOPO,"tree") == 0) {
+        if (i > 0) out[count++] = (i-1)/2;
+        if ((i*2)+1 < numNodes) out[count++] = (i*2)+1;
+        if ((i*2)+2 < numNodes) out[count++] = (i*2)+2;
+    } else if (strcmp(MY_TOPO,"mesh") == 0) {
+        int width = round(sqrt(numNodes));
+        if (i >= width) out[count++] = i - width;
+        if (i % width != 0) out[count++] = i - 1;
+        if (i % width != width - 1 && i + 1 < numNodes) out[count++] = i + 1;
+        if (i + width < numNodes) out[count++] = i + width;
+    } else {
+        return -1;
+    }
+    return count;
+}
+
+// Purpose: count the overlay hops between two nodes with a breadth first search
+//
+// from int, index of the first node
+// to int, index of the second node
+// numNodes int, number of nodes in the overlay
+// return the hop count, or -1 if unreachable or the overlay isn't known
+int overlayHops(int from, int to, int numNodes) {
+    int dist[MAX_NODES];
+    int queue[MAX_NODES];
+    int next[4];
+    int head = 0;
+    int tail = 0;
+
+    if (from < 0 || to < 0 || from >= numNodes || to >= numNodes) {
+        return -1;
+    }
+
+    for (int i = 0; i < numNodes; i++) {
+        dist[i] = -1;
+    }
+    dist[from] = 0;
+    queue[tail++] = from;
+
+    while (head < tail) {
+        int cur = queue[head++];
+        if (cur == to) {
+            return dist[cur];
+        }
+
+        int count = overlayNeighbors(cur, numNodes, next);
+        if (count < 0) {
+            return -1;
+        }
+        for (int n = 0; n < count; n++) {
+            if (dist[next[n]] < 0) {
+                dist[next[n]] = dist[cur] + 1;
+                queue[tail++] = next[n];
+            }
+        }
+    }
+    return -1;
+}
+
+// Purpose: judge cluster mode's heads, by the rule lesim applies too. Every head
+//          heads itself, every node reaches its head within h hops through
+//          members of that cluster, and no lower m (then address) head reaches
+//          it that way. Without an overlay (gen) only the first holds.
+//
+// headOf int*, each node's head index, -1 for a node already counted as failed
+// m int*, each node's m value
+// nodes char**, each node's address, for ties
+// numNodes int, number of nodes in the overlay
+// return the number of nodes with a head that passed the hop check but breaks the rule
+int clusterStrays(int *headOf, int *m, char **nodes, int numNodes) {
+    int best[MAX_NODES];
+    int dist[MAX_NODES];
+    int queue[MAX_NODES];
+    int next[4];
+    int known = (overlayNeighbors(0, numNodes, next) >= 0);
+
+    for (int i = 0; i < numNodes; i++) {
+        best[i] = -1;
+        dist[i] = -1;
+    }
+
+    // from each head out through its own members, the best head to reach each node
+    for (int c = 0; c < numNodes && known; c++) {
+        if (headOf[c] != c) {
+            continue;
+        }
+        int head = 0;
+        int tail = 0;
+        dist[c] = 0;
+        queue[tail++] = c;
+        while (head < tail) {
+            int u = queue[head++];
+            int b = best[u];
+            if (b < 0 || m[c] < m[b] || (m[c] == m[b] && strcmp(nodes[c], nodes[b]) < 0)) {
+                best[u] = c;
+            }
+            if (dist[u] >= LE_CLUSTER_HOPS || (u != c && headOf[u] != c)) {
+                continue;
+            }
+            int count = overlayNeighbors(u, numNodes, next);
+            for (int n = 0; n < count; n++) {
+                if (dist[next[n]] < 0) {
+                    dist[next[n]] = dist[u] + 1;
+                    queue[tail++] = next[n];
+                }
+            }
+        }
+        for (int q = 0; q < tail; q++) {
+            dist[queue[q]] = -1;
+        }
+    }
+
+    int strays = 0;
+    for (int i = 0; i < numNodes; i++) {
+        int c = headOf[i];
+        if (c < 0) {
+            continue;
+        }
+        if (headOf[c] != c || (known && best[i] != c)) {
+            strays++;
+        }
+    }
+    return strays;
+}
+
+// Purpose: pick an m value for a newly discovered node
+//
+// policy int, one of the M_POLICY values
+// led int, times this node has been elected so far
+// energy uint32_t, radio energy the node reported spending, uJ
+// tx uint32_t, packets the node reported sending
+// uptime uint32_t, seconds the node reported being up
+// source char*, receives a short description of where m came from
+// size size_t, size of source, the description is cut to fit
+// return the m value, 1 to 254
+int assignM(int policy, int led, uint32_t energy, uint32_t tx, uint32_t uptime, char *source, size_t size) {
+    uint32_t m;
+
+    if (policy == M_POLICY_RR) {
+        // everyone who led less often ranks below everyone who led more, random within a rank
+        m = (uint32_t)led * LE_M_RR_STEP + (random_uint32() % LE_M_RR_STEP);
+        if (m > 253) m = 253;
+        snprintf(source, size, "rr:%d", led);
+    } else if (policy == M_POLICY_METRIC) {
+        // least loaded per hour up first, since the totals grow with uptime whatever the load,
+        // energy when the node can estimate it, otherwise packets sent
+        uint64_t up = (uptime < LE_M_MIN_UPTIME_S) ? LE_M_MIN_UPTIME_S : uptime;
+        if (energy > 0) {
+            m = (uint32_t)(((uint64_t)energy * 3600 * 253) / (up * LE_M_ENERGY_SCALE_UJ));
+        } else {
+            m = (uint32_t)(((uint64_t)tx * 3600 * 253) / (up * LE_M_TX_SCALE));
+        }
+        if (m > 253) m = 253;
+        snprintf(source, size, "metric:%"PRIu32"uJ/%"PRIu32"tx/%"PRIu32"s", energy, tx, uptime);
+    } else {
+        m = random_uint32() % 254;
+        snprintf(source, size, "rand");
+    }
+
+    return (int)m + 1;
+}
+
 /*
 int getIndexOfSuffix(char* ip) {
     int j;
@@ -113,6 +424,7 @@ void *_udp_server(void *args)
 {
     (void)args;
     printf("UDP: Entered UDP server code\n");
+    reslog_init();
     // socket server setup
     sock_udp_ep_t server = { .port = SERVER_PORT, .family = AF_INET6 };
     sock_udp_ep_t remote;
@@ -131,18 +443,17 @@ void *_udp_server(void *args)
     char tempmessagecount[5] = { 0 };
     int m_values[MAX_NODES] = { 0 };
     int confirmed[MAX_NODES] = { 0 };
+    int headOf[MAX_NODES] = { 0 };      // cluster mode, index of each node's head
     char mStr[5] = { 0 };
     char portBuf[6];
     char codeBuf[10];
     char timeBuf[32];
-    char rconf[6] = "rconf;";
     sprintf(portBuf,"%d",SERVER_PORT);
     uint32_t startTime;
     uint32_t resBegin = 0;
-
-    char offset[15] = { 0 };
-    char seconds[15] = { 0 };
-    char decimal[15] = { 0 };
+    uint32_t logMark = 0;                   // where this experiment's rows start in the results log
+    uint32_t lastRack = 0;                  // when the last results bitmap went out
+    int retryHist[LE_RES_MAX_TRIES] = { 0 };    // results received per send attempt
 
     int numNodes = 0;
     int numNodesFinished = 0;
@@ -152,6 +463,19 @@ void *_udp_server(void *args)
     for(i = 0; i < MAX_NODES; i++) {
         nodes[i] = (char*)calloc(IPV6_ADDRESS_LEN, sizeof(char));
     }
+    char **mSources = (char**)calloc(MAX_NODES, sizeof(char*));  // where each m value came from
+    for(i = 0; i < MAX_NODES; i++) {
+        mSources[i] = (char*)calloc(RESLOG_SOURCE_LEN, sizeof(char));
+    }
+    int mPolicy = LE_M_POLICY;
+
+    // how often each node has been elected, kept for the whole run
+    char **ledNodes = (char**)calloc(MAX_NODES, sizeof(char*));
+    for(i = 0; i < MAX_NODES; i++) {
+        ledNodes[i] = (char*)calloc(IPV6_ADDRESS_LEN, sizeof(char));
+    }
+    int ledCount[MAX_NODES] = { 0 };
+    int numLedNodes = 0;
 
     int numCorrect = 0;
     char **expStarts = (char**)calloc(MAX_EXP, sizeof(char*));
@@ -166,20 +490,44 @@ void *_udp_server(void *args)
 
     int failedNodes = 0;
     int correctNodes = 0;
-    int minMsgs = 0;
-    int maxMsgs = 0;
-    int sumMsgs = 0;
     int min = 257;
     int minIndex = -1;
-    float maxRun = 0.0;
+    uint32_t maxRun = 0;    // slowest node's convergence time, usec
+    int32_t syncMaxEnd = 0; // last convergence on our clock, usec after start
+    uint32_t syncMaxErr = 0;
+    int syncNodes = 0;      // nodes that reported times on our clock
+
+    // previous experiment, used to keep m values for warm starts
+    char **prevNodes = (char**)calloc(MAX_NODES, sizeof(char*));
+    for(i = 0; i < MAX_NODES; i++) {
+        prevNodes[i] = (char*)calloc(IPV6_ADDRESS_LEN, sizeof(char));
+    }
+    int prevM[MAX_NODES] = { 0 };
+    int prevNumNodes = 0;
+    bool prevCorrect = false;
+    int keptM = 0;          // nodes that got their previous m value back
+    int registryMode = LE_REGISTRY;
+    bool probing = false;   // only probing the previous nodes instead of discovering
 
     char msg[SERVER_BUFFER_SIZE] = { 0 };
     char *msgP = (char*)calloc(SERVER_BUFFER_SIZE, sizeof(char));
 
+    // convergecast, records of the last batch still to be handled
+    char *ccQueue = (char*)calloc(SERVER_BUFFER_SIZE, sizeof(char));
+    char ccQueueLeader[IPV6_ADDRESS_LEN] = { 0 };
+    int ccBatches = 0;      // batches this experiment
+
     uint32_t lastDiscover = 0;
     uint32_t wait = 2*1000000;
-    int resetDiscoverLoops = 3;
-    int discoverLoops = 3; // 10sec of discovery
+    int resetDiscoverLoops = 30;
+    int discoverLoops = 30; // upper bound, discovery usually ends once pongs stop
+    uint32_t discoverWait = wait;   // current ping interval
+    uint32_t discoverStart = 0;
+    int quietRounds = 0;            // consecutive rounds without a new node
+    int roundNodes = 0;             // new nodes found in the current round
+    int expectedNodes = 0;          // stop as soon as this many answered, 0 = unknown
+    int discoverRound = 0;          // rounds sent this experiment
+    uint32_t pongWindow = LE_PONG_WINDOW_MS;    // kept across experiments, the deployment doesn't change
 
     // create the socket
     if(sock_udp_create(&sock, &server, NULL, 0) < 0) {
@@ -207,7 +555,16 @@ void *_udp_server(void *args)
 
             //printf("code: %s, param: %s\n", codeBuf, timeBuf);
 
-            if (strncmp(codeBuf,"rounds",6) == 0) {
+            if (strncmp(codeBuf,"registry",8) == 0) {
+                registryMode = atoi(timeBuf);
+                printf("UDP: node registry mode set to %d\n", registryMode);
+            } else if (strncmp(codeBuf,"mpolicy",7) == 0) {
+                mPolicy = atoi(timeBuf);
+                printf("UDP: m value policy set to %d\n", mPolicy);
+            } else if (strncmp(codeBuf,"nodes",5) == 0) {
+                expectedNodes = atoi(timeBuf);
+                printf("UDP: discovery ends once %d nodes answer\n", expectedNodes);
+            } else if (strncmp(codeBuf,"rounds",6) == 0) {
                 int newLoops = atoi(timeBuf);
                 printf("UDP: discover loops changed from %d to %d\n", discoverLoops, newLoops);
                 discoverLoops = newLoops;
@@ -223,9 +580,12 @@ void *_udp_server(void *args)
         res = msg_try_receive(&msg_u_in);
     }
 
+    bootId = random_uint32() | 1;   // never 0, that means no boot id
     int expNum = 1;
     while (numCorrect < MAX_EXP) {  // run the experiment for 10 success
         printf("Starting experiment %d... (%d correct, %d failed)\n", expNum, numCorrect, expNum-numCorrect-1);
+        epoch++;    // anything still in flight from the last run is now stale
+        probing = (registryMode != REGISTRY_OFF && prevNumNodes > 0);
         // main server loop
         while (1) {
             memset(msg, 0, SERVER_BUFFER_SIZE);
@@ -233,12 +593,69 @@ void *_udp_server(void *args)
             memset(server_buffer, 0, SERVER_BUFFER_SIZE);
             memset(ipv6, 0, 30);
 
+            // every expected node answered, no need to wait out the round
+            if (expectedNodes > 0 && numNodes >= expectedNodes) break;
+
+            // known nodes, just check they are still alive
+            if (probing) {
+                if (numNodes == prevNumNodes) break;
+
+                if (lastDiscover + LE_REG_PROBE_WAIT < xtimer_now_usec()) {
+                    if (lastDiscover == 0) {
+                        discoverStart = xtimer_now_usec();
+                    }
+                    if (discoverRound == LE_REG_PROBE_ROUNDS) break;
+
+                    for (i = 0; i < prevNumNodes; i++) {
+                        if (alreadyANeighbor(nodes, prevNodes[i]) == 1) continue;
+
+                        memset(ipv6, 0, 30);
+                        strcat(ipv6, ipv6_prefix);
+                        strcat(ipv6, prevNodes[i]);
+
+                        strcpy(msg, "ping;0;");
+                        char *argsMsg[] = { "udp_send", ipv6, portBuf, msg, NULL };
+                        udp_send(4, argsMsg);
+                    }
+                    memset(msg, 0, SERVER_BUFFER_SIZE);
+                    discoverRound++;
+                    lastDiscover = xtimer_now_usec();
+                }
+            }
+
             // discover nodes
-            if (lastDiscover + wait < xtimer_now_usec()) {
+            if (!probing && lastDiscover + discoverWait < xtimer_now_usec()) {
+                if (lastDiscover == 0) {
+                    discoverStart = xtimer_now_usec();
+                } else if (roundNodes > 0) {
+                    // nodes are still answering, ping again sooner
+                    quietRounds = 0;
+                    discoverWait /= 2;
+                    if (discoverWait < LE_DISC_MIN_WAIT) discoverWait = LE_DISC_MIN_WAIT;
+
+                    // new nodes after the first round means pongs were lost, spread them out more
+                    if (discoverRound > 1 && pongWindow < LE_PONG_WINDOW_MAX_MS) {
+                        pongWindow *= 2;
+                        if (pongWindow > LE_PONG_WINDOW_MAX_MS) pongWindow = LE_PONG_WINDOW_MAX_MS;
+                        printf("UDP: %d late pongs, widening the pong window to %"PRIu32" ms\n", roundNodes, pongWindow);
+                    }
+                } else {
+                    // give stragglers a full interval before calling it done
+                    quietRounds++;
+                    discoverWait = wait;
+                }
+                roundNodes = 0;
+
                 // multicast to find nodes
-                if (discoverLoops == 0) break;
+                if (discoverLoops == 0 || quietRounds >= LE_DISC_QUIET_ROUNDS) break;
+
+                // every pong of the round has to fit before the next ping
+                if (discoverWait < pongWindow * 1000 + LE_PONG_MARGIN) {
+                    discoverWait = pongWindow * 1000 + LE_PONG_MARGIN;
+                }
+                discoverRound++;
 
-                strcpy(msg, "ping;");
+                sprintf(msg, "ping;%"PRIu32";%"PRIu32";", pongWindow, bootId);
                 char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
                 udp_send_multi(3, argsMsg);
                 discoverLoops--;
@@ -263,6 +680,11 @@ void *_udp_server(void *args)
             else {
                 server_buffer[res] = '\0';
                 res = 1;
+                if (stripEpoch(server_buffer) != epoch) {
+                    // left over from an earlier experiment
+                    staleDrops++;
+                    res = 0;
+                }
                 ipv6_addr_to_str(ipv6, (ipv6_addr_t *)&remote.addr.ipv6, 47);
 
                 //int c = getIndexOfSuffix(ipv6);
@@ -293,7 +715,41 @@ void *_udp_server(void *args)
                         if (DEBUG == 1) {
                             printf("UDP: recorded new node, %s\n", nodes[numNodes]);
                         }
-                        m_values[numNodes] = (random_uint32() % 254)+1;
+                        int prev = -1;
+                        if (LE_WARM_START == 1 || registryMode == REGISTRY_REUSE) {
+                            prev = getNeighborIndex(prevNodes, ipv6_unique);
+                        }
+                        if (prev >= 0) {
+                            m_values[numNodes] = prevM[prev]; // same m as last time
+                            strcpy(mSources[numNodes], (LE_WARM_START == 1) ? "warm" : "kept");
+                            keptM++;
+                        } else {
+                            // the load this node reported with its pong
+                            char *mem = server_buffer + 5;
+                            char metric[12] = { 0 };
+                            uint32_t energy = 0, tx = 0, uptime = 0;
+                            if (strlen(mem) > 1) {
+                                extractMsgSegment(&mem, metric);
+                                energy = (uint32_t)strtoul(metric, NULL, 10);
+                                extractMsgSegment(&mem, metric);
+                                tx = (uint32_t)strtoul(metric, NULL, 10);
+                                extractMsgSegment(&mem, metric);
+                                uptime = (uint32_t)strtoul(metric, NULL, 10);
+                            }
+
+                            int led = 0;
+                            int l = getNeighborIndex(ledNodes, ipv6_unique);
+                            if (l >= 0) {
+                                led = ledCount[l];
+                            }
+
+                            m_values[numNodes] = assignM(mPolicy, led, energy, tx, uptime, mSources[numNodes],
+                                                         RESLOG_SOURCE_LEN);
+                            if (LE_RECORD == 1) {
+                                printf("REC: m %"PRIu32" %s %d %s\n", epoch, ipv6_unique, m_values[numNodes],
+                                       mSources[numNodes]);
+                            }
+                        }
 
                         if (m_values[numNodes] < min) {
                             minIndex = numNodes;
@@ -313,10 +769,13 @@ void *_udp_server(void *args)
                         strcat(msg, mStr);
                         strcat(msg, nodes[numNodes]);
                         strcat(msg, ";");
+                        sprintf(mStr, "%d;", numNodes);     // the node's bit in our results acks
+                        strcat(msg, mStr);
 
                         //printf("Confirming %s, sending %s\n", nodes[numNodes], msg);
                         
                         numNodes++;
+                        roundNodes++;
                     
                         // send back discovery confirmation
                         char *argsMsg[] = { "udp_send", ipv6, portBuf, msg, NULL };
@@ -330,6 +789,11 @@ void *_udp_server(void *args)
 
         //if (DEBUG == 1)
             printf("Found %d nodes:\n\n",numNodes);
+        printf("UDP: discovery took %"PRIu32" ms over %d rounds, %d nodes, pong window %"PRIu32" ms\n",
+               (xtimer_now_usec() - discoverStart) / 1000, discoverRound, numNodes, pongWindow);
+        if (probing && numNodes < prevNumNodes) {
+            printf("UDP: %d registered nodes did not answer the probe, dropped\n", prevNumNodes - numNodes);
+        }
 /*
         for (i = 0; i < MAX_NODES; i++) {
             if (strcmp(nodes[i],"") == 0) 
@@ -589,7 +1053,7 @@ void *_udp_server(void *args)
                 xtimer_usleep(10000); // wait .01 seconds
             }
 
-            xtimer_usleep(resetDiscoverLoops * wait); // wait resetDiscoverLoops * wait seconds
+            xtimer_usleep(LE_GEN_DISC_ROUNDS * wait); // give the workers time to find their neighbors
     
         } else if (strcmp(MY_TOPO,"grid") == 0) {
             printf("UDP: generating grid topology\n");
@@ -678,6 +1142,14 @@ void *_udp_server(void *args)
         memset(msg, 0, SERVER_BUFFER_SIZE);
         xtimer_usleep(1000000); // wait 1 second
         startTime = xtimer_now_usec();
+        logMark = reslog_mark();
+
+        // warm start only if exactly the same nodes came back with the same m values,
+        // so the incumbent is alive and still the minimum
+        bool warm = (LE_WARM_START == 1 && prevCorrect && keptM == prevNumNodes && numNodes == prevNumNodes);
+        if (warm) {
+            printf("UDP: warm start, incumbent %s via m=%d\n", nodes[minIndex], min);
+        }
 
         int j;
         for (j = 0; j < 2; j++) {
@@ -696,7 +1168,7 @@ void *_udp_server(void *args)
             }
             */
 
-            strcpy(msg, "start;");
+            strcpy(msg, warm ? "start;warm;" : "start;");
             char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
             udp_send_multi(3, argsMsg);
             xtimer_usleep(100); // wait .0001 seconds
@@ -715,7 +1187,30 @@ void *_udp_server(void *args)
             memset(server_buffer, 0, SERVER_BUFFER_SIZE);
             memset(ipv6, 0, 30);
 
-            if ((res = sock_udp_recv(&sock, server_buffer,
+            if (strcmp(ccQueue, "") != 0) {
+                // next record of a batch, handled as if the node had sent it to us
+                char record[64] = { 0 };
+                char *mem = ccQueue;
+                extractMsgSegment(&mem, record);
+                memmove(ccQueue, mem, strlen(mem)+1);
+
+                // "<node>,<runtime>,<msgs>,<degree>[,<hops>]"
+                char *fields = strchr(record, ',');
+                res = 0;
+                if (fields != NULL) {
+                    *fields = '\0';
+                    fields++;
+                    for (char *c = fields; *c != '\0'; c++) {
+                        if (*c == ',') *c = ';';
+                    }
+
+                    memset(ipv6_unique, 0, 20);
+                    strncpy(ipv6_unique, record, 19);
+                    sprintf(server_buffer, "results;%s;%s;", ccQueueLeader, fields);
+                    res = 1;
+                }
+            }
+            else if ((res = sock_udp_recv(&sock, server_buffer,
                                      sizeof(server_buffer) - 1, 0.005 * US_PER_SEC, //SOCK_NO_TIMEOUT,
                                      &remote)) < 0) {
                 if(res != 0 && res != -ETIMEDOUT && res != -EAGAIN && DEBUG == 1)  {
@@ -729,6 +1224,11 @@ void *_udp_server(void *args)
             else {
                 server_buffer[res] = '\0';
                 res = 1;
+                if (stripEpoch(server_buffer) != epoch) {
+                    // left over from an earlier experiment
+                    staleDrops++;
+                    res = 0;
+                }
                 ipv6_addr_to_str(ipv6, (ipv6_addr_t *)&remote.addr.ipv6, 47);
 
                 int len = strlen(ipv6)-6;
@@ -760,17 +1260,36 @@ void *_udp_server(void *args)
                     break;
 
                 // Getting results from a node
+                } else if (strncmp(server_buffer,"resb;",5) == 0) {
+                    // a batch convergecast up a leader's tree, ack it and handle a record per loop
+                    if (!finished) {
+                        char seq[10] = { 0 };
+                        char *mem = server_buffer;
+                        extractMsgSegment(&mem, codeBuf);   // chop off the resb string
+                        extractMsgSegment(&mem, seq);       // sender's batch number
+                        memset(ccQueueLeader, 0, IPV6_ADDRESS_LEN);
+                        extractMsgSegment(&mem, ccQueueLeader);
+                        strcpy(ccQueue, mem);
+                        ccBatches++;
+
+                        sprintf(msg, "ccack;%s;", seq);
+                        char *argsMsg[] = { "udp_send", ipv6, portBuf, msg, NULL };
+                        udp_send(4, argsMsg);
+                    }
                 } else if (strncmp(server_buffer,"results;",8) == 0) {
                     // If we are already done don't save results anymore
                     if (!finished) {
                         int correct = -1;
 
                         if (numNodesFinished == 0) {
-                            printf("node,m,elected,correct,startTime,runTime,messages\n");
                             resBegin = xtimer_now_usec();
                         }
 
                         int index = getNeighborIndex(nodes,ipv6_unique);
+                        if (index < 0) {
+                            printf("UDP: results from unknown node %s\n", ipv6_unique);
+                            continue;
+                        }
                         if (confirmed[index] == 1) {
                             if (DEBUG == 1)
                                 printf("UDP: node %s was already confirmed\n", ipv6_unique);
@@ -785,15 +1304,6 @@ void *_udp_server(void *args)
                         extractMsgSegment(&mem, tempipv6); // extract the elected IP
                         //printf("UDP: Node %s elected %s as leader\n",ipv6,tempipv6);
 
-                        // determine election correctness
-                        if (strcmp(tempipv6,nodes[minIndex]) == 0) {
-                            correctNodes += 1;
-                            correct = 1;
-                        } else {
-                            failedNodes += 1;
-                            correct = 0;
-                        }
-
                         memset(tempunixtime, 0, 15);
                         memset(tempunixsec, 0, 15);
                         memset(tempdegree, 0, 15);
@@ -801,59 +1311,121 @@ void *_udp_server(void *args)
                         extractMsgSegment(&mem, tempunixsec);
                         extractMsgSegment(&mem, tempmessagecount); // Extract the message count
                         extractMsgSegment(&mem, tempdegree); // degree
+
+                        if (LE_CLUSTER_HOPS > 0) {
+                            // cluster mode, the head has to be within h hops over the overlay
+                            memset(mStr, 0, 5);
+                            extractMsgSegment(&mem, mStr);  // hops the node counted to its head
+                            int head = getNeighborIndex(nodes, tempipv6);
+                            int hops = overlayHops(index, head, numNodes);
+                            if (hops < 0) {
+                                hops = atoi(mStr); // no overlay to check against (gen), trust the node
+                            }
+                            correct = (head >= 0 && hops <= LE_CLUSTER_HOPS) ? 1 : 0;
+                            headOf[index] = correct ? head : -1;
+                        } else {
+                            // determine election correctness
+                            correct = (strcmp(tempipv6,nodes[minIndex]) == 0) ? 1 : 0;
+                        }
+
+                        // which send of its results this was, batches don't say
+                        int attempt = 0;
+                        if (strlen(mem) > 0) {
+                            memset(mStr, 0, 5);
+                            extractMsgSegment(&mem, mStr);
+                            attempt = atoi(mStr);
+                        }
+                        if (attempt >= LE_RES_MAX_TRIES) attempt = LE_RES_MAX_TRIES-1;
+                        retryHist[attempt]++;
+
+                        // the worker's counters for the experiment, batches don't carry them
+                        uint16_t counters[RESLOG_COUNTERS] = { 0 };
+                        if (strlen(mem) > 0) {
+                            char counterStr[64] = { 0 };
+                            extractMsgSegment(&mem, counterStr);
+                            char *c = counterStr;
+                            for (int k = 0; k < RESLOG_COUNTERS && *c != '\0'; k++) {
+                                counters[k] = (uint16_t)strtoul(c, &c, 10);
+                                if (*c == ',') c++;
+                            }
+                        }
+
+                        // the worker's radio energy estimate for the election
+                        uint32_t energyUJ = 0;
+                        if (strlen(mem) > 0) {
+                            char energyStr[12] = { 0 };
+                            extractMsgSegment(&mem, energyStr);
+                            energyUJ = (uint32_t)strtoul(energyStr, NULL, 10);
+                            stats_record_energy(energyUJ);
+                        }
+
+                        // start and end on our clock, "-" if the worker never synchronized
+                        int32_t syncStart = 0;
+                        int32_t syncEnd = 0;
+                        uint32_t syncErr = RESLOG_NO_SYNC;
+                        if (strlen(mem) > 0) {
+                            char syncStr[36] = { 0 };
+                            extractMsgSegment(&mem, syncStr);
+                            char *c = syncStr;
+                            if (*c != '-') {
+                                syncStart = (int32_t)((uint32_t)strtoul(c, &c, 10) - startTime);
+                                if (*c == ',') c++;
+                                syncEnd = (int32_t)((uint32_t)strtoul(c, &c, 10) - startTime);
+                                if (*c == ',') c++;
+                                syncErr = (uint32_t)strtoul(c, NULL, 10);
+
+                                if (syncNodes == 0 || syncEnd > syncMaxEnd) syncMaxEnd = syncEnd;
+                                if (syncErr > syncMaxErr) syncMaxErr = syncErr;
+                                syncNodes++;
+                            }
+                        }
+
+                        if (correct) {
+                            correctNodes += 1;
+                        } else {
+                            failedNodes += 1;
+                        }
                         //printf("UDP: Node %s exchanged %s messages\n",ipv6,tempmessagecount);
 
-                        float tempRun = atof(tempunixsec);
-                        if (tempRun > maxRun) {
-                            maxRun = tempRun;
+                        uint32_t runUsec = stats_parse_usec(tempunixsec);
+                        if (runUsec > maxRun) {
+                            maxRun = runUsec;
                             memset(temprunsec, 0, 15);
-                            strncpy(temprunsec, tempunixsec, 15);
+                            strncpy(temprunsec, tempunixsec, 14);
                         }
 
                         int msgs = atoi(tempmessagecount);
-                        if (minMsgs == 0 || msgs < minMsgs)
-                            minMsgs = msgs;
-                        if (maxMsgs == 0 || msgs > maxMsgs)
-                            maxMsgs = msgs;
-                        sumMsgs += msgs;
+                        stats_record(runUsec, (uint32_t)msgs);
 
                         int degree = atoi(tempdegree);
 
-                        // offset unix time
-                        uint32_t offValue = startTime - syncTime;
-                        int digits = 0;
-
-                        memset(offset, 0, 15);
-                        memset(seconds, 0, 15);
-                        memset(decimal, 0, 15);
-
-                        if (offValue >= 1000000) {
-                            digits = 6;
-                        } else if (offValue >= 100000) {
-                            digits = 5;
-                        } else if (offValue >= 10000) {
-                            digits = 4;
-                        } // smaller shouldn't happen ever
-
-                        if (digits == 6) {
-                            // last 6 is fractional seconds, before that is seconds
-                            sprintf(offset, "%"PRIu32, offValue);
-                            substr(offset, 0, strlen(offset)-6, seconds);
-                            substr(offset, strlen(offset)-6, 6, decimal);
-
-                            sprintf(tempunixtime, "%"PRIu32, unixTime + atoi(seconds));
-                        } else  {
-                            // value is fractional seconds, 0 whole seconds
-                            sprintf(tempunixtime, "%"PRIu32, unixTime);
-                        }
-
-                        printf("%s,%d,%s,%s,%s,%s,%s,%d\n", ipv6_unique, m_values[index], tempipv6, correct ? "yes" : "no", tempunixtime, tempunixsec, tempmessagecount, degree);
+                        // unix time the experiment started, whole seconds
+                        uint32_t expStart = unixTime + (startTime - syncTime) / US_PER_SEC;
+                        sprintf(tempunixtime, "%"PRIu32, expStart);
+
+                        // logged now, printed once collection is over
+                        reslog_row_t row;
+                        memset(&row, 0, sizeof(row));
+                        row.correct = (uint8_t)correct;
+                        row.mPolicy = (uint8_t)mPolicy;
+                        row.exp = (uint16_t)expNum;
+                        row.degree = (uint16_t)degree;
+                        row.m = (uint32_t)m_values[index];
+                        row.start = expStart;
+                        row.runUsec = runUsec;
+                        row.msgs = (uint32_t)msgs;
+                        row.energyUJ = energyUJ;
+                        row.syncStartUs = syncStart;
+                        row.syncEndUs = syncEnd;
+                        row.syncErrUs = syncErr;
+                        memcpy(row.counters, counters, sizeof(counters));
+                        strncpy(row.node, ipv6_unique, RESLOG_NODE_LEN-1);
+                        strncpy(row.elected, tempipv6, RESLOG_NODE_LEN-1);
+                        strncpy(row.source, mSources[index], RESLOG_SOURCE_LEN-1);
+                        reslog_row(&row);
 
                         numNodesFinished++;
 
-                        char *argsMsg[] = { "udp_send", ipv6, portBuf, rconf, NULL };
-                        udp_send(4, argsMsg);
-
                         //printf("UDP: %d nodes reported so far\n",numNodesFinished);
                         if (numNodesFinished >= numNodes) {
                             //printf("In finish block\n");
@@ -863,6 +1435,30 @@ void *_udp_server(void *args)
                             //printf("AvgMsgs: %d/%d msgs\n", sumMsgs, numNodesFinished);
 
                             printf("\nUDP: All nodes have reported!\n");
+
+                            // last ack, so nobody keeps retrying
+                            buildRack(msg, confirmed, numNodes);
+                            char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
+                            udp_send_multi(3, argsMsg);
+                            if (ccBatches > 0) {
+                                printf("UDP: results arrived in %d batches\n", ccBatches);
+                            }
+
+                            if (LE_CLUSTER_HOPS > 0) {
+                                // a head that follows some other head leaves its members stranded,
+                                // and a node must take the best head that reaches it
+                                int heads = 0;
+                                for (i = 0; i < numNodes; i++) {
+                                    if (headOf[i] == i) {
+                                        heads++;
+                                    }
+                                }
+                                int strays = clusterStrays(headOf, m_values, nodes, numNodes);
+                                correctNodes -= strays;
+                                failedNodes += strays;
+                                printf("UDP: %d cluster heads within %d hops, %d nodes with the wrong head\n",
+                                       heads, LE_CLUSTER_HOPS, strays);
+                            }
                             finished = 1;
                             //printf("Before finish block break statement\n");
                             break; // terminate
@@ -871,6 +1467,15 @@ void *_udp_server(void *args)
                 }
             }
             
+            // tell the workers whose results we have, they stop resending once they see their bit
+            if (resBegin > 0 && xtimer_now_usec() - lastRack >= LE_RACK_PERIOD) {
+                memset(msg, 0, SERVER_BUFFER_SIZE);
+                buildRack(msg, confirmed, numNodes);
+                char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
+                udp_send_multi(3, argsMsg);
+                lastRack = xtimer_now_usec();
+            }
+
             uint32_t timeout = (uint32_t)((numNodes+1)/2);
             if (timeout < 20) timeout = 20;
             if (resBegin > 0 && xtimer_now_usec() - resBegin >= timeout * 1000000) {
@@ -883,6 +1488,29 @@ void *_udp_server(void *args)
             //xtimer_usleep(5000); // wait 0.005 seconds
         }
         //printf("After experiment loop\n");
+        reslog_print(logMark, false);
+
+        // how many sends it took the workers to get their results to us
+        printf("UDP: results by send attempt:");
+        for (i = 0; i < LE_RES_MAX_TRIES; i++) {
+            printf(" %d:%d", i+1, retryHist[i]);
+        }
+        printf("\n");
+
+        // measured on one clock, from our start multicast to the last node converging
+        if (syncNodes > 0) {
+            printf("UDP: global convergence %"PRId32" us (+/- %"PRIu32" us), %d of %d nodes synchronized\n",
+                   syncMaxEnd, syncMaxErr, syncNodes, numNodesFinished);
+        }
+
+        stats_t *runStats;
+        stats_t *msgStats;
+        stats_t *energyStats;
+        stats_current(false, &runStats, &msgStats, &energyStats);
+        reslog_summary(RESLOG_EXPERIMENT, expNum, correctNodes == numNodesFinished, numNodesFinished, numNodes,
+                       unixTime + (startTime - syncTime) / US_PER_SEC, runStats, msgStats, energyStats);
+        reslog_flush();
+        stats_end_experiment(expNum);
 
         if (correctNodes == numNodesFinished) {
             //experiment was correct
@@ -896,51 +1524,156 @@ void *_udp_server(void *args)
         } else {
             printf("********ABOVE EXPERIMENT FAILED********\n\n");
         }
+
+        if (LE_HEARTBEAT == 1) {
+            // workers stay up watching the leader, so just collect their failover reports
+            // until every survivor has reported or the time is up, the next ping ends their watch
+            printf("UDP: election complete, monitoring for leader failover for %d s\n", (int)(LE_HB_MONITOR / US_PER_SEC));
+            printf("failover,node,failedLeader,newLeader,detectTime,failoverTime,reelectTime,messages,ofConvergence\n");
+            int failovers = 0;
+            uint32_t maxReelect = 0;
+            uint32_t monitorStart = xtimer_now_usec();
+            while (failovers < numNodes - 1 && xtimer_now_usec() - monitorStart < LE_HB_MONITOR) {
+                memset(msg, 0, SERVER_BUFFER_SIZE);
+                memset(server_buffer, 0, SERVER_BUFFER_SIZE);
+                memset(ipv6, 0, 30);
+
+                int res;
+                uint32_t left = LE_HB_MONITOR - (xtimer_now_usec() - monitorStart);
+                if ((res = sock_udp_recv(&sock, server_buffer,
+                                         sizeof(server_buffer) - 1, left,
+                                         &remote)) <= 0) {
+                    continue;
+                }
+                server_buffer[res] = '\0';
+                if (stripEpoch(server_buffer) != epoch) {
+                    staleDrops++;
+                    continue;
+                }
+                ipv6_addr_to_str(ipv6, (ipv6_addr_t *)&remote.addr.ipv6, 47);
+
+                int len = strlen(ipv6)-6;
+                memset(ipv6_unique, 0, IPV6_ADDRESS_LEN);
+                strncpy(ipv6_unique, ipv6+6, len);
+                ipv6_unique[len] = '\0';
+
+                if (strncmp(server_buffer,"failover;",9) == 0) {
+                    char newLeader[IPV6_ADDRESS_LEN] = { 0 };
+                    char detect[15] = { 0 };
+                    char failover[15] = { 0 };
+                    char msgCount[10] = { 0 };
+
+                    strcpy(msg, server_buffer);
+                    char *mem = msg;
+                    extractMsgSegment(&mem, codeBuf);   // chop off the failover string
+                    extractMsgSegment(&mem, newLeader); // the re-elected leader
+                    extractMsgSegment(&mem, tempipv6);  // the leader that was lost
+                    extractMsgSegment(&mem, detect);    // usec from last heartbeat to detection
+                    extractMsgSegment(&mem, failover);  // usec from last heartbeat to new leader
+                    extractMsgSegment(&mem, msgCount);  // messages spent on the failover
+
+                    // the re-election itself against the full election this experiment ran,
+                    // in hundredths, detection is the heartbeat period times the misses
+                    uint32_t detectUsec = (uint32_t)strtoul(detect, NULL, 10);
+                    uint32_t failoverUsec = (uint32_t)strtoul(failover, NULL, 10);
+                    uint32_t reelectUsec = (failoverUsec > detectUsec) ? failoverUsec - detectUsec : 0;
+                    uint32_t ratio = (maxRun > 0) ? (uint32_t)(((uint64_t)reelectUsec * 100) / maxRun) : 0;
+                    if (reelectUsec > maxReelect) {
+                        maxReelect = reelectUsec;
+                    }
+
+                    failovers++;
+                    printf("%d,%s,%s,%s,%s,%s,%"PRIu32",%s,%"PRIu32".%02"PRIu32"\n", failovers, ipv6_unique, tempipv6,
+                           newLeader, detect, failover, reelectUsec, msgCount, ratio / 100, ratio % 100);
+                }
+            }
+
+            if (failovers > 0 && maxRun > 0) {
+                uint32_t ratio = (uint32_t)(((uint64_t)maxReelect * 100) / maxRun);
+                printf("UDP: %d failover reports, slowest re-election %"PRIu32" us, %"PRIu32".%02"PRIu32" of the %"PRIu32" us election\n",
+                       failovers, maxReelect, ratio / 100, ratio % 100, maxRun);
+            } else {
+                printf("UDP: %d failover reports\n", failovers);
+            }
+        }
         //printf("Resetting all vars\n");
         
         memset(tempunixtime, 0, 15);
         memset(temprunsec, 0, 15);
 
+        // remember who led, the round-robin policy rotates away from them
+        if (minIndex >= 0) {
+            int l = getNeighborIndex(ledNodes, nodes[minIndex]);
+            if (l < 0 && numLedNodes < MAX_NODES) {
+                l = numLedNodes++;
+                strcpy(ledNodes[l], nodes[minIndex]);
+            }
+            if (l >= 0) {
+                ledCount[l] += 1;
+            }
+        }
+
+        // keep this registry around to seed the next experiment
+        if (LE_WARM_START == 1 || registryMode != REGISTRY_OFF) {
+            for(i = 0; i < MAX_NODES; i++) {
+                memset(prevNodes[i], 0, IPV6_ADDRESS_LEN);
+                strcpy(prevNodes[i], nodes[i]);
+                prevM[i] = m_values[i];
+            }
+            prevNumNodes = numNodes;
+            prevCorrect = (correctNodes == numNodesFinished && numNodesFinished == numNodes);
+        }
+        keptM = 0;
+
         // reset variables
         for(i = 0; i < MAX_NODES; i++) {
             memset(nodes[i], 0, IPV6_ADDRESS_LEN);
             m_values[i] = 0;
             confirmed[i] = 0;
+            headOf[i] = 0;
+            memset(mSources[i], 0, RESLOG_SOURCE_LEN);
         }
 
         numNodes = 0;
         numNodesFinished = 0;
         finished = 0;
         resBegin = 0;
+        memset(ccQueue, 0, SERVER_BUFFER_SIZE);
+        ccBatches = 0;
+        lastRack = 0;
+        memset(retryHist, 0, sizeof(retryHist));
 
         failedNodes = 0;
         correctNodes = 0;
-        minMsgs = 0;
-        maxMsgs = 0;
-        sumMsgs = 0;
         min = 257;
         minIndex = -1;
-        maxRun = 0.0;
+        maxRun = 0;
+        syncMaxEnd = 0;
+        syncMaxErr = 0;
+        syncNodes = 0;
 
         lastDiscover = 0;
         discoverLoops = resetDiscoverLoops;
+        discoverWait = wait;
+        quietRounds = 0;
+        roundNodes = 0;
+        discoverRound = 0;
 
-        int z = 20;
-        while (z > 0) {
-            //printf("clearing queue");
-            sock_udp_recv(&sock, server_buffer,
-                 SERVER_BUFFER_SIZE - 1, 0, //SOCK_NO_TIMEOUT,
-                 &remote);
-            z -= 1;
-        }
-
+        // no need to drain the socket or wait, late packets from this run
+        // carry the old epoch and get dropped on arrival
         if (DEBUG == 1)
-            printf("Variables reset, starting next experiment in 5 seconds\n");
-        
-        xtimer_usleep(5000000); // wait 5 seconds
+            printf("Variables reset, %d stale messages dropped so far\n", staleDrops);
+
         expNum++;
     }
 
+    stats_t *runStats;
+    stats_t *msgStats;
+    stats_t *energyStats;
+    stats_current(true, &runStats, &msgStats, &energyStats);
+    reslog_summary(RESLOG_CAMPAIGN, expNum, 0, numCorrect, numNodes, unixTime, runStats, msgStats, energyStats);
+    reslog_flush();
+
     // output run info for power processing script
     printf("\n%d/%d correct experiment results:\n", numCorrect, expNum);
     for(i = 0; i < numCorrect; i++) {
@@ -960,8 +1693,14 @@ void *_udp_server(void *args)
 
     for(i = 0; i < MAX_NODES; i++) {
         free(nodes[i]);
+        free(prevNodes[i]);
+        free(mSources[i]);
+        free(ledNodes[i]);
     }
     free(nodes);
+    free(prevNodes);
+    free(mSources);
+    free(ledNodes);
     free(msgP);
 
     return NULL;
@@ -975,6 +1714,8 @@ int udp_send(int argc, char **argv)
 {
     int res;
     sock_udp_ep_t remote = { .family = AF_INET6 };
+    char tagged[SERVER_BUFFER_SIZE+12+TSYNC_HDR_LEN];
+    char stamp[TSYNC_HDR_LEN];
 
     if (argc != 4) {
         if (DEBUG == 1)
@@ -995,7 +1736,9 @@ int udp_send(int argc, char **argv)
     }
 
     remote.port = atoi(argv[2]);
-    if((res = sock_udp_send(NULL, argv[3], strlen(argv[3]), &remote)) < 0) {
+    tsyncStamp(stamp);
+    sprintf(tagged, "%"PRIu32"%s#%s", epoch, stamp, argv[3]);
+    if((res = sock_udp_send(NULL, tagged, strlen(tagged), &remote)) < 0) {
         if (DEBUG == 1)
             printf("UDP: Error - could not send message \"%s\" to %s\n", argv[3], argv[1]);
     }
@@ -1017,6 +1760,8 @@ int udp_send_multi(int argc, char **argv)
     int res;
     sock_udp_ep_t remote = { .family = AF_INET6 };
     char ipv6[IPV6_ADDRESS_LEN] = { 0 };
+    char tagged[SERVER_BUFFER_SIZE+12+TSYNC_HDR_LEN];
+    char stamp[TSYNC_HDR_LEN];
 
     if (argc != 3) {
         if (DEBUG == 1)
@@ -1033,7 +1778,9 @@ int udp_send_multi(int argc, char **argv)
     }
     remote.port = atoi(argv[1]);
     ipv6_addr_to_str(ipv6, (ipv6_addr_t *)&remote.addr.ipv6, IPV6_ADDRESS_LEN);
-    if((res = sock_udp_send(NULL, argv[2], strlen(argv[2]), &remote)) < 0) {
+    tsyncStamp(stamp);
+    sprintf(tagged, "%"PRIu32"%s#%s", epoch, stamp, argv[2]);
+    if((res = sock_udp_send(NULL, tagged, strlen(tagged), &remote)) < 0) {
         if (DEBUG == 1)
             printf("UDP: Error - could not send message \"%s\" to %s\n", argv[2], ipv6);
     }
@@ -0,0 +1,74 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Radio energy estimates from the netstats_l2 counters of the first
+ *          interface. Works the same on native, so energy can be compared across
+ *          K, T and topologies without the testbed's monitoring profile.
+ */
+
+// Standard C includes
+#include <stdint.h>
+#include <string.h>
+
+// Networking includes
+#include "net/gnrc/netif.h"
+#include "net/gnrc/netapi.h"
+#include "net/netstats.h"
+
+#include "energy.h"
+
+// Purpose: read the layer 2 counters of the first interface
+//
+// return the netstats_l2 counters, or NULL if they aren't available
+netstats_t *energy_l2_stats(void) {
+    netstats_t *stats = NULL;
+    gnrc_netif_t *netif = gnrc_netif_iter(NULL);
+
+    if (netif == NULL || gnrc_netapi_get(netif->pid, NETOPT_STATS, NETSTATS_LAYER2,
+                                         &stats, sizeof(&stats)) < 0) {
+        return NULL;
+    }
+    return stats;
+}
+
+// Purpose: copy the counters the energy model needs
+//
+// snap energy_snapshot_t*, receives the counters, all 0 without netstats
+void energy_snapshot(energy_snapshot_t *snap) {
+    netstats_t *stats = energy_l2_stats();
+
+    memset(snap, 0, sizeof(energy_snapshot_t));
+    if (stats == NULL) {
+        return;
+    }
+    snap->txBytes = stats->tx_bytes;
+    snap->rxBytes = stats->rx_bytes;
+    snap->txPackets = stats->tx_unicast_count + stats->tx_mcast_count;
+    snap->rxPackets = stats->rx_count;
+}
+
+// Purpose: estimate the radio energy spent between two snapshots
+//
+// from energy_snapshot_t*, the earlier counters
+// to energy_snapshot_t*, the later counters
+// return the estimate in uJ
+uint32_t energy_between(energy_snapshot_t *from, energy_snapshot_t *to) {
+    // the counters wrap, unsigned differences stay right across one wrap
+    uint64_t nj = (uint64_t)(to->txBytes - from->txBytes) * LE_E_TX_NJ_PER_BYTE +
+                  (uint64_t)(to->rxBytes - from->rxBytes) * LE_E_RX_NJ_PER_BYTE +
+                  (uint64_t)(to->txPackets - from->txPackets) * LE_E_TX_NJ_PER_PKT +
+                  (uint64_t)(to->rxPackets - from->rxPackets) * LE_E_RX_NJ_PER_PKT;
+    return (uint32_t)(nj / 1000);
+}
+
+// Purpose: estimate the radio energy this node has spent since boot
+//
+// return the estimate in uJ
+uint32_t energy_since_boot(void) {
+    energy_snapshot_t zero;
+    energy_snapshot_t now;
+
+    memset(&zero, 0, sizeof(zero));
+    energy_snapshot(&now);
+    return energy_between(&zero, &now);
+}
@@ -0,0 +1,45 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Radio energy estimates from the netstats_l2 counters, with a per byte
+ *          and per packet model of the AT86RF231.
+ */
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+// Standard C includes
+#include <stdint.h>
+
+// Standard RIOT includes
+#include "net/netstats.h"
+
+// AT86RF231 at 3V and 250kbps, 32us per byte on air. Per packet costs cover the
+// 6 byte synchronization header and PHY header the byte counters leave out.
+#ifndef LE_E_TX_NJ_PER_BYTE
+#define LE_E_TX_NJ_PER_BYTE     (1344)      // 14mA TX_ON
+#endif
+#ifndef LE_E_RX_NJ_PER_BYTE
+#define LE_E_RX_NJ_PER_BYTE     (1181)      // 12.3mA RX_ON
+#endif
+#ifndef LE_E_TX_NJ_PER_PKT
+#define LE_E_TX_NJ_PER_PKT      (8064)      // 6 header bytes at TX current
+#endif
+#ifndef LE_E_RX_NJ_PER_PKT
+#define LE_E_RX_NJ_PER_PKT      (7086)      // 6 header bytes at RX current
+#endif
+
+// the layer 2 counters at one point in time
+typedef struct {
+    uint32_t txBytes;
+    uint32_t rxBytes;
+    uint32_t txPackets;
+    uint32_t rxPackets;
+} energy_snapshot_t;
+
+netstats_t *energy_l2_stats(void);
+void energy_snapshot(energy_snapshot_t *snap);
+uint32_t energy_between(energy_snapshot_t *from, energy_snapshot_t *to);
+uint32_t energy_since_boot(void);
+
+#endif
@@ -0,0 +1,294 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Link impairments, see impair.h. Gilbert-Elliott state is kept per
+ *          link, so a burst on one link doesn't spill onto the others.
+ */
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "impair.h"
+
+// Purpose: next number from the generator, xorshift32
+//
+// im impair_t*, the model
+static uint32_t draw(impair_t *im) {
+    uint32_t x = im->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    im->rng = x;
+    return x;
+}
+
+// Purpose: does an event of some probability happen
+//
+// im impair_t*, the model
+// ppm uint32_t, its probability, parts per million
+static bool chance(impair_t *im, uint32_t ppm) {
+    if (ppm == 0) {
+        return false;
+    }
+    return draw(im) % IMPAIR_PPM < ppm;
+}
+
+// Purpose: the state of a link, added on first sight
+//
+// im impair_t*, the model
+// addr char*, the other end
+static impair_link_t *linkOf(impair_t *im, const char *addr) {
+    for (int i = 0; i < im->numLinks; i++) {
+        if (strcmp(im->link[i].addr, addr) == 0) {
+            return &im->link[i];
+        }
+    }
+    if (im->numLinks >= IMPAIR_MAX_LINKS) {
+        return &im->other;
+    }
+
+    impair_link_t *l = &im->link[im->numLinks++];
+    memset(l, 0, sizeof(*l));
+    strncpy(l->addr, addr, IMPAIR_ADDR_LEN-1);
+    l->loss = IMPAIR_DEFAULT;
+    return l;
+}
+
+// Purpose: parse a percentage into ppm
+//
+// s char*, e.g. "2.5"
+// ppm uint32_t*, receives it
+// return false if it isn't a percentage
+static bool parsePct(const char *s, uint32_t *ppm) {
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0' || v < 0 || v > 100) {
+        return false;
+    }
+    *ppm = (uint32_t)(v * (IMPAIR_PPM / 100) + 0.5);
+    return true;
+}
+
+// Purpose: parse a time in usec
+//
+// s char*, the number
+// us uint32_t*, receives it
+// return false if it isn't a number
+static bool parseUs(const char *s, uint32_t *us) {
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s || *end != '\0') {
+        return false;
+    }
+    *us = (uint32_t)v;
+    return true;
+}
+
+// Purpose: print ppm as a percentage
+//
+// ppm uint32_t, the probability
+static void printPct(uint32_t ppm) {
+    printf("%"PRIu32".%04"PRIu32"%%", ppm / 10000, ppm % 10000);
+}
+
+// Purpose: set up a model that lets everything through
+//
+// im impair_t*, the model
+// seed uint32_t, generator seed
+void impair_init(impair_t *im, uint32_t seed) {
+    memset(im, 0, sizeof(*im));
+    im->other.loss = IMPAIR_DEFAULT;
+    impair_seed(im, seed);
+}
+
+// Purpose: restart the generator and the link states, so a run can be repeated
+//
+// im impair_t*, the model
+// seed uint32_t, generator seed
+void impair_seed(impair_t *im, uint32_t seed) {
+    // xorshift can't leave zero, and nearby seeds should give unrelated streams
+    im->rng = (seed * 2654435761u) ^ 0x9e3779b9u;
+    if (im->rng == 0) {
+        im->rng = 1;
+    }
+    for (int i = 0; i < im->numLinks; i++) {
+        im->link[i].bad = false;
+    }
+    im->other.bad = false;
+}
+
+// Purpose: is anything being done to packets
+//
+// im impair_t*, the model
+bool impair_active(const impair_t *im) {
+    const impair_conf_t *c = &im->conf;
+    if (c->loss || c->geP || c->delay || c->jitter || c->dup || c->reorder) {
+        return true;
+    }
+    for (int i = 0; i < im->numLinks; i++) {
+        if (im->link[i].loss > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Purpose: give one link its own loss
+//
+// im impair_t*, the model
+// addr char*, the other end
+// loss int32_t, ppm, IMPAIR_DEFAULT to go back to the configured loss
+// return 0, -1 if the table is full
+int impair_set_link(impair_t *im, const char *addr, int32_t loss) {
+    impair_link_t *l = linkOf(im, addr);
+    if (l == &im->other) {
+        return -1;
+    }
+    l->loss = loss;
+    return 0;
+}
+
+// Purpose: decide the fate of one packet
+//
+// im impair_t*, the model
+// peer char*, the other end of the link
+// delay uint32_t[2], receives the delay of each copy, usec
+// return copies to deliver, 0 = lost, 2 = duplicated
+int impair_packet(impair_t *im, const char *peer, uint32_t delay[2]) {
+    const impair_conf_t *c = &im->conf;
+    impair_link_t *l = linkOf(im, peer);
+    uint32_t loss = (l->loss >= 0) ? (uint32_t)l->loss : c->loss;
+    bool lost = false;
+
+    im->packets++;
+    l->packets++;
+
+    // Gilbert-Elliott, move the link's chain then lose with the state's probability
+    if (c->geP > 0) {
+        if (l->bad) {
+            l->bad = !chance(im, c->geR);
+        } else {
+            l->bad = chance(im, c->geP);
+        }
+        lost = chance(im, l->bad ? c->geLossBad : c->geLossGood);
+    }
+    if (!lost) {
+        lost = chance(im, loss);
+    }
+    if (lost) {
+        im->lost++;
+        l->lost++;
+        return 0;
+    }
+
+    int copies = 1;
+    if (chance(im, c->dup)) {
+        copies = 2;
+        im->duplicated++;
+    }
+    for (int i = 0; i < copies; i++) {
+        delay[i] = c->delay + (c->jitter ? draw(im) % (c->jitter + 1) : 0);
+        if (chance(im, c->reorder)) {
+            delay[i] += c->reorderDelay;
+            im->reordered++;
+        }
+    }
+    return copies;
+}
+
+// Purpose: configure the model from shell style arguments
+//
+// im impair_t*, the model
+// argc int, number of arguments
+// argv char**, ("impair", <what>, <values>...)
+// return 0, 1 on bad arguments
+int impair_cmd(impair_t *im, int argc, char **argv) {
+    impair_conf_t *c = &im->conf;
+
+    if (argc < 2) {
+        impair_print(im);
+        return 0;
+    }
+
+    if (strcmp(argv[1], "off") == 0) {
+        memset(c, 0, sizeof(*c));
+        im->numLinks = 0;
+    } else if (strcmp(argv[1], "loss") == 0 && argc == 3) {
+        if (!parsePct(argv[2], &c->loss)) return 1;
+    } else if (strcmp(argv[1], "ge") == 0 && argc >= 4 && argc <= 6) {
+        // p and r, then loss while bad (all by default) and while good (none)
+        c->geLossBad = IMPAIR_PPM;
+        c->geLossGood = 0;
+        if (!parsePct(argv[2], &c->geP) || !parsePct(argv[3], &c->geR)) return 1;
+        if (argc >= 5 && !parsePct(argv[4], &c->geLossBad)) return 1;
+        if (argc >= 6 && !parsePct(argv[5], &c->geLossGood)) return 1;
+    } else if (strcmp(argv[1], "delay") == 0 && (argc == 3 || argc == 4)) {
+        c->jitter = 0;
+        if (!parseUs(argv[2], &c->delay)) return 1;
+        if (argc == 4 && !parseUs(argv[3], &c->jitter)) return 1;
+    } else if (strcmp(argv[1], "dup") == 0 && argc == 3) {
+        if (!parsePct(argv[2], &c->dup)) return 1;
+    } else if (strcmp(argv[1], "reorder") == 0 && (argc == 3 || argc == 4)) {
+        c->reorderDelay = 10000;
+        if (!parsePct(argv[2], &c->reorder)) return 1;
+        if (argc == 4 && !parseUs(argv[3], &c->reorderDelay)) return 1;
+    } else if (strcmp(argv[1], "link") == 0 && argc == 4) {
+        uint32_t ppm;
+        if (strcmp(argv[3], "default") == 0) {
+            ppm = (uint32_t)IMPAIR_DEFAULT;
+        } else if (!parsePct(argv[3], &ppm)) {
+            return 1;
+        }
+        if (impair_set_link(im, argv[2], (int32_t)ppm) < 0) {
+            printf("IMPAIR: no room for another link\n");
+        }
+    } else if (strcmp(argv[1], "seed") == 0 && argc == 3) {
+        impair_seed(im, (uint32_t)strtoul(argv[2], NULL, 10));
+        im->packets = im->lost = im->duplicated = im->reordered = 0;
+    } else {
+        return 1;
+    }
+    return 0;
+}
+
+// Purpose: print the model and what it did
+//
+// im impair_t*, the model
+void impair_print(const impair_t *im) {
+    const impair_conf_t *c = &im->conf;
+
+    printf("IMPAIR: %s, loss ", impair_active(im) ? "on" : "off");
+    printPct(c->loss);
+    if (c->geP > 0) {
+        printf(", burst p ");
+        printPct(c->geP);
+        printf(" r ");
+        printPct(c->geR);
+        printf(" bad ");
+        printPct(c->geLossBad);
+        printf(" good ");
+        printPct(c->geLossGood);
+    }
+    printf(", delay %"PRIu32"+%"PRIu32" us, dup ", c->delay, c->jitter);
+    printPct(c->dup);
+    printf(", reorder ");
+    printPct(c->reorder);
+    printf(" by %"PRIu32" us\n", c->reorderDelay);
+    printf("IMPAIR: %"PRIu32" packets, %"PRIu32" lost, %"PRIu32" duplicated, %"PRIu32" reordered\n",
+           im->packets, im->lost, im->duplicated, im->reordered);
+
+    for (int i = 0; i < im->numLinks; i++) {
+        const impair_link_t *l = &im->link[i];
+        printf("IMPAIR: link %s, %"PRIu32"/%"PRIu32" lost", l->addr, l->lost, l->packets);
+        if (l->loss >= 0) {
+            printf(", loss ");
+            printPct((uint32_t)l->loss);
+        }
+        printf("%s\n", l->bad ? ", in a burst" : "");
+    }
+}
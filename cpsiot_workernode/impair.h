@@ -0,0 +1,86 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Link impairments for robustness experiments on a perfect network
+ *          (native, or the host simulator): independent and Gilbert-Elliott burst
+ *          loss, fixed delay plus jitter, duplication and reordering, per link and
+ *          from a seeded generator so a run can be repeated. The model only
+ *          decides what happens to a packet, the caller drops, holds or repeats it.
+ */
+
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Impair the receive path, 0 = no, 1 = yes
+#ifndef LE_IMPAIR
+#define LE_IMPAIR               (0)
+#endif
+#ifndef LE_IMPAIR_SEED
+#define LE_IMPAIR_SEED          (1)
+#endif
+
+// Size definitions
+#define IMPAIR_ADDR_LEN         (46)
+#ifndef IMPAIR_MAX_LINKS
+#define IMPAIR_MAX_LINKS        (16)        // links with their own state, the rest share one
+#endif
+#define IMPAIR_HOLD_SIZE        (8)         // packets the worker can hold back at once
+#define IMPAIR_PPM              (1000000)   // probabilities are parts per million
+#define IMPAIR_DEFAULT          (-1)        // a link without its own loss
+
+// what to do to packets, all off when zeroed
+typedef struct {
+    uint32_t loss;              // independent loss, ppm
+    uint32_t geP;               // Gilbert-Elliott, good to bad per packet, ppm, 0 = off
+    uint32_t geR;               // bad to good per packet, ppm
+    uint32_t geLossBad;         // loss while bad, ppm
+    uint32_t geLossGood;        // loss while good, ppm
+    uint32_t delay;             // fixed delay, usec
+    uint32_t jitter;            // uniform extra delay, usec
+    uint32_t dup;               // duplication, ppm
+    uint32_t reorder;           // held back so later packets overtake it, ppm
+    uint32_t reorderDelay;      // how long, usec
+} impair_conf_t;
+
+// one link, by the address at the other end
+typedef struct {
+    char addr[IMPAIR_ADDR_LEN];
+    int32_t loss;               // ppm, IMPAIR_DEFAULT = the configured loss
+    bool bad;                   // Gilbert-Elliott state
+    uint32_t packets;
+    uint32_t lost;
+} impair_link_t;
+
+typedef struct {
+    impair_conf_t conf;
+    uint32_t rng;               // xorshift32 state
+    impair_link_t link[IMPAIR_MAX_LINKS];
+    int numLinks;
+    impair_link_t other;        // every link past the table
+    uint32_t packets;
+    uint32_t lost;
+    uint32_t duplicated;
+    uint32_t reordered;
+} impair_t;
+
+void impair_init(impair_t *im, uint32_t seed);
+void impair_seed(impair_t *im, uint32_t seed);
+bool impair_active(const impair_t *im);
+int impair_set_link(impair_t *im, const char *addr, int32_t loss);
+int impair_packet(impair_t *im, const char *peer, uint32_t delay[2]);
+int impair_cmd(impair_t *im, int argc, char **argv);
+void impair_print(const impair_t *im);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
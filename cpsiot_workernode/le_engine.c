@@ -0,0 +1,702 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: The leader election state machine, see le_engine.h. Times are usec on
+ *          whatever clock the caller passes in, compared so they survive a wrap.
+ */
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "le_engine.h"
+
+// hand a record to the journal, if there is one, fields are designated initializers
+#define JOURNAL(e, ...) do { \
+        if ((e)->ops->journal != NULL) { \
+            le_rec_t rec_ = { __VA_ARGS__ }; \
+            (e)->ops->journal((e), &rec_); \
+        } \
+    } while (0)
+
+// Purpose: report an event if the caller wants them
+//
+// e le_engine_t*, the engine
+// event int, LE_EV_*
+// value uint32_t, depends on the event
+static void report(le_engine_t *e, int event, uint32_t value) {
+    JOURNAL(e, .type = LE_REC_EVENT, .op = event, .value = value);
+    if (e->ops->event != NULL) {
+        e->ops->event(e, event, value);
+    }
+}
+
+// Purpose: announce our local_min
+//
+// e le_engine_t*, the engine
+// to char*, a neighbor, or NULL to multicast
+static void sendAck(le_engine_t *e, const char *to) {
+    // a leader stepping down has nothing to announce until it hears someone else
+    if (e->localMin >= 256) {
+        return;
+    }
+    le_msg_t msg = { LE_MSG_ACK, e->localMin, e->leader, e->leaderHops };
+    JOURNAL(e, .type = LE_REC_SEND, .op = LE_MSG_ACK, .addr = to, .value = msg.m,
+            .leader = msg.leader, .hops = msg.hops);
+    e->ops->send(e, to, &msg);
+}
+
+// Purpose: has a wait of T run out
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+static bool waited(le_engine_t *e, uint32_t now) {
+    return now - e->lastT > e->conf.period;
+}
+
+// Purpose: keep a value as the runner-up if it beats the one we have
+//
+// e le_engine_t*, the engine
+// winner char*, this round's leader, it can't be its own runner-up
+// m uint32_t, the value
+// leader char*, who owns it
+// hops int, our hops to them
+// parent int, the neighbor that told us, -1 for ourselves
+static void offerSecond(le_engine_t *e, const char *winner, uint32_t m, const char *leader, int hops, int parent) {
+    if (m == 0 || m >= 256 || leader[0] == '\0' || strcmp(leader, winner) == 0 ||
+        (e->ignore[0] != '\0' && strcmp(leader, e->ignore) == 0)) {
+        return;
+    }
+    int cmp = strcmp(leader, e->secondLeader);
+    if (m < e->second || (m == e->second && (cmp < 0 || (cmp == 0 && hops < e->secondHops)))) {
+        e->second = m;
+        memset(e->secondLeader, 0, LE_ADDR_LEN);
+        strncpy(e->secondLeader, leader, LE_ADDR_LEN-1);
+        e->secondHops = hops;
+        e->secondParent = parent;
+    }
+}
+
+// Purpose: forget the runner-up
+//
+// e le_engine_t*, the engine
+static void clearSecond(le_engine_t *e) {
+    e->second = LE_M_NONE;
+    memset(e->secondLeader, 0, LE_ADDR_LEN);
+    e->secondHops = 0;
+    e->secondParent = -1;
+}
+
+// Purpose: begin a new trickle interval, picking t in [I/2, I)
+//
+// e le_engine_t*, the engine
+// interval uint32_t, length of the new interval, usec
+// now uint32_t, current time, usec
+static void trickleInterval(le_engine_t *e, uint32_t interval, uint32_t now) {
+    le_trickle_t *tk = &e->trickle;
+    tk->interval = interval;
+    tk->start = now;
+    uint32_t r = e->ops->random(e);
+    JOURNAL(e, .type = LE_REC_RANDOM, .value = r);
+    tk->fire = interval/2 + r % (interval/2);
+    tk->heard = 0;
+    tk->done = false;
+}
+
+// Purpose: our value changed, go back to Imin
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time, usec
+static void trickleReset(le_engine_t *e, uint32_t now) {
+    le_trickle_t *tk = &e->trickle;
+    tk->active = true;
+    tk->told = false;
+    tk->stale = false;
+    tk->quiet = false;
+    tk->owed = false;
+    if (tk->interval != e->conf.trickleImin || tk->done) {
+        trickleInterval(e, e->conf.trickleImin, now);
+    }
+}
+
+// Purpose: a neighbor is behind us, make sure it hears our value within Imin,
+//          without restarting the interval
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time, usec
+static void trickleOwe(le_engine_t *e, uint32_t now) {
+    le_trickle_t *tk = &e->trickle;
+    tk->owed = true;
+    tk->quiet = false;
+    if (tk->done) {
+        uint32_t r = e->ops->random(e);
+        JOURNAL(e, .type = LE_REC_RANDOM, .value = r);
+        uint32_t at = now - tk->start + e->conf.trickleImin/2 + r % (e->conf.trickleImin/2);
+        if (at < tk->interval) {
+            tk->fire = at;
+            tk->done = false;
+        }
+    }
+}
+
+// Purpose: run the trickle timer for our le_ack
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time, usec
+static void trickleTick(le_engine_t *e, uint32_t now) {
+    le_trickle_t *tk = &e->trickle;
+
+    if (!tk->done && now - tk->start >= tk->fire) {
+        tk->done = true;
+        // a value about to be replaced or one the neighborhood already has stays
+        // quiet, unless a neighbor is behind
+        if (!tk->stale && !tk->quiet && (tk->owed || tk->heard < e->conf.trickleK)) {
+            sendAck(e, NULL);
+            tk->sent++;
+            tk->told = true;
+            tk->owed = false;
+        } else {
+            tk->suppressed++;
+        }
+    }
+
+    if (now - tk->start >= tk->interval) {
+        // the whole interval counts, once our value is out and k neighbors repeated
+        // it we stop sending until it changes or a neighbor falls behind
+        if (tk->told && tk->heard >= e->conf.trickleK) {
+            tk->quiet = true;
+        }
+
+        // interval over and nothing new, double it up to Imax
+        uint32_t next = tk->interval * 2;
+        uint32_t imax = e->conf.trickleImin << e->conf.trickleDoublings;
+        if (next > imax) {
+            next = imax;
+        }
+        trickleInterval(e, next, now);
+    }
+}
+
+// Purpose: set up an engine, it knows no neighbors and is not electing
+//
+// e le_engine_t*, the engine
+// conf le_engine_conf_t*, protocol parameters, copied
+// ops le_engine_ops_t*, callbacks, must outlive the engine
+// ctx void*, handed back untouched in e->ctx
+void le_engine_init(le_engine_t *e, const le_engine_conf_t *conf, const le_engine_ops_t *ops, void *ctx) {
+    memset(e, 0, sizeof(*e));
+    e->conf = *conf;
+    e->ops = ops;
+    e->ctx = ctx;
+    le_engine_reset(e);
+}
+
+// Purpose: forget the last experiment, keeping the parameters and callbacks
+//
+// e le_engine_t*, the engine
+void le_engine_reset(le_engine_t *e) {
+    JOURNAL(e, .type = LE_REC_RESET);
+    e->gen = false;
+    e->m = LE_M_NONE;
+    memset(e->me, 0, LE_ADDR_LEN);
+    le_engine_clear_neighbors(e);
+
+    e->state = LE_STATE_ANNOUNCE;
+    e->counter = e->conf.rounds;
+    e->countedMs = 0;
+    e->moved = false;
+    e->polled = false;
+    e->validating = false;
+    e->lastT = 0;
+    e->localMin = LE_M_NONE;
+    memset(e->leader, 0, LE_ADDR_LEN);
+    e->leaderHops = 0;
+    e->parent = -1;
+    memset(e->ignore, 0, LE_ADDR_LEN);
+    clearSecond(e);
+    memset(&e->trickle, 0, sizeof(e->trickle));
+}
+
+// Purpose: take our m value and address, we start out as our own leader
+//
+// e le_engine_t*, the engine
+// m uint32_t, our m value
+// me char*, our address
+void le_engine_set_identity(le_engine_t *e, uint32_t m, const char *me) {
+    JOURNAL(e, .type = LE_REC_IDENTITY, .value = m, .addr = me);
+    e->m = m;
+    e->localMin = m;
+    strncpy(e->me, me, LE_ADDR_LEN-1);
+    memset(e->leader, 0, LE_ADDR_LEN);
+    strncpy(e->leader, me, LE_ADDR_LEN-1);
+}
+
+// Purpose: record a neighbor
+//
+// e le_engine_t*, the engine
+// addr char*, its address
+// return its index, -1 if it is already known or the table is full
+int le_engine_add_neighbor(le_engine_t *e, const char *addr) {
+    if (e->numNeighbors >= LE_MAX_NEIGHBORS || le_engine_find_neighbor(e, addr) >= 0) {
+        return -1;
+    }
+
+    JOURNAL(e, .type = LE_REC_ADD, .addr = addr);
+    le_neighbor_t *n = &e->nbr[e->numNeighbors];
+    memset(n, 0, sizeof(*n));
+    strncpy(n->addr, addr, LE_ADDR_LEN-1);
+    n->val = LE_M_NONE;
+    return e->numNeighbors++;
+}
+
+// Purpose: retrieve the index of a neighbor
+//
+// e le_engine_t*, the engine
+// addr char*, its address
+// return its index, -1 if it is not a neighbor
+int le_engine_find_neighbor(le_engine_t *e, const char *addr) {
+    for (int i = 0; i < e->numNeighbors; i++) {
+        if (strcmp(e->nbr[i].addr, addr) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Purpose: stop talking to a neighbor, its slot stays so indexes hold
+//
+// e le_engine_t*, the engine
+// addr char*, its address
+void le_engine_drop_neighbor(le_engine_t *e, const char *addr) {
+    int i = le_engine_find_neighbor(e, addr);
+    if (i >= 0) {
+        JOURNAL(e, .type = LE_REC_DROP, .addr = addr);
+        memset(e->nbr[i].addr, 0, LE_ADDR_LEN);
+    }
+}
+
+// Purpose: forget every neighbor
+//
+// e le_engine_t*, the engine
+void le_engine_clear_neighbors(le_engine_t *e) {
+    JOURNAL(e, .type = LE_REC_CLEAR);
+    e->numNeighbors = 0;
+    for (int i = 0; i < LE_MAX_NEIGHBORS; i++) {
+        memset(&e->nbr[i], 0, sizeof(e->nbr[i]));
+        e->nbr[i].val = LE_M_NONE;
+    }
+}
+
+// Purpose: begin the election, the first tick announces our value
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+void le_engine_start(le_engine_t *e, uint32_t now) {
+    JOURNAL(e, .type = LE_REC_START, .time = now, .value = e->gen);
+    e->counter = e->conf.rounds;
+    e->state = LE_STATE_ANNOUNCE;
+    e->lastT = now;
+}
+
+// Purpose: open with the result of the last election instead of our own value,
+//          the first round checks that every neighbor opened with it too
+//
+// e le_engine_t*, the engine
+// min uint32_t, the incumbent's m
+// leader char*, the incumbent
+// hops int, our hops to it
+void le_engine_warm(le_engine_t *e, uint32_t min, const char *leader, int hops) {
+    JOURNAL(e, .type = LE_REC_WARM, .value = min, .leader = leader, .hops = hops);
+    e->localMin = min;
+    memset(e->leader, 0, LE_ADDR_LEN);
+    strncpy(e->leader, leader, LE_ADDR_LEN-1);
+    e->leaderHops = hops;
+    e->validating = true;
+}
+
+// Purpose: elect again, ignoring anything about the failed leader, from the
+//          runner-up of the last election, the value that wins now
+//          has already spread part of the way
+//
+// e le_engine_t*, the engine
+// failed char*, the leader being replaced, us when we are told to step down
+// rounds int, K for the restart, bounded by the diameter, 0 = conf.rounds
+void le_engine_restart(le_engine_t *e, const char *failed, int rounds) {
+    JOURNAL(e, .type = LE_REC_RESTART, .addr = failed, .value = (uint32_t)rounds);
+    memset(e->ignore, 0, LE_ADDR_LEN);
+    strncpy(e->ignore, failed, LE_ADDR_LEN-1);
+    for (int i = 0; i < LE_MAX_NEIGHBORS; i++) {
+        memset(e->nbr[i].leader, 0, LE_ADDR_LEN);
+        e->nbr[i].val = LE_M_NONE;
+        e->nbr[i].hops = 0;
+    }
+
+    memset(e->leader, 0, LE_ADDR_LEN);
+    e->leaderHops = 0;
+    e->parent = -1;
+    if (e->second < 256 && strcmp(e->secondLeader, failed) != 0) {
+        e->localMin = e->second;
+        strcpy(e->leader, e->secondLeader);
+        e->leaderHops = e->secondHops;
+        e->parent = e->secondParent;
+    } else if (strcmp(failed, e->me) == 0) {
+        e->localMin = LE_M_NONE;
+    } else {
+        e->localMin = e->m;
+        strcpy(e->leader, e->me);
+    }
+    clearSecond(e);
+
+    e->counter = (rounds > 0) ? rounds : e->conf.rounds;
+    e->countedMs = 0;
+    e->moved = false;
+    e->polled = false;
+    e->state = LE_STATE_ANNOUNCE;
+}
+
+// Purpose: take a neighbor's announcement, *** message handling of lines 6, 7 and 8g
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+// from char*, the neighbor
+// m uint32_t, the m value it announced
+// leader char*, who owns that m
+// hops int, its hops to the leader
+// return LE_ACK_*
+int le_engine_on_ack(le_engine_t *e, uint32_t now, const char *from, uint32_t m, const char *leader, int hops) {
+    JOURNAL(e, .type = LE_REC_ACK, .time = now, .addr = from, .value = m, .leader = leader, .hops = hops);
+    int i = le_engine_find_neighbor(e, from);
+    if (i < 0) {
+        return LE_ACK_UNKNOWN;
+    }
+    if (m == 0 || m >= 256) {
+        return LE_ACK_RANGE;
+    }
+    if (e->ignore[0] != '\0' && strcmp(leader, e->ignore) == 0) {
+        return LE_ACK_IGNORED;
+    }
+
+    // trickle, a matching announcement counts toward suppression, a better one
+    // replaces ours at the end of the round (only for a single leader, a cluster
+    // head can be worse than a neighbor's), a neighbor that is behind us needs
+    // to hear from us soon
+    if (e->gen && e->conf.trickle && e->trickle.active) {
+        if (m == e->localMin && strcmp(leader, e->leader) == 0) {
+            e->trickle.heard++;
+        } else if (m < e->localMin || (m == e->localMin && strcmp(leader, e->leader) < 0)) {
+            e->trickle.stale = (e->conf.clusterHops == 0);
+        } else {
+            trickleOwe(e, now);
+        }
+    }
+
+    e->countedMs++;
+    if (e->nbr[i].val != m || e->nbr[i].hops != hops || strcmp(e->nbr[i].leader, leader) != 0) {
+        e->moved = true;
+    }
+    e->nbr[i].val = m;
+    e->nbr[i].hops = hops;
+    memset(e->nbr[i].leader, 0, LE_ADDR_LEN);
+    strncpy(e->nbr[i].leader, leader, LE_ADDR_LEN-1);
+    return LE_ACK_OK;
+}
+
+// Purpose: someone wants our current local_min, *** message handling of line 7
+//
+// e le_engine_t*, the engine
+// from char*, who asked
+void le_engine_on_poll(le_engine_t *e, const char *from) {
+    JOURNAL(e, .type = LE_REC_POLL, .addr = from);
+    sendAck(e, from);
+}
+
+// Purpose: the election is over, the caller's maintenance takes the state and
+//          values about a replaced leader count again
+//
+// e le_engine_t*, the engine
+void le_engine_maintain(le_engine_t *e) {
+    JOURNAL(e, .type = LE_REC_MAINTAIN);
+    memset(e->ignore, 0, LE_ADDR_LEN);
+    e->state = LE_STATE_MAINT;
+}
+
+// Purpose: will the next tick end a round
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+bool le_engine_round_due(le_engine_t *e, uint32_t now) {
+    return e->state == LE_STATE_ROUND && waited(e, now);
+}
+
+// Purpose: find the round minimum and move to it, *** lines 8a to 8g
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+// return 1 if the election converged
+static int endRound(le_engine_t *e, uint32_t now) {
+    int i;
+
+    // calculate round local_min, *** line 8a of pseudocode
+    uint32_t newMin = e->localMin;
+    char newLeader[LE_ADDR_LEN];
+    strcpy(newLeader, e->leader);
+    int newHops = e->leaderHops;
+    int newParent = e->parent;
+
+    // cluster mode starts from ourselves every round, a head is only kept while a
+    // neighbor still announces it, so nobody follows a head that follows another
+    bool cluster = (e->conf.clusterHops > 0);
+    if (cluster && !e->validating) {
+        bool steppedDown = (strcmp(e->ignore, e->me) == 0);
+        newMin = steppedDown ? LE_M_NONE : e->m;
+        strcpy(newLeader, steppedDown ? "" : e->me);
+        newHops = 0;
+        newParent = -1;
+    }
+
+    for (i = 0; i < e->numNeighbors; i++) {
+        le_neighbor_t *n = &e->nbr[i];
+
+        // don't have values from this neighbor, skip them
+        if (n->val == 0 || n->val >= 256) {
+            continue;
+        }
+
+        // cluster mode, a leader further than h hops can't be our head
+        if (cluster && n->hops + 1 > e->conf.clusterHops) {
+            continue;
+        }
+
+        // our own announcement coming back, it says nothing about anyone else
+        if (cluster && strcmp(n->leader, e->me) == 0) {
+            continue;
+        }
+
+        // same leader over a shorter path
+        if (strcmp(newLeader, n->leader) == 0) {
+            if (n->hops + 1 < newHops) {
+                newHops = n->hops + 1;
+                newParent = i;
+            }
+            continue;
+        }
+
+        // find minimum of neighborhood
+        if (n->val < newMin) {
+            strcpy(newLeader, n->leader);   // new round leader
+            newMin = n->val;                // new local_min round value
+            newHops = n->hops + 1;
+            newParent = i;
+
+        // if a tie has occured, the lower address wins
+        } else if (n->val == newMin && strcmp(newLeader, n->leader) > 0) {
+            report(e, LE_EV_TIE, newMin);
+            strcpy(newLeader, n->leader);
+            newHops = n->hops + 1;
+            newParent = i;
+        }
+    }
+
+    // the best value that isn't this round's leader, a failover of the leader starts from it
+    if (strcmp(e->secondLeader, newLeader) == 0) {
+        clearSecond(e);
+    }
+    offerSecond(e, newLeader, e->localMin, e->leader, e->leaderHops, e->parent);
+    offerSecond(e, newLeader, e->m, e->me, 0, -1);
+    for (i = 0; i < e->numNeighbors; i++) {
+        le_neighbor_t *n = &e->nbr[i];
+        if (cluster && n->hops + 1 > e->conf.clusterHops) {
+            continue;
+        }
+        offerSecond(e, newLeader, n->val, n->leader, n->hops + 1, i);
+    }
+
+    e->counter -= 1;        // reduce counter, *** line 8b of pseudocode
+    report(e, LE_EV_ROUND, (uint32_t)e->counter);
+
+    // warm start, did the whole neighborhood open with the same incumbent
+    if (e->validating) {
+        e->validating = false;
+        int agreed = (strcmp(e->leader, newLeader) == 0);
+        for (i = 0; i < e->numNeighbors; i++) {
+            if (e->nbr[i].addr[0] == '\0') {
+                continue;
+            }
+            if (e->nbr[i].val != e->localMin || strcmp(e->nbr[i].leader, e->leader) != 0) {
+                agreed = 0;
+            }
+        }
+
+        // one more quiet round and we are done, or the full protocol seeded by what we have
+        e->counter = agreed ? 0 : e->conf.rounds;
+        report(e, LE_EV_WARM, (uint32_t)agreed);
+    }
+
+    // cluster mode, keep going while the neighborhood is still settling, a change
+    // reaches every node it affects within h rounds and what those nodes take
+    // back from us needs another h to die out
+    if (cluster && e->moved && e->counter < 2 * e->conf.clusterHops) {
+        e->counter = 2 * e->conf.clusterHops;
+    }
+    e->moved = false;
+
+    // cluster mode, the path to our head matters to nodes further out
+    bool hopsImproved = cluster ? (newHops != e->leaderHops) : (newHops < e->leaderHops);
+
+    // new leader found, either by m value or tie break, *** line 8d of pseudocode
+    if (strcmp(e->leader, newLeader) != 0 || hopsImproved) {
+        bool changed = (strcmp(e->leader, newLeader) != 0);
+        e->localMin = newMin;           // *** line 8dii of pseudocode
+        strcpy(e->leader, newLeader);   // *** line 8diii of pseudocode
+        e->leaderHops = newHops;
+        e->parent = newParent;          // the neighbor that told us, a round closer to the leader
+        if (changed) {
+            report(e, LE_EV_LEADER, newMin);
+        }
+
+
+        // send local_min value to neighbors that don't have it yet
+        if (e->gen && e->conf.trickle) {
+            // inconsistent with what we announced, trickle goes back to Imin
+            trickleReset(e, now);
+        } else if (e->gen) {
+            sendAck(e, NULL);
+        } else {
+            for (i = 0; i < e->numNeighbors; i++) {
+                if (e->nbr[i].addr[0] == '\0') {
+                    continue;
+                }
+                // if this neighbor already has the leader, skip
+                if (strcmp(e->nbr[i].leader, e->leader) == 0 && !hopsImproved) {
+                    continue;
+                }
+                sendAck(e, e->nbr[i].addr);
+            }
+        }
+
+    // quit, *** lines 8e and 8ei
+    } else if (e->counter < 0) {
+        e->lastT = 0;
+        e->state = LE_STATE_DONE;
+        return 1;
+    }
+
+    // *** go to next iteration of psuedocode while loop
+    e->countedMs = 0;
+    e->lastT = now;
+    return 0;
+}
+
+// Purpose: advance the election, call it often
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+// return 1 on the tick the election converged, 0 otherwise
+int le_engine_tick(le_engine_t *e, uint32_t now) {
+    int i;
+    uint32_t at;
+
+    // a tick before anything is due changes nothing, so the journal can skip it
+    if (e->ops->journal != NULL && le_engine_next(e, now, &at) && at == now) {
+        JOURNAL(e, .type = LE_REC_TICK, .time = now);
+    }
+
+    // trickle timer for our le_ack, only while rounds are running
+    if (e->trickle.active && (e->state == LE_STATE_POLL || e->state == LE_STATE_ROUND)) {
+        trickleTick(e, now);
+    }
+
+    switch (e->state) {
+    // *** line 5 of pseudocode
+    case LE_STATE_ANNOUNCE:
+        // send initial value to all neighbors, gen mode lets trickle multicast it
+        if (e->gen && e->conf.trickle) {
+            trickleReset(e, now);
+        } else {
+            for (i = 0; i < e->numNeighbors; i++) {
+                if (e->nbr[i].addr[0] != '\0') {
+                    sendAck(e, e->nbr[i].addr);
+                }
+            }
+        }
+        e->state = LE_STATE_POLL;
+        e->lastT = now;
+        break;
+
+    // *** lines 6-7
+    case LE_STATE_POLL:
+        if (!waited(e, now)) {
+            break;
+        }
+        if (!e->polled) {
+            // line 7, poll the neighbors we have not heard from
+            if (!e->gen) {
+                le_msg_t poll = { LE_MSG_POLL, 0, NULL, 0 };
+                for (i = 0; i < e->numNeighbors; i++) {
+                    if (e->nbr[i].val == LE_M_NONE && e->nbr[i].addr[0] != '\0') {
+                        JOURNAL(e, .type = LE_REC_SEND, .op = LE_MSG_POLL, .addr = e->nbr[i].addr);
+                        e->ops->send(e, e->nbr[i].addr, &poll);
+                    }
+                }
+            }
+            e->polled = true;
+            e->lastT = now;     // wait for LE_T
+        } else {
+            // line 7a, for now don't fail, carry on without them
+            for (i = 0; i < e->numNeighbors; i++) {
+                if (e->nbr[i].addr[0] != '\0' && e->nbr[i].val == LE_M_NONE) {
+                    report(e, LE_EV_SILENT, (uint32_t)i);
+                }
+            }
+            e->state = LE_STATE_ROUND;
+            e->lastT = now;
+        }
+        break;
+
+    // *** lines 8a to 8g
+    case LE_STATE_ROUND:
+        if (waited(e, now)) {
+            return endRound(e, now);
+        }
+        break;
+
+    default:
+        break;
+    }
+    return 0;
+}
+
+// Purpose: when the engine next needs a tick, so a simulator can skip idle time
+//
+// e le_engine_t*, the engine
+// now uint32_t, current time
+// at uint32_t*, receives the time
+// return false if nothing is pending
+bool le_engine_next(le_engine_t *e, uint32_t now, uint32_t *at) {
+    uint32_t wait;
+
+    switch (e->state) {
+    case LE_STATE_ANNOUNCE:
+        *at = now;
+        return true;
+    case LE_STATE_POLL:
+    case LE_STATE_ROUND:
+        wait = e->lastT + e->conf.period + 1 - now;
+        if (wait > e->conf.period + 1) {
+            wait = 0;   // already due
+        }
+        if (e->trickle.active) {
+            le_trickle_t *tk = &e->trickle;
+            uint32_t due = tk->done ? tk->interval : tk->fire;
+            uint32_t tWait = (now - tk->start >= due) ? 0 : tk->start + due - now;
+            if (tWait < wait) {
+                wait = tWait;
+            }
+        }
+        *at = now + wait;
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,192 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: The leader election state machine (pseudocode lines 5 to 9), free of
+ *          sockets, timers and printing. The caller feeds it messages and the
+ *          time, and it answers through callbacks, so the worker and the host
+ *          simulator in cpsiot_hosttools run the same code. An optional journal
+ *          callback sees every call and answer, which is enough for lereplay to
+ *          run a recorded election again on the host.
+ */
+
+#ifndef LE_ENGINE_H
+#define LE_ENGINE_H
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Size definitions
+#define LE_ADDR_LEN             (22)        // an address suffix, as the master hands them out
+#ifndef LE_MAX_NEIGHBORS
+#define LE_MAX_NEIGHBORS        (40)
+#endif
+#define LE_M_NONE               (257)       // no m value heard
+
+// States
+#define LE_STATE_ANNOUNCE       (0)         // line 5, send our value to the neighbors
+#define LE_STATE_POLL           (1)         // lines 6-7, wait T and poll the silent neighbors
+#define LE_STATE_ROUND          (2)         // lines 8a-8g, a round every T
+#define LE_STATE_DONE           (3)         // line 9, converged
+#define LE_STATE_MAINT          (4)         // after the election, the caller's to run
+
+// Messages the engine sends
+#define LE_MSG_ACK              (0)         // le_ack;<m>;<leader>;[<hops>;]
+#define LE_MSG_POLL             (1)         // le_m?;
+
+// Events the engine reports
+#define LE_EV_ROUND             (0)         // a round's minimum is in, value = rounds left
+#define LE_EV_LEADER            (1)         // adopted a different leader, value = its m
+#define LE_EV_TIE               (2)         // lost a tie to a lower address, value = the m
+#define LE_EV_SILENT            (3)         // never heard from a neighbor, value = its index
+#define LE_EV_WARM              (4)         // warm start checked, value = 1 if the incumbent held
+
+// le_engine_on_ack results
+#define LE_ACK_OK               (0)
+#define LE_ACK_UNKNOWN          (-1)        // sender is not a neighbor
+#define LE_ACK_RANGE            (-2)        // m value out of range
+#define LE_ACK_IGNORED          (-3)        // value of the leader being replaced
+
+// Journal records, every call into the engine and everything it answers, in order
+#define LE_REC_RESET            (0)
+#define LE_REC_IDENTITY         (1)         // value = m, addr = us
+#define LE_REC_ADD              (2)         // addr = the neighbor, only when it was added
+#define LE_REC_DROP             (3)         // addr = the neighbor, only when it was known
+#define LE_REC_CLEAR            (4)
+#define LE_REC_START            (5)         // value = gen
+#define LE_REC_WARM             (6)         // value = the incumbent's m, leader, hops
+#define LE_REC_RESTART          (7)         // addr = the failed leader, value = rounds
+#define LE_REC_ACK              (8)         // addr = sender, value = m, leader, hops
+#define LE_REC_POLL             (9)         // addr = sender
+#define LE_REC_TICK             (10)        // only ticks that were due, the others do nothing
+#define LE_REC_MAINTAIN         (11)
+#define LE_REC_RANDOM           (12)        // value = the draw
+#define LE_REC_SEND             (13)        // op = LE_MSG_*, addr = receiver, value = m, leader, hops
+#define LE_REC_EVENT            (14)        // op = LE_EV_*, value
+
+// a message to send
+typedef struct {
+    int type;                   // LE_MSG_*
+    uint32_t m;
+    const char *leader;
+    int hops;                   // hops to the leader, cluster mode
+} le_msg_t;
+
+// one journal record, fields a type doesn't use are zero
+typedef struct {
+    int type;                   // LE_REC_*
+    uint32_t time;              // start, ack and tick
+    const char *addr;           // NULL = multicast
+    uint32_t value;
+    const char *leader;
+    int hops;
+    int op;
+} le_rec_t;
+
+struct le_engine;
+
+// how the engine reaches the outside world
+typedef struct {
+    void (*send)(struct le_engine *e, const char *to, const le_msg_t *msg);   // to NULL = multicast
+    void (*event)(struct le_engine *e, int event, uint32_t value);          // may be NULL
+    uint32_t (*random)(struct le_engine *e);                                // trickle only
+    void (*journal)(struct le_engine *e, const le_rec_t *rec);              // may be NULL, for replay
+} le_engine_ops_t;
+
+// protocol parameters
+typedef struct {
+    int rounds;                 // K
+    uint32_t period;            // T, usec
+    int clusterHops;            // h > 0 = elect one head within h hops
+    bool trickle;               // multicast le_ack on a trickle timer in gen mode
+    uint32_t trickleImin;       // usec
+    int trickleDoublings;       // Imax = Imin * 2^doublings
+    int trickleK;               // redundancy constant
+} le_engine_conf_t;
+
+// RFC 6206 trickle timer
+typedef struct {
+    uint32_t interval;          // current interval I, usec
+    uint32_t start;             // when the interval began
+    uint32_t fire;              // offset t into the interval to transmit at
+    int heard;                  // consistent announcements heard this interval, c
+    bool done;                  // already transmitted or suppressed this interval
+    bool active;                // is there anything to disseminate
+    bool told;                  // our current value went out
+    bool stale;                 // a neighbor announced better, ours is about to change
+    bool quiet;                 // the neighborhood has our value, stop sending
+    bool owed;                  // a neighbor is behind, don't suppress
+    int sent;                   // transmissions made
+    int suppressed;             // transmissions suppressed
+} le_trickle_t;
+
+// what we know of one neighbor, a blank addr is a dropped neighbor
+typedef struct {
+    char addr[LE_ADDR_LEN];
+    char leader[LE_ADDR_LEN];   // the leader it announced
+    uint32_t val;               // that leader's m, LE_M_NONE until heard
+    int hops;                   // its hops to that leader
+} le_neighbor_t;
+
+typedef struct le_engine {
+    const le_engine_ops_t *ops;
+    void *ctx;                  // the caller's, the engine never touches it
+    le_engine_conf_t conf;
+    bool gen;                   // neighbors found by multicast, announce by multicast
+
+    // identity
+    uint32_t m;
+    char me[LE_ADDR_LEN];
+
+    // neighbor table
+    le_neighbor_t nbr[LE_MAX_NEIGHBORS];
+    int numNeighbors;           // slots in use, including dropped ones
+
+    // election state
+    int state;
+    int counter;                // rounds left
+    int countedMs;              // m values heard this round
+    bool moved;                 // a neighbor announced something new this round
+    bool polled;
+    bool validating;            // warm start validation round
+    uint32_t lastT;             // start of the current wait
+    uint32_t localMin;
+    char leader[LE_ADDR_LEN];
+    int leaderHops;
+    int parent;                 // neighbor we adopted the leader from, -1 = nobody
+    char ignore[LE_ADDR_LEN];   // leader being replaced, its values are stale
+
+    // runner-up, the best value heard from anyone but our leader, a failover starts from it
+    uint32_t second;
+    char secondLeader[LE_ADDR_LEN];
+    int secondHops;
+    int secondParent;
+    le_trickle_t trickle;
+} le_engine_t;
+
+void le_engine_init(le_engine_t *e, const le_engine_conf_t *conf, const le_engine_ops_t *ops, void *ctx);
+void le_engine_reset(le_engine_t *e);
+void le_engine_set_identity(le_engine_t *e, uint32_t m, const char *me);
+int le_engine_add_neighbor(le_engine_t *e, const char *addr);
+int le_engine_find_neighbor(le_engine_t *e, const char *addr);
+void le_engine_drop_neighbor(le_engine_t *e, const char *addr);
+void le_engine_clear_neighbors(le_engine_t *e);
+void le_engine_start(le_engine_t *e, uint32_t now);
+void le_engine_warm(le_engine_t *e, uint32_t min, const char *leader, int hops);
+void le_engine_restart(le_engine_t *e, const char *failed, int rounds);
+int le_engine_on_ack(le_engine_t *e, uint32_t now, const char *from, uint32_t m, const char *leader, int hops);
+void le_engine_on_poll(le_engine_t *e, const char *from);
+void le_engine_maintain(le_engine_t *e);
+bool le_engine_round_due(le_engine_t *e, uint32_t now);
+int le_engine_tick(le_engine_t *e, uint32_t now);
+bool le_engine_next(le_engine_t *e, uint32_t now, uint32_t *at);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
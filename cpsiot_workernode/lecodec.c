@@ -0,0 +1,92 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: The worker's message codec, see lecodec.h.
+ */
+
+// Standard C includes
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "lecodec.h"
+
+// Purpose: find the index of a semicolon in a string for data packing
+//
+// ipv6 char*, string to check for the semicolon in
+int indexOfSemi(char *ipv6) {
+    for (uint32_t i = 0; i < strlen(ipv6); i++) {
+        if (ipv6[i]  == ';') {
+            return i+1; // start of second id
+        }
+    }
+    return -1;
+}
+
+// Purpose: write into t from s by extracting the next IP from the list
+//
+// s char*, source string
+// t char*, destination string
+void extractMsgSegment(char **s, char *t) 
+{
+    int in;
+    
+    in = indexOfSemi(*s);   
+    memset(t, 0, in); 
+    substr(*s, 0, in-1, t);
+    *s += in;
+}
+
+// Purpose: write into t from s starting at index a for length b
+//
+// s char*, source string
+// t char*, destination string
+// a int, starting index in s
+// b int, length to copy from s following index a
+void substr(char *s, int a, int b, char *t) 
+{
+    memset(t, 0, b);
+    strncpy(t, s+a, b);
+}
+
+// Purpose: use ipv6 addresses to break ties 
+//
+// ipv6_a char*, the first ipv6 address
+// ipv6_b char*, the second ipv6 address
+// return -1 if a<b, 1 if a>b, 0 if a==b
+int minIPv6(char *ipv6_a, char *ipv6_b) {
+    uint32_t minLength = strlen(ipv6_a);
+    if (strlen(ipv6_b) < minLength) minLength = strlen(ipv6_b);
+    
+    for (uint32_t i = 0; i < minLength; i++) {
+        if (ipv6_a[i] < ipv6_b[i]) {
+            return -1;
+        } else if (ipv6_b[i] < ipv6_a[i]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Purpose: build an le_ack message, le_ack;<m>;<leader>; with the hop count in cluster mode
+//
+// msg char*, destination buffer
+// min uint32_t, the local_min to announce
+// leader char*, the leader that owns local_min
+// hops int, how many hops away that leader is, -1 to leave it out
+void buildLeAck(char *msg, uint32_t min, const char *leader, int hops) {
+    char mStr[12] = { 0 };
+
+    sprintf(mStr, "%"PRIu32"", min);
+    strcpy(msg, "le_ack;");
+    strcat(msg, mStr);
+    strcat(msg, ";");
+    strcat(msg, leader);
+    strcat(msg, ";");
+
+    if (hops >= 0) {
+        sprintf(mStr, "%d;", hops);
+        strcat(msg, mStr);
+    }
+}
@@ -0,0 +1,29 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: The worker's message codec: splitting ';' separated messages, the
+ *          address tie-break and building le_ack. Plain C with no RIOT calls, so
+ *          cpsiot_hosttools/lemicro can time it on the host.
+ */
+
+#ifndef LECODEC_H
+#define LECODEC_H
+
+// Standard C includes
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int indexOfSemi(char *ipv6);
+void extractMsgSegment(char **s, char *t);
+void substr(char *s, int a, int b, char *t);
+int minIPv6(char *ipv6_a, char *ipv6_b);
+void buildLeAck(char *msg, uint32_t min, const char *leader, int hops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
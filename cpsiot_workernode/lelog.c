@@ -0,0 +1,217 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Deferred logging for the UDP server thread. lelog_write() stores the
+ *          format pointer and a copy of the arguments in a single producer,
+ *          single consumer ring, it never blocks and drops records when full.
+ *          The lelog thread formats and prints them at low priority.
+ */
+
+// Standard C includes
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Standard RIOT includes
+#include "thread.h"
+#include "xtimer.h"
+
+#include "lelog.h"
+
+#define LELOG_LINE_LEN          (160)       // longest formatted line
+
+// one log call, arguments in the order they appear in fmt
+typedef struct {
+    const char *fmt;
+    uint8_t numArgs;
+    uint8_t numStrs;
+    uint32_t args[LELOG_MAX_ARGS];
+    char strs[LELOG_MAX_STRS][LELOG_STR_LEN];
+} lelog_rec_t;
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static lelog_rec_t ring[LELOG_RING_SIZE];
+static volatile uint32_t ringHead = 0;      // written by the logging thread only
+static volatile uint32_t ringTail = 0;      // written by the lelog thread only
+static volatile uint32_t dropped = 0;
+static char lelog_stack[THREAD_STACKSIZE_MAIN];
+static bool lelog_running = false;
+
+// Purpose: step over the flags, width, precision and length of a conversion
+//
+// p char*, points just past the '%'
+// isLong bool*, set if the argument is a long
+// return pointer to the conversion character
+static const char *skipSpec(const char *p, bool *isLong) {
+    *isLong = false;
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) {
+        p++;
+    }
+    while (*p == 'l' || *p == 'h' || *p == 'z') {
+        if (*p == 'l') *isLong = true;
+        p++;
+    }
+    return p;
+}
+
+// Purpose: queue a log record, never blocks
+//
+// fmt char*, printf style format, must stay valid (a string literal)
+// ... the arguments for fmt
+void lelog_write(const char *fmt, ...) {
+    uint32_t head = ringHead;
+
+    if (head - ringTail >= LELOG_RING_SIZE) {
+        dropped++;
+        return;
+    }
+
+    lelog_rec_t *rec = &ring[head & (LELOG_RING_SIZE - 1)];
+    rec->fmt = fmt;
+    rec->numArgs = 0;
+    rec->numStrs = 0;
+
+    va_list ap;
+    va_start(ap, fmt);
+    for (const char *p = fmt; *p != '\0'; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        if (*(p+1) == '%') {
+            p++;
+            continue;
+        }
+
+        bool isLong;
+        p = skipSpec(p+1, &isLong);
+        if (*p == '\0') {
+            break;
+        } else if (*p == 's') {
+            const char *s = va_arg(ap, const char*);
+            if (rec->numStrs < LELOG_MAX_STRS) {
+                strncpy(rec->strs[rec->numStrs], (s == NULL) ? "(null)" : s, LELOG_STR_LEN-1);
+                rec->strs[rec->numStrs][LELOG_STR_LEN-1] = '\0';
+            }
+            rec->numStrs++;
+        } else {
+            uint32_t v = isLong ? (uint32_t)va_arg(ap, unsigned long) : (uint32_t)va_arg(ap, unsigned int);
+            if (rec->numArgs < LELOG_MAX_ARGS) {
+                rec->args[rec->numArgs] = v;
+            }
+            rec->numArgs++;
+        }
+    }
+    va_end(ap);
+
+    // the record has to be complete before the log thread can see it
+    __sync_synchronize();
+    ringHead = head + 1;
+}
+
+// Purpose: number of records lost to a full ring
+uint32_t lelog_dropped(void) {
+    return dropped;
+}
+
+// Purpose: format one record and print it
+//
+// rec lelog_rec_t*, the record
+static void printRecord(lelog_rec_t *rec) {
+    char line[LELOG_LINE_LEN];
+    char spec[12];
+    int len = 0;
+    int arg = 0;
+    int str = 0;
+
+    for (const char *p = rec->fmt; *p != '\0' && len < LELOG_LINE_LEN-1; p++) {
+        if (*p != '%') {
+            line[len++] = *p;
+            continue;
+        }
+        if (*(p+1) == '%') {
+            line[len++] = '%';
+            p++;
+            continue;
+        }
+
+        const char *start = p;
+        bool isLong;
+        p = skipSpec(p+1, &isLong);
+        if (*p == '\0') {
+            break;
+        }
+
+        int specLen = p - start + 1;
+        if (specLen > (int)sizeof(spec) - 1) specLen = sizeof(spec) - 1;
+        memcpy(spec, start, specLen);
+        spec[specLen] = '\0';
+
+        int room = LELOG_LINE_LEN - len;
+        if (*p == 's') {
+            len += snprintf(line+len, room, spec, (str < LELOG_MAX_STRS && str < rec->numStrs) ? rec->strs[str] : "?");
+            str++;
+        } else if (arg >= LELOG_MAX_ARGS || arg >= rec->numArgs) {
+            len += snprintf(line+len, room, "?");
+            arg++;
+        } else if (*p == 'd' || *p == 'i') {
+            if (isLong) {
+                len += snprintf(line+len, room, spec, (long)(int32_t)rec->args[arg]);
+            } else {
+                len += snprintf(line+len, room, spec, (int)(int32_t)rec->args[arg]);
+            }
+            arg++;
+        } else {
+            if (isLong) {
+                len += snprintf(line+len, room, spec, (unsigned long)rec->args[arg]);
+            } else {
+                len += snprintf(line+len, room, spec, (unsigned int)rec->args[arg]);
+            }
+            arg++;
+        }
+
+        if (len > LELOG_LINE_LEN-1) len = LELOG_LINE_LEN-1;
+    }
+    line[len] = '\0';
+    fputs(line, stdout);
+}
+
+// Purpose: log thread, drains the ring at low priority
+static void *_lelog_thread(void *args) {
+    (void)args;
+    uint32_t reported = 0;
+
+    while (1) {
+        while (ringTail != ringHead) {
+            printRecord(&ring[ringTail & (LELOG_RING_SIZE - 1)]);
+            __sync_synchronize();
+            ringTail = ringTail + 1;
+        }
+
+        if (dropped != reported) {
+            printf("LOG: %"PRIu32" records dropped, ring full\n", dropped - reported);
+            reported = dropped;
+        }
+
+        xtimer_usleep(LELOG_DRAIN_PERIOD);
+    }
+
+    return NULL;
+}
+
+// Purpose: start the log thread, below the shell and UDP server in priority
+void lelog_init(void) {
+    if (lelog_running) {
+        return;
+    }
+
+    kernel_pid_t pid = thread_create(lelog_stack, sizeof(lelog_stack), THREAD_PRIORITY_MAIN + 1,
+                                     THREAD_CREATE_STACKTEST, _lelog_thread, NULL, "lelog");
+    if (pid <= KERNEL_PID_UNDEF) {
+        printf("MAIN: Error - failed to start log thread\n");
+        return;
+    }
+    lelog_running = true;
+}
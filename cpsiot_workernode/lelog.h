@@ -0,0 +1,62 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Deferred logging for the UDP server thread. Log calls copy their
+ *          arguments into a RAM ring and return, a low priority thread does
+ *          the formatting and the slow UART output.
+ */
+
+#ifndef LELOG_H
+#define LELOG_H
+
+// Standard C includes
+#include <stdint.h>
+
+// Log levels, anything above LE_LOG_LEVEL is compiled out
+#define LELOG_LEVEL_NONE        (0)
+#define LELOG_LEVEL_ERROR       (1)
+#define LELOG_LEVEL_WARN        (2)
+#define LELOG_LEVEL_INFO        (3)
+#define LELOG_LEVEL_DEBUG       (4)
+#ifndef LE_LOG_LEVEL
+#define LE_LOG_LEVEL            LELOG_LEVEL_INFO
+#endif
+
+// Ring definitions
+#define LELOG_RING_SIZE         (32)        // records, must be a power of two
+#define LELOG_MAX_ARGS          (6)         // integer arguments kept per record
+#define LELOG_MAX_STRS          (3)         // string arguments kept per record
+#define LELOG_STR_LEN           (40)        // longest string argument kept, fits an IPv6 address
+#define LELOG_DRAIN_PERIOD      (20000)     // how often the log thread looks for records, usec
+
+// Only a single thread may log through these, the ring has one producer.
+// Formats may use %s and 32-bit integer conversions (d, i, u, x, c, PRIu32).
+#if LE_LOG_LEVEL >= LELOG_LEVEL_ERROR
+#define LELOG_ERR(...)          lelog_write(__VA_ARGS__)
+#else
+#define LELOG_ERR(...)          do { } while (0)
+#endif
+
+#if LE_LOG_LEVEL >= LELOG_LEVEL_WARN
+#define LELOG_WARN(...)         lelog_write(__VA_ARGS__)
+#else
+#define LELOG_WARN(...)         do { } while (0)
+#endif
+
+#if LE_LOG_LEVEL >= LELOG_LEVEL_INFO
+#define LELOG_INFO(...)         lelog_write(__VA_ARGS__)
+#else
+#define LELOG_INFO(...)         do { } while (0)
+#endif
+
+#if LE_LOG_LEVEL >= LELOG_LEVEL_DEBUG
+#define LELOG_DEBUG(...)        lelog_write(__VA_ARGS__)
+#else
+#define LELOG_DEBUG(...)        do { } while (0)
+#endif
+
+void lelog_init(void);
+void lelog_write(const char *fmt, ...);
+uint32_t lelog_dropped(void);
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Profiling probes for the worker. Ticks are CPU cycles from the DWT
+ *          cycle counter on Cortex-M boards (iotlab-m3) and nanoseconds from
+ *          clock_gettime on native.
+ */
+
+// Standard C includes
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Standard RIOT includes
+#include "cpu.h"
+#include "xtimer.h"
+
+#include "leprof.h"
+
+#if defined(BOARD_NATIVE)
+#include <time.h>
+#define LEPROF_UNIT             "ns"
+#elif defined(DWT)
+#define LEPROF_UNIT             "cycles"
+#else
+#define LEPROF_UNIT             "us"        // no cycle counter, fall back to xtimer
+#endif
+
+// one probe's figures
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint64_t total;
+} leprof_probe_t;
+
+#if LE_PROFILE == 1
+static const char *probeNames[LEPROF_PROBES] = {
+    "recv", "addr2str", "parse", "reduce", "send"
+};
+#endif
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static leprof_probe_t probes[LEPROF_PROBES];
+static uint32_t marks[LEPROF_PROBES];
+
+// Purpose: start the cycle counter, it is off after reset
+void leprof_init(void) {
+#if !defined(BOARD_NATIVE) && defined(DWT)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+// Purpose: the current time in ticks, wraps
+uint32_t leprof_now(void) {
+#if defined(BOARD_NATIVE)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec);
+#elif defined(DWT)
+    return DWT->CYCCNT;
+#else
+    return xtimer_now_usec();
+#endif
+}
+
+// Purpose: add one sample to a probe
+//
+// probe int, LEPROF_*
+// ticks uint32_t, time the stage took
+void leprof_add(int probe, uint32_t ticks) {
+    leprof_probe_t *p = &probes[probe];
+    p->count++;
+    p->total += ticks;
+    if (ticks > p->max) {
+        p->max = ticks;
+    }
+}
+
+// Purpose: note the start of a stage for leprof_since
+//
+// probe int, LEPROF_*
+void leprof_mark(int probe) {
+    marks[probe] = leprof_now();
+}
+
+// Purpose: add the time since the stage's mark as one sample
+//
+// probe int, LEPROF_*
+void leprof_since(int probe) {
+    leprof_add(probe, leprof_now() - marks[probe]);
+}
+
+// Purpose: clear every probe
+void leprof_reset(void) {
+    memset(probes, 0, sizeof(probes));
+}
+
+// Purpose: print every probe's count, total, mean and max
+void leprof_print(void) {
+#if LE_PROFILE == 0
+    printf("PROF: probes are compiled out, build with LE_PROFILE=1\n");
+#else
+    // newlib nano can't print 64-bit numbers, so totals are in thousands
+    printf("PROF: probe      count  total_k%s  mean  max\n", LEPROF_UNIT);
+    for (int i = 0; i < LEPROF_PROBES; i++) {
+        leprof_probe_t *p = &probes[i];
+        uint32_t mean = (p->count == 0) ? 0 : (uint32_t)(p->total / p->count);
+        printf("PROF: %-9s %6"PRIu32" %12"PRIu32" %5"PRIu32" %"PRIu32"\n",
+               probeNames[i], p->count, (uint32_t)(p->total / 1000), mean, p->max);
+    }
+#if !defined(BOARD_NATIVE) && defined(DWT)
+    printf("PROF: %"PRIu32" cycles per us\n", (uint32_t)(CLOCK_CORECLOCK / US_PER_SEC));
+#endif
+#endif
+}
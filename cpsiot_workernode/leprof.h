@@ -0,0 +1,54 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Profiling probes for the worker's hot path. A probe brackets a stage
+ *          and keeps its count, total and max time. With LE_PROFILE 0 the probes
+ *          compile to nothing.
+ */
+
+#ifndef LEPROF_H
+#define LEPROF_H
+
+// Standard C includes
+#include <stdint.h>
+
+// Profile the UDP server, 0 = no, 1 = yes
+#ifndef LE_PROFILE
+#define LE_PROFILE              (0)
+#endif
+
+// Probes
+#define LEPROF_RECV             (0)         // sock_udp_recv calls that returned a packet
+#define LEPROF_ADDR2STR         (1)         // ipv6_addr_to_str of the sender
+#define LEPROF_PARSE            (2)         // handling one received message
+#define LEPROF_REDUCE           (3)         // finding the round minimum, state 2
+#define LEPROF_SEND             (4)         // udp_send and udp_send_multi
+#define LEPROF_PROBES           (5)
+
+// a probe's start and stop must be in the same block
+#if LE_PROFILE == 1
+#define LEPROF_START(p)         uint32_t _leprof_start_##p = leprof_now()
+#define LEPROF_STOP(p)          leprof_add(p, leprof_now() - _leprof_start_##p)
+#else
+#define LEPROF_START(p)         do { } while (0)
+#define LEPROF_STOP(p)          do { } while (0)
+#endif
+
+// for a stage that begins and ends in different functions
+#if LE_PROFILE == 1
+#define LEPROF_MARK(p)          leprof_mark(p)
+#define LEPROF_SINCE(p)         leprof_since(p)
+#else
+#define LEPROF_MARK(p)          do { } while (0)
+#define LEPROF_SINCE(p)         do { } while (0)
+#endif
+
+void leprof_init(void);
+uint32_t leprof_now(void);
+void leprof_add(int probe, uint32_t ticks);
+void leprof_mark(int probe);
+void leprof_since(int probe);
+void leprof_reset(void);
+void leprof_print(void);
+
+#endif
@@ -17,6 +17,15 @@
 #include "shell_commands.h"
 #include "xtimer.h"
 
+// Runtime counters and profiling
+#include "metrics.h"
+#include "leprof.h"
+#include "trace.h"
+#include "timesync.h"
+#include "impair.h"
+#include "record.h"
+#include "lecodec.h"
+
 // Networking includes
 #include "net/gnrc/pktdump.h"
 #include "net/gnrc.h"
@@ -36,6 +45,7 @@
 extern int udp_send(int argc, char **argv);
 extern int udp_server(int argc, char **argv);
 extern kernel_pid_t leader_election(int argc, char **argv);
+extern impair_t udpImpair;
 
 // Forward declarations
 static int hello_world(int argc, char **argv);
@@ -43,9 +53,6 @@ static int run(int argc, char **argv);
 int ipc_msg_send_receive(char *message, kernel_pid_t destinationPID, msg_t *response, uint16_t type);
 int ipc_msg_send(char *message, kernel_pid_t destinationPID, bool blocking);
 int ipc_msg_reply(char *message, msg_t incoming);
-void substr(char *s, int a, int b, char *t);
-void extractMsgSegment(char **s, char *t);
-int indexOfSemi(char *ipv6);
 
 // Data structures (i.e. stacks, queues, message structs, etc)
 static msg_t _main_msg_queue[MAIN_QUEUE_SIZE];
@@ -64,54 +71,102 @@ static int hello_world(int argc, char **argv) {
     return 0;
 }
 
-// END MY CUSTOM RIOT SHELL COMMANDS
-// ************************************
+// stats shell command, prints the runtime counters
+static int dumpStats(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
 
-// shell command structure
-const shell_command_t shell_commands[] = {
-    {"hello", "prints hello world", hello_world},
-    { NULL, NULL, NULL }
-};
+    metrics_print();
 
+    return 0;
+}
 
-// Purpose: find the index of a semicolon in a string for data packing
-//
-// ipv6 char*, string to check for the semicolon in
-int indexOfSemi(char *ipv6) {
-    for (uint32_t i = 0; i < strlen(ipv6); i++) {
-        if (ipv6[i]  == ';') {
-            return i+1; // start of second id
-        }
+// prof shell command, prints or clears the profiling probes
+static int dumpProfile(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "reset") == 0) {
+        leprof_reset();
+        printf("MAIN: profiling probes cleared\n");
+        return 0;
     }
-    return -1;
+
+    leprof_print();
+
+    return 0;
 }
 
-// Purpose: write into t from s by extracting the next IP from the list
-//
-// s char*, source string
-// t char*, destination string
-void extractMsgSegment(char **s, char *t) 
-{
-    int in;
-    
-    in = indexOfSemi(*s);   
-    memset(t, 0, in); 
-    substr(*s, 0, in-1, t);
-    *s += in;
+// trace shell command, dumps or clears the event trace
+static int dumpTrace(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "clear") == 0) {
+        trace_clear();
+        printf("MAIN: trace cleared\n");
+        return 0;
+    }
+
+    trace_dump();
+
+    return 0;
 }
 
-// Purpose: write into t from s starting at index a for length b
-//
-// s char*, source string
-// t char*, destination string
-// a int, starting index in s
-// b int, length to copy from s following index a
-void substr(char *s, int a, int b, char *t) 
-{
-    memset(t, 0, b);
-    strncpy(t, s+a, b);
+// record shell command, dumps or clears the election record
+static int dumpRecord(int argc, char **argv) {
+    if (LE_RECORD == 0) {
+        printf("MAIN: built without LE_RECORD\n");
+        return 0;
+    }
+    if (argc >= 2 && strcmp(argv[1], "clear") == 0) {
+        record_clear();
+        printf("MAIN: record cleared\n");
+        return 0;
+    }
+
+    record_dump();
+
+    return 0;
+}
+
+// clock shell command, prints the time sync state
+static int dumpClock(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    tsync_print();
+
+    return 0;
 }
 
+// impair shell command, configures or prints the link impairments
+static int setImpair(int argc, char **argv) {
+    if (LE_IMPAIR == 0) {
+        printf("MAIN: built without LE_IMPAIR\n");
+        return 1;
+    }
+
+    if (impair_cmd(&udpImpair, argc, argv) != 0) {
+        printf("usage: impair [off | loss <%%> | ge <p%%> <r%%> [<bad loss%%> [<good loss%%>]] |\n"
+               "               delay <us> [<jitter us>] | dup <%%> | reorder <%%> [<us>] |\n"
+               "               link <addr> <loss%%>|default | seed <n>]\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+// END MY CUSTOM RIOT SHELL COMMANDS
+// ************************************
+
+// shell command structure
+const shell_command_t shell_commands[] = {
+    {"hello", "prints hello world", hello_world},
+    {"stats", "print message, queue and state counters", dumpStats},
+    {"prof", "print the profiling probes, or 'prof reset' to clear them", dumpProfile},
+    {"trace", "dump the event trace, or 'trace clear' to empty it", dumpTrace},
+    {"record", "dump the election record of the last two experiments, or 'record clear'", dumpRecord},
+    {"clock", "print the estimate of the master's clock", dumpClock},
+    {"impair", "set or print the loss, delay and duplication of received packets", setImpair},
+    { NULL, NULL, NULL }
+};
+
+
 // IPC HELPER FUNCTIONS
 
 // Purpose: send message to destinationPID, blocking or not
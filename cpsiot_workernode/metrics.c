@@ -0,0 +1,240 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Runtime counters and gauges for the worker. Only the UDP server thread
+ *          writes them, the shell reads them live, so a torn read costs at most
+ *          one count.
+ */
+
+// Standard C includes
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Standard RIOT includes
+#include "xtimer.h"
+#include "net/gnrc/pktbuf.h"
+
+#include "metrics.h"
+
+// older RIOT releases name the packet buffer size without the CONFIG_ prefix
+#if !defined(CONFIG_GNRC_PKTBUF_SIZE) && defined(GNRC_PKTBUF_SIZE)
+#define CONFIG_GNRC_PKTBUF_SIZE GNRC_PKTBUF_SIZE
+#endif
+
+// message prefixes, indexed by METRICS_OP_*
+static const char *opNames[METRICS_OPS] = {
+    "ping", "pong", "conf", "ips", "start", "disc", "le_ack", "le_m?",
+    "hb", "reelect", "results", "rack", "other"
+};
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static metrics_count_t cur;         // the experiment in progress
+static metrics_count_t total;       // finished experiments
+static unsigned curMsgQueueHigh = 0;
+static unsigned curSockQueueHigh = 0;
+static unsigned totalMsgQueueHigh = 0;
+static unsigned totalSockQueueHigh = 0;
+static unsigned curPktbufHigh = 0;
+static unsigned totalPktbufHigh = 0;
+static uint32_t lastPktbufSample = 0;
+static int lastState = METRICS_STATE_IDLE;
+static uint32_t lastStateChange = 0;
+static uint32_t stateRemUsec[METRICS_STATES];  // under a ms not yet charged to each state
+
+// Purpose: find the opcode of a message from its prefix
+//
+// msg char*, the message, without the epoch header
+int metrics_opcode(const char *msg) {
+    const char *semi = strchr(msg, ';');
+    size_t len = (semi == NULL) ? strlen(msg) : (size_t)(semi - msg);
+
+    // ipsd is the last part of an ips list, resb is a batch of results
+    if (len == 4 && strncmp(msg, "ipsd", 4) == 0) return METRICS_OP_IPS;
+    if (len == 4 && strncmp(msg, "resb", 4) == 0) return METRICS_OP_RESULTS;
+
+    for (int i = 0; i < METRICS_OP_OTHER; i++) {
+        if (strlen(opNames[i]) == len && strncmp(msg, opNames[i], len) == 0) {
+            return i;
+        }
+    }
+    return METRICS_OP_OTHER;
+}
+
+// Purpose: count a received message
+//
+// msg char*, the message, without the epoch header
+void metrics_msg_in(const char *msg) {
+    cur.in[metrics_opcode(msg)]++;
+}
+
+// Purpose: count a sent message
+//
+// msg char*, the message, without the epoch header
+void metrics_msg_out(const char *msg) {
+    cur.out[metrics_opcode(msg)]++;
+}
+
+// Purpose: count a failed sock_udp_send
+void metrics_send_fail(void) {
+    cur.sendFail++;
+}
+
+// Purpose: count a sock_udp_recv that didn't return data
+//
+// res int, what sock_udp_recv returned
+void metrics_recv(int res) {
+    if (res == -ETIMEDOUT || res == -EAGAIN) {
+        cur.recvTimeout++;
+    } else if (res <= 0) {
+        cur.recvErr++;
+    }
+}
+
+// Purpose: sample the queue depths, keeping the high-water marks
+//
+// msgQueue unsigned, messages waiting in the thread's msg queue
+// sockQueue unsigned, packets waiting in the socket's mailbox
+void metrics_queues(unsigned msgQueue, unsigned sockQueue) {
+    if (msgQueue > curMsgQueueHigh) curMsgQueueHigh = msgQueue;
+    if (sockQueue > curSockQueueHigh) curSockQueueHigh = sockQueue;
+}
+
+// Purpose: sample how much of the packet buffer is in use, keeping the high-water
+//          mark. RIOT has no getter for it, so this finds the largest block that
+//          can be allocated and frees it straight away. Fragmentation counts as use
+void metrics_pktbuf(void) {
+    uint32_t now = xtimer_now_usec();
+    if (lastPktbufSample != 0 && now - lastPktbufSample < METRICS_PKTBUF_PERIOD) {
+        return;
+    }
+    lastPktbufSample = now;
+
+    unsigned lo = 0;
+    unsigned hi = CONFIG_GNRC_PKTBUF_SIZE;
+    while (hi - lo > METRICS_PKTBUF_STEP) {
+        unsigned mid = (lo + hi) / 2;
+        gnrc_pktsnip_t *snip = gnrc_pktbuf_add(NULL, NULL, mid, GNRC_NETTYPE_UNDEF);
+        if (snip != NULL) {
+            gnrc_pktbuf_release(snip);
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // the snip header of the probe comes out of the buffer too
+    unsigned used = CONFIG_GNRC_PKTBUF_SIZE - lo;
+    used = (used > sizeof(gnrc_pktsnip_t)) ? used - sizeof(gnrc_pktsnip_t) : 0;
+    if (used > curPktbufHigh) curPktbufHigh = used;
+}
+
+// Purpose: count an LE round
+void metrics_round(void) {
+    cur.rounds++;
+}
+
+// Purpose: count the adoption of a different leader
+void metrics_leader_change(void) {
+    cur.leaderChanges++;
+}
+
+// Purpose: count a poll of a silent neighbor
+void metrics_poll(void) {
+    cur.polls++;
+}
+
+// Purpose: charge the time since the last call to the state we were in
+//
+// state int, LE state now, or METRICS_STATE_IDLE when not electing
+void metrics_state(int state) {
+    uint32_t now = xtimer_now_usec();
+
+    if (lastStateChange != 0) {
+        uint32_t usec = stateRemUsec[lastState] + (now - lastStateChange);
+        cur.stateMs[lastState] += usec / 1000;
+        stateRemUsec[lastState] = usec % 1000;
+    }
+    lastState = (state >= 0 && state < METRICS_STATE_IDLE) ? state : METRICS_STATE_IDLE;
+    lastStateChange = now;
+}
+
+// Purpose: fold the experiment's counts into the totals and start fresh ones
+void metrics_new_experiment(void) {
+    uint32_t *c = (uint32_t*)&cur;
+    uint32_t *t = (uint32_t*)&total;
+    for (unsigned i = 0; i < sizeof(metrics_count_t)/sizeof(uint32_t); i++) {
+        t[i] += c[i];
+    }
+    memset(&cur, 0, sizeof(cur));
+
+    if (curMsgQueueHigh > totalMsgQueueHigh) totalMsgQueueHigh = curMsgQueueHigh;
+    if (curSockQueueHigh > totalSockQueueHigh) totalSockQueueHigh = curSockQueueHigh;
+    if (curPktbufHigh > totalPktbufHigh) totalPktbufHigh = curPktbufHigh;
+    curMsgQueueHigh = 0;
+    curSockQueueHigh = 0;
+    curPktbufHigh = 0;
+}
+
+// Purpose: the experiment's figures for the results message,
+//          sendFail,recvErr,sockQueueHigh,msgQueueHigh,rounds,leaderChanges,pktbufHigh
+//
+// buf char*, receives the summary
+// len int, size of buf
+// return length of the summary
+int metrics_summary(char *buf, int len) {
+    return snprintf(buf, len, "%"PRIu32",%"PRIu32",%u,%u,%"PRIu32",%"PRIu32",%u", cur.sendFail,
+                    cur.recvErr, curSockQueueHigh, curMsgQueueHigh, cur.rounds, cur.leaderChanges,
+                    curPktbufHigh);
+}
+
+// Purpose: print one set of counters
+//
+// name char*, which set
+// m metrics_count_t*, the counters
+// extra metrics_count_t*, added to m, or NULL
+// msgHigh unsigned, msg queue high-water mark
+// sockHigh unsigned, socket mailbox high-water mark
+// pktbufHigh unsigned, packet buffer high-water mark, bytes
+static void printCounts(const char *name, metrics_count_t *m, metrics_count_t *extra,
+                        unsigned msgHigh, unsigned sockHigh, unsigned pktbufHigh) {
+    metrics_count_t sum = *m;
+    if (extra != NULL) {
+        uint32_t *s = (uint32_t*)&sum;
+        uint32_t *e = (uint32_t*)extra;
+        for (unsigned i = 0; i < sizeof(metrics_count_t)/sizeof(uint32_t); i++) {
+            s[i] += e[i];
+        }
+    }
+
+    printf("STATS: %s\n", name);
+    printf("STATS:   opcode     in    out\n");
+    for (int i = 0; i < METRICS_OPS; i++) {
+        if (sum.in[i] != 0 || sum.out[i] != 0) {
+            printf("STATS:   %-8s %6"PRIu32" %6"PRIu32"\n", opNames[i], sum.in[i], sum.out[i]);
+        }
+    }
+    printf("STATS:   send failures=%"PRIu32" recv errors=%"PRIu32" recv timeouts=%"PRIu32"\n",
+           sum.sendFail, sum.recvErr, sum.recvTimeout);
+    printf("STATS:   queue high-water msg=%u sock=%u pktbuf=%u of %u bytes\n", msgHigh, sockHigh,
+           pktbufHigh, (unsigned)CONFIG_GNRC_PKTBUF_SIZE);
+    printf("STATS:   rounds=%"PRIu32" leader changes=%"PRIu32" polls=%"PRIu32"\n",
+           sum.rounds, sum.leaderChanges, sum.polls);
+    printf("STATS:   ms in state 0=%"PRIu32" 1=%"PRIu32" 2=%"PRIu32" 3=%"PRIu32" 4=%"PRIu32" idle=%"PRIu32"\n",
+           sum.stateMs[0], sum.stateMs[1], sum.stateMs[2],
+           sum.stateMs[3], sum.stateMs[4], sum.stateMs[METRICS_STATE_IDLE]);
+}
+
+// Purpose: print the experiment in progress, everything since boot and the packet buffer
+void metrics_print(void) {
+    printCounts("current experiment", &cur, NULL, curMsgQueueHigh, curSockQueueHigh, curPktbufHigh);
+    printCounts("since boot", &total, &cur,
+                (curMsgQueueHigh > totalMsgQueueHigh) ? curMsgQueueHigh : totalMsgQueueHigh,
+                (curSockQueueHigh > totalSockQueueHigh) ? curSockQueueHigh : totalSockQueueHigh,
+                (curPktbufHigh > totalPktbufHigh) ? curPktbufHigh : totalPktbufHigh);
+#ifdef DEVELHELP
+    gnrc_pktbuf_stats();
+#endif
+}
@@ -0,0 +1,68 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Runtime counters and gauges for the worker, kept per experiment and
+ *          since boot. The UDP server thread updates them, the shell reads them.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+// Standard C includes
+#include <stdint.h>
+
+// Opcodes we count, anything else lands in METRICS_OP_OTHER
+#define METRICS_OP_PING         (0)
+#define METRICS_OP_PONG         (1)
+#define METRICS_OP_CONF         (2)
+#define METRICS_OP_IPS          (3)
+#define METRICS_OP_START        (4)
+#define METRICS_OP_DISC         (5)
+#define METRICS_OP_LE_ACK       (6)
+#define METRICS_OP_LE_POLL      (7)
+#define METRICS_OP_HB           (8)
+#define METRICS_OP_REELECT      (9)
+#define METRICS_OP_RESULTS      (10)
+#define METRICS_OP_RACK         (11)
+#define METRICS_OP_OTHER        (12)
+#define METRICS_OPS             (13)
+
+// Time is kept for LE states 0 to 4 plus the time not electing
+#define METRICS_STATE_IDLE      (5)
+#define METRICS_STATES          (6)
+
+// Packet buffer sampling, a sample takes the largest block free by bisection
+#ifndef METRICS_PKTBUF_PERIOD
+#define METRICS_PKTBUF_PERIOD   (100000)    // usec between samples
+#endif
+#define METRICS_PKTBUF_STEP     (64)        // resolution of a sample, bytes
+
+// all counters, every field a uint32_t so experiments fold into the totals
+typedef struct {
+    uint32_t in[METRICS_OPS];
+    uint32_t out[METRICS_OPS];
+    uint32_t sendFail;          // sock_udp_send errors
+    uint32_t recvErr;           // sock_udp_recv errors other than timeouts
+    uint32_t recvTimeout;       // sock_udp_recv returning with nothing
+    uint32_t rounds;            // LE rounds run
+    uint32_t leaderChanges;     // times we adopted a different leader
+    uint32_t polls;             // le_m? polls sent
+    uint32_t stateMs[METRICS_STATES];   // ms, so the totals since boot last 49 days
+} metrics_count_t;
+
+int metrics_opcode(const char *msg);
+void metrics_msg_in(const char *msg);
+void metrics_msg_out(const char *msg);
+void metrics_send_fail(void);
+void metrics_recv(int res);
+void metrics_queues(unsigned msgQueue, unsigned sockQueue);
+void metrics_pktbuf(void);
+void metrics_round(void);
+void metrics_leader_change(void);
+void metrics_poll(void);
+void metrics_state(int state);
+void metrics_new_experiment(void);
+int metrics_summary(char *buf, int len);
+void metrics_print(void);
+
+#endif
@@ -0,0 +1,251 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Record of the worker's election, see record.h. The UDP server thread
+ *          is the only writer. An experiment's record only grows, once it is
+ *          full the rest is dropped so what is there still replays from the start.
+ */
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "record.h"
+
+#define RECORD_NODE_LEN         (24)
+#define RECORD_LINE             (32)        // bytes per dump line
+
+// one experiment's record
+typedef struct {
+    uint8_t data[RECORD_SIZE];
+    uint16_t len;
+    bool full;
+    uint32_t epoch;
+    int numAddrs;
+    uint16_t addrAt[RECORD_MAX_ADDRS];      // where each address's length byte is
+} record_buf_t;
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static record_buf_t buf[2];
+static int cur = 0;                         // the other one is the last experiment
+static uint32_t epochNow = 0;
+static char node[RECORD_NODE_LEN] = "unknown";
+
+// Purpose: append bytes, or mark the record full if they don't fit
+//
+// b record_buf_t*, the record
+// p uint8_t*, the bytes
+// n int, how many
+static void put(record_buf_t *b, const uint8_t *p, int n) {
+    if (b->full || b->len + n > RECORD_SIZE) {
+        b->full = true;
+        return;
+    }
+    memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+// Purpose: pack a little endian value
+//
+// p uint8_t*, where
+// v uint32_t, the value
+// bytes int, 1, 2 or 4, a value too big for 2 bytes is kept as 0xFFFF
+// return bytes
+static int pack(uint8_t *p, uint32_t v, int bytes) {
+    if (bytes == 2 && v > 0xFFFF) {
+        v = 0xFFFF;
+    }
+    for (int i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(v >> (8*i));
+    }
+    return bytes;
+}
+
+// Purpose: the index of an address, writing it out the first time
+//
+// b record_buf_t*, the record
+// addr char*, the address, NULL for none
+static uint8_t addrIndex(record_buf_t *b, const char *addr) {
+    if (addr == NULL) {
+        return RECORD_NO_ADDR;
+    }
+
+    size_t len = strlen(addr);
+    for (int i = 0; i < b->numAddrs; i++) {
+        const uint8_t *a = b->data + b->addrAt[i];
+        if (a[0] == len && memcmp(a+1, addr, len) == 0) {
+            return (uint8_t)i;
+        }
+    }
+    if (b->numAddrs >= RECORD_MAX_ADDRS || len > LE_ADDR_LEN) {
+        b->full = true;
+        return RECORD_NO_ADDR;
+    }
+
+    uint8_t head[2] = { RECORD_ADDR, (uint8_t)len };
+    put(b, head, 2);
+    put(b, (const uint8_t *)addr, (int)len);
+    if (b->full) {
+        return RECORD_NO_ADDR;
+    }
+    b->addrAt[b->numAddrs] = b->len - len - 1;
+    return (uint8_t)b->numAddrs++;
+}
+
+// Purpose: start a new experiment's record, the current one becomes the last
+//
+// e le_engine_t*, the engine, for its parameters
+static void newExperiment(le_engine_t *e) {
+    cur ^= 1;
+    record_buf_t *b = &buf[cur];
+    b->len = 0;
+    b->full = false;
+    b->epoch = epochNow;
+    b->numAddrs = 0;
+
+    uint8_t r[16];
+    int n = 0;
+    r[n++] = RECORD_PARAMS;
+    n += pack(r+n, (uint32_t)e->conf.rounds, 1);
+    n += pack(r+n, e->conf.period, 4);
+    n += pack(r+n, (uint32_t)e->conf.clusterHops, 1);
+    n += pack(r+n, e->conf.trickle, 1);
+    n += pack(r+n, e->conf.trickleImin, 4);
+    n += pack(r+n, (uint32_t)e->conf.trickleDoublings, 1);
+    n += pack(r+n, (uint32_t)e->conf.trickleK, 1);
+    put(b, r, n);
+}
+
+// Purpose: the engine's journal callback, packs one record
+//
+// e le_engine_t*, the engine
+// rec le_rec_t*, what it did
+void record_journal(le_engine_t *e, const le_rec_t *rec) {
+    if (rec->type == LE_REC_RESET) {
+        newExperiment(e);
+        return;
+    }
+
+    record_buf_t *b = &buf[cur];
+    if (b->full) {
+        return;
+    }
+
+    // addresses first, their own records go in ahead of this one
+    uint8_t addr = addrIndex(b, rec->addr);
+    uint8_t leader = addrIndex(b, rec->leader);
+    uint32_t hops = (rec->hops < 0) ? 0 : (rec->hops > 255) ? 255 : (uint32_t)rec->hops;
+
+    uint8_t r[16];
+    int n = 0;
+    r[n++] = (uint8_t)rec->type;
+    switch (rec->type) {
+    case LE_REC_IDENTITY:
+        strncpy(node, rec->addr, RECORD_NODE_LEN-1);
+        n += pack(r+n, rec->value, 2);
+        r[n++] = addr;
+        break;
+    case LE_REC_ADD:
+    case LE_REC_DROP:
+    case LE_REC_POLL:
+        r[n++] = addr;
+        break;
+    case LE_REC_RESTART:
+        r[n++] = addr;
+        n += pack(r+n, rec->value, 1);
+        break;
+    case LE_REC_START:
+        n += pack(r+n, rec->time, 4);
+        n += pack(r+n, rec->value, 1);
+        break;
+    case LE_REC_WARM:
+        n += pack(r+n, rec->value, 2);
+        r[n++] = leader;
+        n += pack(r+n, hops, 1);
+        break;
+    case LE_REC_ACK:
+        n += pack(r+n, rec->time, 4);
+        r[n++] = addr;
+        n += pack(r+n, rec->value, 2);
+        r[n++] = leader;
+        n += pack(r+n, hops, 1);
+        break;
+    case LE_REC_TICK:
+        n += pack(r+n, rec->time, 4);
+        break;
+    case LE_REC_RANDOM:
+        n += pack(r+n, rec->value, 4);
+        break;
+    case LE_REC_SEND:
+        n += pack(r+n, (uint32_t)rec->op, 1);
+        r[n++] = addr;
+        n += pack(r+n, rec->value, 2);
+        r[n++] = leader;
+        n += pack(r+n, hops, 1);
+        break;
+    case LE_REC_EVENT:
+        n += pack(r+n, (uint32_t)rec->op, 1);
+        n += pack(r+n, rec->value, 2);
+        break;
+    default:
+        // clear and maintain carry nothing else
+        break;
+    }
+    put(b, r, n);
+}
+
+// Purpose: record one of the worker's own random draws
+//
+// tag uint8_t, RECORD_DRAW_*
+// value uint32_t, what was drawn
+void record_draw(uint8_t tag, uint32_t value) {
+    uint8_t r[6];
+    r[0] = RECORD_DRAW;
+    r[1] = tag;
+    pack(r+2, value, 4);
+    put(&buf[cur], r, 6);
+}
+
+// Purpose: the worker moved to another experiment, it labels the next record,
+//          or this one if nobody has been heard from yet
+//
+// epoch uint32_t, the experiment
+void record_epoch(uint32_t epoch) {
+    epochNow = epoch;
+    if (buf[cur].numAddrs == 0) {
+        buf[cur].epoch = epoch;
+    }
+}
+
+// Purpose: forget both experiments, recording picks up at the next one since
+//          a record without its start can't be replayed
+void record_clear(void) {
+    buf[cur ^ 1].len = 0;
+    buf[cur ^ 1].numAddrs = 0;
+    buf[cur].len = 0;
+    buf[cur].numAddrs = 0;
+    buf[cur].full = true;
+}
+
+// Purpose: print the last experiment then the current one, as hex lines
+void record_dump(void) {
+    for (int k = 1; k >= 0; k--) {
+        record_buf_t *b = &buf[cur ^ k];
+        if (b->len == 0) {
+            continue;
+        }
+
+        printf("REC: node %s epoch %"PRIu32" bytes %u full %d\n", node, b->epoch, b->len, b->full);
+        for (int i = 0; i < b->len; i += RECORD_LINE) {
+            printf("REC: d ");
+            for (int j = i; j < b->len && j < i + RECORD_LINE; j++) {
+                printf("%02x", b->data[j]);
+            }
+            printf("\n");
+        }
+        printf("REC: end\n");
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Record of the worker's election for replay on the host. The election
+ *          engine's journal (every message it was handed with its arrival time,
+ *          every tick that did something, every random draw and everything it
+ *          sent) is packed into a few bytes a record, together with the worker's
+ *          own random draws. The current and the last experiment are kept in RAM
+ *          and dumped as hex from the shell for cpsiot_hosttools/lereplay.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+// Standard C includes
+#include <stdint.h>
+
+#include "le_engine.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Record the election, 0 = no, 1 = yes
+#ifndef LE_RECORD
+#define LE_RECORD               (0)
+#endif
+
+// Size definitions
+#define RECORD_SIZE             (2048)      // bytes per experiment, recording stops when full
+#define RECORD_MAX_ADDRS        (64)        // distinct addresses per experiment
+#define RECORD_NO_ADDR          (0xFF)      // multicast, or no address
+
+// Record types, after the engine's LE_REC_*. Each record is its type byte then,
+// little endian: identity m:2 addr:1, add/drop/poll addr:1, restart addr:1
+// rounds:1, start time:4 gen:1, warm m:2 leader:1 hops:1, ack time:4 addr:1 m:2
+// leader:1 hops:1, tick
+// time:4, random value:4, send op:1 addr:1 m:2 leader:1 hops:1, event op:1
+// value:2. Addresses are indexes in the order their RECORD_ADDR came.
+#define RECORD_ADDR             (0x20)      // len:1 chars, the next address index
+#define RECORD_PARAMS           (0x21)      // rounds:1 period:4 hops:1 trickle:1 imin:4 doublings:1 k:1, opens an experiment
+#define RECORD_DRAW             (0x22)      // tag:1 value:4, a random draw of the worker's own
+
+// RECORD_DRAW tags
+#define RECORD_DRAW_PONG        (0)         // delay of the discovery pong, usec
+#define RECORD_DRAW_RESULTS     (1)         // extra backoff of a results retry, usec
+
+#if LE_RECORD == 1
+#define RECORD_JOURNAL          record_journal
+#define RECORD_DRAW_VALUE(tag, value)   record_draw(tag, value)
+#else
+#define RECORD_JOURNAL          NULL
+#define RECORD_DRAW_VALUE(tag, value)   do { } while (0)
+#endif
+
+void record_journal(le_engine_t *e, const le_rec_t *rec);
+void record_draw(uint8_t tag, uint32_t value);
+void record_epoch(uint32_t epoch);
+void record_clear(void);
+void record_dump(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Flooding time synchronization for the worker, after FTSP. Only samples
+ *          derived from a newer master stamp than we have are used, so the master's
+ *          time spreads outward hop by hop. Once the fit holds TSYNC_MIN_ENTRIES
+ *          samples we stamp our own messages and pass it on.
+ */
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+// Standard RIOT includes
+#include "xtimer.h"
+
+#include "lelog.h"
+#include "timesync.h"
+
+// one sample, offset is the reference time minus our time
+typedef struct {
+    uint32_t local;
+    uint32_t offset;
+} tsync_entry_t;
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static tsync_entry_t table[TSYNC_TABLE_SIZE];
+static int numEntries = 0;
+static int nextEntry = 0;
+
+// State variables
+static uint16_t highestSeq = 0;     // newest master stamp our samples derive from
+static int numErrors = 0;           // outliers in a row
+static bool synced = false;
+static uint32_t localAvg = 0;       // the fit passes through (localAvg, offsetAvg)
+static uint32_t offsetAvg = 0;
+static double skew = 0;             // drift of the reference against us
+static uint32_t errUs = 0;          // largest residual of the fit
+static uint32_t samples = 0;
+static uint32_t outliers = 0;
+
+// Purpose: offset of the reference clock at one of our times
+//
+// local uint32_t, our xtimer usec
+static uint32_t offsetAt(uint32_t local) {
+    return offsetAvg + (int32_t)(skew * (int32_t)(local - localAvg));
+}
+
+// Purpose: throw away every sample
+static void clearTable(void) {
+    numEntries = 0;
+    nextEntry = 0;
+    numErrors = 0;
+    synced = false;
+    skew = 0;
+    errUs = 0;
+}
+
+// Purpose: fit offset and drift to the table, relative to the newest sample so
+//          the differences stay small across xtimer wraps
+static void regress(void) {
+    tsync_entry_t *ref = &table[(nextEntry + TSYNC_TABLE_SIZE - 1) % TSYNC_TABLE_SIZE];
+    double xMean = 0, yMean = 0;
+    double sxx = 0, sxy = 0;
+    int i;
+
+    for (i = 0; i < numEntries; i++) {
+        xMean += (int32_t)(table[i].local - ref->local);
+        yMean += (int32_t)(table[i].offset - ref->offset);
+    }
+    xMean /= numEntries;
+    yMean /= numEntries;
+
+    for (i = 0; i < numEntries; i++) {
+        double x = (int32_t)(table[i].local - ref->local) - xMean;
+        double y = (int32_t)(table[i].offset - ref->offset) - yMean;
+        sxx += x * x;
+        sxy += x * y;
+    }
+
+    skew = (sxx > 0) ? sxy / sxx : 0;
+    if (skew > TSYNC_MAX_SKEW_PPM / 1e6) skew = TSYNC_MAX_SKEW_PPM / 1e6;
+    if (skew < -TSYNC_MAX_SKEW_PPM / 1e6) skew = -TSYNC_MAX_SKEW_PPM / 1e6;
+    localAvg = ref->local + (int32_t)xMean;
+    offsetAvg = ref->offset + (int32_t)yMean;
+
+    errUs = 0;
+    for (i = 0; i < numEntries; i++) {
+        int32_t miss = (int32_t)(table[i].offset - offsetAt(table[i].local));
+        uint32_t absMiss = (miss < 0) ? (uint32_t)(-miss) : (uint32_t)miss;
+        if (absMiss > errUs) {
+            errUs = absMiss;
+        }
+    }
+
+    if (!synced && numEntries >= TSYNC_MIN_ENTRIES) {
+        LELOG_INFO("SYNC: synchronized, error %"PRIu32" us\n", errUs);
+    }
+    synced = (numEntries >= TSYNC_MIN_ENTRIES);
+}
+
+// Purpose: take one sample of the reference clock
+//
+// stamp uint32_t, the sender's estimate of the reference when it sent
+// seq uint16_t, the master stamp the estimate derives from
+// rxLocal uint32_t, our time when the message arrived
+// len int, message length, for its airtime
+static void sample(uint32_t stamp, uint16_t seq, uint32_t rxLocal, int len) {
+    int16_t age = (int16_t)(seq - highestSeq);
+
+    if (numEntries > 0 && age <= 0) {
+        if (age > -TSYNC_SEQ_WINDOW) {
+            return;     // nothing newer than we have
+        }
+        LELOG_WARN("SYNC: master stamps went back from %u to %u, starting over\n", highestSeq, seq);
+        clearTable();
+    }
+    highestSeq = seq;
+    samples++;
+
+    uint32_t offset = stamp + LE_TSYNC_DELAY_US + (uint32_t)len * TSYNC_BYTE_US - rxLocal;
+    if (synced) {
+        int32_t miss = (int32_t)(offset - offsetAt(rxLocal));
+        if (miss > TSYNC_THROWOUT_US || miss < -TSYNC_THROWOUT_US) {
+            outliers++;
+            if (++numErrors < TSYNC_MAX_ERRORS) {
+                return;
+            }
+            LELOG_WARN("SYNC: %d outliers in a row, starting over\n", numErrors);
+            clearTable();
+        }
+    }
+    numErrors = 0;
+
+    table[nextEntry].local = rxLocal;
+    table[nextEntry].offset = offset;
+    nextEntry = (nextEntry + 1) % TSYNC_TABLE_SIZE;
+    if (numEntries < TSYNC_TABLE_SIZE) {
+        numEntries++;
+    }
+    regress();
+}
+
+// Purpose: read a time stamp out of an epoch header and sample it
+//
+// p char*, just past the '@' of "<epoch>@<time>.<seq>#"
+// rxLocal uint32_t, our time when the message arrived
+// len int, message length
+// return where the stamp ends, at the '#' when it is well formed
+char *tsync_parse(char *p, uint32_t rxLocal, int len) {
+    char *end;
+    uint32_t stamp = (uint32_t)strtoul(p, &end, 16);
+
+    if (end == p || *end != '.') {
+        return end;
+    }
+    p = end + 1;
+    uint16_t seq = (uint16_t)strtoul(p, &end, 16);
+    if (end == p || *end != '#') {
+        return end;
+    }
+
+    if (LE_TSYNC == 1) {
+        sample(stamp, seq, rxLocal, len);
+    }
+    return end;
+}
+
+// Purpose: write our estimate of the reference clock for an epoch header
+//
+// buf char*, room for TSYNC_HDR_LEN chars, left empty until we are synchronized
+// return chars written
+int tsync_stamp(char *buf) {
+    if (LE_TSYNC == 0 || !synced) {
+        buf[0] = '\0';
+        return 0;
+    }
+    return sprintf(buf, "@%08"PRIx32".%04x", tsync_global(xtimer_now_usec()), highestSeq);
+}
+
+// Purpose: are our estimates of the reference clock trusted
+bool tsync_synced(void) {
+    return synced;
+}
+
+// Purpose: translate one of our times to the reference clock
+//
+// local uint32_t, our xtimer usec
+uint32_t tsync_global(uint32_t local) {
+    return local + offsetAt(local);
+}
+
+// Purpose: error bound of a translated time, the largest residual of the fit
+uint32_t tsync_error(void) {
+    return errUs;
+}
+
+// Purpose: print the state of the fit
+void tsync_print(void) {
+    uint32_t now = xtimer_now_usec();
+
+    printf("SYNC: %s, %d samples, seq %u, %"PRIu32" taken, %"PRIu32" outliers\n",
+           synced ? "synchronized" : "not synchronized", numEntries, highestSeq, samples, outliers);
+    if (numEntries > 0) {
+        printf("SYNC: local %"PRIu32" reference %"PRIu32" skew %"PRId32" ppb error %"PRIu32" us\n",
+               now, tsync_global(now), (int32_t)(skew * 1e9), errUs);
+    }
+}
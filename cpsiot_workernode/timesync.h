@@ -0,0 +1,44 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Flooding time synchronization for the worker, after FTSP. The master's
+ *          xtimer is the reference clock. Messages carry the sender's estimate of
+ *          it in the epoch header, "<epoch>@<time>.<seq>#", and we fit offset and
+ *          drift to the newest samples by linear regression.
+ */
+
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+// Standard C includes
+#include <stdbool.h>
+#include <stdint.h>
+
+// Time sync, 0 = no, 1 = yes
+#ifndef LE_TSYNC
+#define LE_TSYNC                (1)
+#endif
+
+// Sample definitions
+#ifndef LE_TSYNC_DELAY_US
+#define LE_TSYNC_DELAY_US       (2000)      // stamp to receive latency besides airtime, usec
+#endif
+#define TSYNC_BYTE_US           (32)        // airtime of a byte at 250 kbit/s
+#define TSYNC_HDR_LEN           (16)        // "@<8 hex>.<4 hex>" and the terminator
+
+// Regression definitions
+#define TSYNC_TABLE_SIZE        (8)         // samples the fit is made over
+#define TSYNC_MIN_ENTRIES       (3)         // samples before we trust the fit and stamp our own messages
+#define TSYNC_THROWOUT_US       (20000)     // a sample this far off the fit is an outlier
+#define TSYNC_MAX_ERRORS        (3)         // outliers in a row before we start over
+#define TSYNC_MAX_SKEW_PPM      (200)       // drift beyond this is noise in a short baseline
+#define TSYNC_SEQ_WINDOW        (64)        // a sequence number this far back means the master restarted
+
+char *tsync_parse(char *p, uint32_t rxLocal, int len);
+int tsync_stamp(char *buf);
+bool tsync_synced(void);
+uint32_t tsync_global(uint32_t local);
+uint32_t tsync_error(void);
+void tsync_print(void);
+
+#endif
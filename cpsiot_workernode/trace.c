@@ -0,0 +1,94 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Binary event trace for the worker. The UDP server thread is the only
+ *          writer, the ring keeps the newest TRACE_RING_SIZE events and counts
+ *          the ones it overwrote.
+ */
+
+// Standard C includes
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Standard RIOT includes
+#include "xtimer.h"
+
+#include "metrics.h"
+#include "trace.h"
+
+#define TRACE_NODE_LEN          (24)
+
+// Data structures (i.e. stacks, queues, message structs, etc)
+static trace_rec_t ring[TRACE_RING_SIZE];
+static uint32_t ringHead = 0;               // events ever written
+static char node[TRACE_NODE_LEN] = "unknown";
+
+// Purpose: record one event, overwriting the oldest when full
+//
+// type uint8_t, TRACE_*
+// op uint8_t, opcode for rx/tx events
+// peer uint16_t, other node, see trace_id
+// value uint32_t, depends on type
+void trace_event(uint8_t type, uint8_t op, uint16_t peer, uint32_t value) {
+    trace_rec_t *rec = &ring[ringHead & (TRACE_RING_SIZE - 1)];
+    rec->time = xtimer_now_usec();
+    rec->type = type;
+    rec->op = op;
+    rec->peer = peer;
+    rec->value = value;
+    ringHead++;
+}
+
+// Purpose: record a message going in or out, with the m value of an le_ack
+//
+// type uint8_t, TRACE_RX or TRACE_TX
+// msg char*, the message without the epoch header
+// peer uint16_t, the other node
+void trace_msg(uint8_t type, const char *msg, uint16_t peer) {
+    int op = metrics_opcode(msg);
+    uint32_t value = 0;
+
+    if (op == METRICS_OP_LE_ACK) {
+        value = (uint32_t)strtoul(msg + 7, NULL, 10); // le_ack;m;leader;
+    }
+    trace_event(type, (uint8_t)op, peer, value);
+}
+
+// Purpose: short id of a node, the last group of its address
+//
+// ipv6 char*, a full address or the suffix the master hands out
+uint16_t trace_id(const char *ipv6) {
+    const char *last = strrchr(ipv6, ':');
+    return (uint16_t)strtoul((last == NULL) ? ipv6 : last + 1, NULL, 16);
+}
+
+// Purpose: remember our address for the dump header
+//
+// ipv6 char*, our address
+void trace_set_node(const char *ipv6) {
+    strncpy(node, ipv6, TRACE_NODE_LEN-1);
+    node[TRACE_NODE_LEN-1] = '\0';
+}
+
+// Purpose: forget every event
+void trace_clear(void) {
+    ringHead = 0;
+}
+
+// Purpose: print the ring, oldest first, one hex record per line
+void trace_dump(void) {
+    uint32_t count = (ringHead > TRACE_RING_SIZE) ? TRACE_RING_SIZE : ringHead;
+    uint32_t first = ringHead - count;
+
+    printf("TRACE: node %s id %04x events %"PRIu32" overwritten %"PRIu32"\n",
+           node, trace_id(node), count, first);
+    for (uint32_t i = first; i < ringHead; i++) {
+        trace_rec_t *rec = &ring[i & (TRACE_RING_SIZE - 1)];
+        printf("TRACE: r %08"PRIx32"%02x%02x%04x%08"PRIx32"\n",
+               rec->time, rec->type, rec->op, rec->peer, rec->value);
+    }
+    printf("TRACE: end\n");
+}
@@ -0,0 +1,57 @@
+/*
+ * @author  Michael Conard <maconard@mtu.edu>
+ *
+ * Purpose: Binary event trace for the worker. Events are 12 byte records in a
+ *          RAM ring, dumped as hex from the shell and merged across nodes by
+ *          cpsiot_hosttools/tracemerge.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+// Standard C includes
+#include <stdint.h>
+
+// Trace the UDP server, 0 = no, 1 = yes
+#ifndef LE_TRACE
+#define LE_TRACE                (1)
+#endif
+
+#define TRACE_RING_SIZE         (256)       // records, must be a power of two
+#define TRACE_PEER_MULTICAST    (0xFFFF)
+
+// Event types
+#define TRACE_EPOCH             (1)         // value = experiment we moved to
+#define TRACE_RX                (2)         // op = METRICS_OP_*, peer = sender, value = m of an le_ack
+#define TRACE_TX                (3)         // op = METRICS_OP_*, peer = receiver, value = m of an le_ack
+#define TRACE_STATE             (4)         // value = LE state we entered, 5 = idle
+#define TRACE_ROUND             (5)         // value = rounds left
+#define TRACE_LEADER            (6)         // peer = new leader, value = its m
+#define TRACE_START             (7)         // value = our m
+#define TRACE_END               (8)         // peer = leader, value = its m
+
+// one event, the layout the host tool reads
+typedef struct {
+    uint32_t time;                          // xtimer usec
+    uint8_t type;
+    uint8_t op;
+    uint16_t peer;                          // last 16 bits of the address
+    uint32_t value;
+} trace_rec_t;
+
+#if LE_TRACE == 1
+#define TRACE_EVENT(type, op, peer, value)  trace_event(type, op, peer, value)
+#define TRACE_MSG(type, msg, peer)          trace_msg(type, msg, peer)
+#else
+#define TRACE_EVENT(type, op, peer, value)  do { } while (0)
+#define TRACE_MSG(type, msg, peer)          do { } while (0)
+#endif
+
+void trace_event(uint8_t type, uint8_t op, uint16_t peer, uint32_t value);
+void trace_msg(uint8_t type, const char *msg, uint16_t peer);
+uint16_t trace_id(const char *ipv6);
+void trace_set_node(const char *ipv6);
+void trace_clear(void);
+void trace_dump(void);
+
+#endif
@@ -14,30 +14,91 @@
 // Standard RIOT includes
 #include "thread.h"
 #include "xtimer.h"
+#include "random.h"
 
 // Networking includes
 #include "net/sock/udp.h"
 #include "net/ipv6/addr.h"
+#include "net/gnrc/netif.h"
+#include "net/gnrc/netapi.h"
+#include "net/netstats.h"
+#include "mbox.h"
 
 // Inlcude leader election parameters
 #include "leaderElectionParams.h"
+#include "lelog.h"
+#include "metrics.h"
+#include "leprof.h"
+#include "energy.h"
+#include "trace.h"
+#include "timesync.h"
+#include "impair.h"
+#include "le_engine.h"
+#include "record.h"
+#include "lecodec.h"
 
 // Size definitions
 #define CHANNEL                 11
 #define SERVER_MSG_QUEUE_SIZE   (32)
-#define SERVER_BUFFER_SIZE      (128)
+#define SERVER_BUFFER_SIZE      (256)       // room for a convergecast results batch
 #define IPV6_ADDRESS_LEN        (22)
-#define MAX_NEIGHBORS           (40)
-
-#define DEBUG       (1)
+#define EPOCH_HDR_LEN           (11)        // "<epoch>#", 10 digits at most
+
+// Post-election maintenance definitions
+#ifndef LE_HEARTBEAT
+#define LE_HEARTBEAT            (0)         // 1 = stay up after election, watch the leader
+#endif
+#define LE_HB_PERIOD            (2000000)   // leader heartbeat period, usec
+#define LE_HB_MISSES            (3)         // missed heartbeats before re-election
+#define LE_HB_GRACE             (10000000)  // wait for the first heartbeat, usec, the leader may still be reporting
+
+// Warm start definitions
+#ifndef LE_WARM_START
+#define LE_WARM_START           (0)         // 1 = seed elections from the previous result
+#endif
+
+// Cluster head definitions
+#ifndef LE_CLUSTER_HOPS
+#define LE_CLUSTER_HOPS         (0)         // h > 0 = elect one head within h hops, 0 = global
+#endif
+
+// Trickle definitions (RFC 6206), used for le_ack in the multicast (gen) mode
+#ifndef LE_TRICKLE
+#define LE_TRICKLE              (0)         // 0 = multicast every leader change immediately
+#endif
+#define LE_TRICKLE_IMIN         ((uint32_t)(LE_T/4))    // smallest interval, usec
+#define LE_TRICKLE_DOUBLINGS    (8)         // Imax = Imin * 2^doublings, longer than an election
+#define LE_TRICKLE_K            (2)         // redundancy constant
+
+// Discovery definitions
+#define LE_PONG_WINDOW_MAX_MS   (10000)     // cap on the pong backoff window a ping can ask for
+
+// Convergecast definitions, results travel up the leader tree in batches
+#ifndef LE_CONVERGECAST
+#define LE_CONVERGECAST         (0)         // 1 = send results through our parent, 0 = straight to master
+#endif
+#define LE_CC_HOLD              (500000)    // time a batch waits for records from our subtree, usec
+#define LE_CC_RETRY             (1000000)   // resend an unacknowledged batch after this, usec
+#define LE_CC_PARENT_TRIES      (3)         // tries through our parent before going to the master
+#define LE_CC_MAX_TRIES         (20)        // tries before a batch is given up on
+#define LE_CC_LINGER            (5000000)   // quiet time after our record is delivered before we stop, usec
+
+// Result retry definitions, direct mode
+#define LE_RES_RETRY_BASE       (500000)    // backoff before the second send, usec
+#define LE_RES_RETRY_DOUBLINGS  (4)         // backoff stops growing at base * 2^doublings
+#define LE_RES_MAX_TRIES        (8)         // sends before we give up on the master
+
+// a head is at most h hops away, h+1 rounds then, the engine runs longer while the neighborhood settles
+#if LE_CLUSTER_HOPS > 0 && LE_CLUSTER_HOPS + 1 < LE_K
+#define LE_ROUNDS               (LE_CLUSTER_HOPS + 1)
+#else
+#define LE_ROUNDS               (LE_K)
+#endif
 
 // External functions defs
 extern int ipc_msg_send(char *message, kernel_pid_t destinationPID, bool blocking);
 extern int ipc_msg_reply(char *message, msg_t incoming);
 extern int ipc_msg_send_receive(char *message, kernel_pid_t destinationPID, msg_t *response, uint16_t type);
-extern void substr(char *s, int a, int b, char *t);
-extern int indexOfSemi(char *ipv6);
-extern void extractMsgSegment(char **s, char *t);
 
 // Forward declarations
 void *_udp_server(void *args);
@@ -46,19 +107,38 @@ int udp_send_multi(int argc, char **argv);
 int udp_server(int argc, char **argv);
 void countMsgOut(void);
 void countMsgIn(void);
-int alreadyANeighbor(char **neighbors, char *ipv6);
-int getNeighborIndex(char **neighbors, char *ipv6);
-int minIPv6(char *ipv6_a, char *ipv6_b);
+void sendToNeighbors(le_engine_t *eng, char *msg, char *except);
+void engineSend(le_engine_t *eng, const char *to, const le_msg_t *msg);
+void engineEvent(le_engine_t *eng, int event, uint32_t value);
+uint32_t engineRandom(le_engine_t *eng);
+int ccAppend(char *batch, char *batchLeader, char *leader, char *records);
+uint32_t stripEpoch(char *buffer, uint32_t rxTime);
+int impairRecv(char *buf, int len, sock_udp_ep_t *remote);
+int impairRelease(char *buf, sock_udp_ep_t *remote);
+uint32_t impairWait(uint32_t max);
 
 // Data structures (i.e. stacks, queues, message structs, etc)
 static char server_buffer[SERVER_BUFFER_SIZE];
-static char server_stack[THREAD_STACKSIZE_DEFAULT];
+static char server_stack[THREAD_STACKSIZE_LARGE];
 static msg_t server_msg_queue[SERVER_MSG_QUEUE_SIZE];
 static sock_udp_t my_sock;
 //static msg_t msg_u_in, msg_u_out;
 int messagesIn = 0;
 int messagesOut = 0;
 bool runningLE = false;
+uint32_t epoch = 0;     // experiment we are in, every message we send carries it
+uint32_t masterBoot = 0;    // boot id on the master's pings, it changes when the master restarts
+impair_t udpImpair;     // what the receive path does to packets, set from the shell
+
+// a packet the impairment model is holding back
+typedef struct {
+    bool used;
+    uint32_t release;           // when the server gets it
+    int len;
+    sock_udp_ep_t remote;
+    char buf[SERVER_BUFFER_SIZE];
+} held_t;
+static held_t held[(LE_IMPAIR == 1) ? IMPAIR_HOLD_SIZE : 1];
 
 // State variables
 static bool server_running = false;
@@ -78,45 +158,269 @@ void countMsgOut(void) {
     }
 }
 
-// Purpose: determine if an ipv6 address is already registered
+// Purpose: strip the "<epoch>[@<time>.<seq>]#" header off a received message,
+//          sampling the sender's time stamp if it has one
 //
-// neighbors char**, list of registered neighbors
-// ipv6 char*, the address to check for
-int alreadyANeighbor(char **neighbors, char *ipv6) {
-    for(int i = 0; i < MAX_NEIGHBORS; i++) {
-        if(strcmp(neighbors[i], ipv6) == 0) return 1;
+// buffer char*, the received message, the header is removed in place
+// rxTime uint32_t, when the message arrived
+// return the epoch the message was sent in, 0 if it has no header
+uint32_t stripEpoch(char *buffer, uint32_t rxTime) {
+    uint32_t e = 0;
+    char *p = buffer;
+
+    while (*p >= '0' && *p <= '9') {
+        e = e*10 + (uint32_t)(*p - '0');
+        p++;
     }
-    return 0;
+    if (p != buffer && *p == '@') {
+        p = tsync_parse(p+1, rxTime, (int)strlen(buffer));
+    }
+    if (p == buffer || *p != '#') {
+        return 0;
+    }
+
+    memmove(buffer, p+1, strlen(p+1)+1);
+    return e;
 }
 
-// Purpose: retrieve the internal index of an address
+// Purpose: read the master's boot id off a ping, "ping;<window>;<boot>;"
 //
-// neighbors char**, list of registered neighbors
-// ipv6 char*, ipv6 to check for
-int getNeighborIndex(char **neighbors, char *ipv6) {
-    for(int i = 0; i < MAX_NEIGHBORS; i++) {
-        if(strcmp(neighbors[i], ipv6) == 0) return i;
+// buffer char*, the message, after stripEpoch
+// return the boot id, 0 if it isn't a ping or carries none
+uint32_t pingBoot(const char *buffer) {
+    if (strncmp(buffer, "ping;", 5) != 0) {
+        return 0;
     }
-    return -1;
+    const char *p = strchr(buffer + 5, ';');
+    return (p == NULL) ? 0 : (uint32_t)strtoul(p+1, NULL, 10);
 }
 
-// Purpose: use ipv6 addresses to break ties 
+// Purpose: run a received packet through the impairment model, per sending link
 //
-// ipv6_a char*, the first ipv6 address
-// ipv6_b char*, the second ipv6 address
-// return -1 if a<b, 1 if a>b, 0 if a==b
-int minIPv6(char *ipv6_a, char *ipv6_b) {
-    uint32_t minLength = strlen(ipv6_a);
-    if (strlen(ipv6_b) < minLength) minLength = strlen(ipv6_b);
-    
-    for (uint32_t i = 0; i < minLength; i++) {
-        if (ipv6_a[i] < ipv6_b[i]) {
-            return -1;
-        } else if (ipv6_b[i] < ipv6_a[i]) {
-            return 1;
+// buf char*, the packet
+// len int, its length
+// remote sock_udp_ep_t*, who sent it
+// return len to handle it now, -EAGAIN if it was lost or held back
+int impairRecv(char *buf, int len, sock_udp_ep_t *remote) {
+    char addr[46];
+    uint32_t delay[2];
+    int res = -EAGAIN;
+
+    if (!impair_active(&udpImpair)) {
+        return len;
+    }
+
+    // links are named like neighbors, without the link-local prefix
+    ipv6_addr_to_str(addr, (ipv6_addr_t *)&remote->addr.ipv6, sizeof(addr));
+    int copies = impair_packet(&udpImpair, (strncmp(addr, "fe80::", 6) == 0) ? addr+6 : addr, delay);
+
+    for (int c = 0; c < copies; c++) {
+        if (delay[c] == 0 && res < 0) {
+            res = len;
+            continue;
+        }
+
+        int i;
+        for (i = 0; i < (int)(sizeof(held)/sizeof(held[0])); i++) {
+            if (!held[i].used) {
+                break;
+            }
+        }
+        if (i == (int)(sizeof(held)/sizeof(held[0]))) {
+            // nowhere to hold it, a late copy beats a lost one
+            if (res < 0) {
+                res = len;
+            }
+            continue;
         }
+        held[i].used = true;
+        held[i].release = xtimer_now_usec() + delay[c];
+        held[i].len = len;
+        held[i].remote = *remote;
+        memcpy(held[i].buf, buf, len);
+        held[i].buf[len] = '\0';
     }
-    return 0;
+    return res;
+}
+
+// Purpose: hand over the held packet that is due first, so delayed packets can overtake
+//
+// buf char*, receives the packet
+// remote sock_udp_ep_t*, receives its sender
+// return its length, 0 if nothing is due
+int impairRelease(char *buf, sock_udp_ep_t *remote) {
+    uint32_t now = xtimer_now_usec();
+    int due = -1;
+
+    for (int i = 0; i < (int)(sizeof(held)/sizeof(held[0])); i++) {
+        if (held[i].used && (int32_t)(now - held[i].release) >= 0 &&
+            (due < 0 || (int32_t)(held[i].release - held[due].release) < 0)) {
+            due = i;
+        }
+    }
+    if (due < 0) {
+        return 0;
+    }
+
+    held[due].used = false;
+    memcpy(buf, held[due].buf, held[due].len + 1);
+    *remote = held[due].remote;
+    return held[due].len;
+}
+
+// Purpose: how long the server can block on the socket without holding up a release
+//
+// max uint32_t, the longest wait, usec
+uint32_t impairWait(uint32_t max) {
+    uint32_t now = xtimer_now_usec();
+
+    for (int i = 0; i < (int)(sizeof(held)/sizeof(held[0])); i++) {
+        if (held[i].used) {
+            int32_t left = (int32_t)(held[i].release - now);
+            if (left <= 0) {
+                return 0;
+            }
+            if ((uint32_t)left < max) {
+                max = (uint32_t)left;
+            }
+        }
+    }
+    return max;
+}
+
+// Purpose: unicast a message to every live neighbor on the overlay
+//
+// eng le_engine_t*, the election engine, it keeps the neighbor table
+// msg char*, the message to send
+// except char*, a neighbor to skip (i.e. who we heard it from), or NULL
+void sendToNeighbors(le_engine_t *eng, char *msg, char *except) {
+    char ipv6[46] = { 0 };
+    char portBuf[6] = { 0 };
+    sprintf(portBuf, "%d", SERVER_PORT);
+
+    for (int i = 0; i < eng->numNeighbors; i++) {
+        // blank slots are neighbors that were dropped
+        if (strcmp(eng->nbr[i].addr, "") == 0) {
+            continue;
+        }
+        if (except != NULL && strcmp(eng->nbr[i].addr, except) == 0) {
+            continue;
+        }
+
+        memset(ipv6, 0, 46);
+        strcat(ipv6, "fe80::");
+        strcat(ipv6, eng->nbr[i].addr);
+
+        char *argsMsg[] = { "udp_send", ipv6, portBuf, msg, NULL };
+        udp_send(4, argsMsg);
+        xtimer_usleep(1000); // wait 0.001 seconds
+    }
+}
+
+// Purpose: add result records to the convergecast batch being built
+//
+// batch char*, records collected so far, "<node>,<runtime>,<msgs>,<degree>[,<hops>];" each
+// batchLeader char*, leader every record in the batch elected, set when the batch is empty
+// leader char*, leader the new records elected
+// records char*, one or more records to add
+// return 1 if the records were added, 0 if they belong in a different batch
+int ccAppend(char *batch, char *batchLeader, char *leader, char *records) {
+    // header is "resb;<seq>;<leader>;" behind the epoch and time stamp, leave room for all
+    // of it, the receiver reads the whole packet into a buffer this size
+    int room = SERVER_BUFFER_SIZE - 1 - (int)strlen("resb;00000;;") - IPV6_ADDRESS_LEN - TSYNC_HDR_LEN - EPOCH_HDR_LEN;
+
+    if (strlen(records) == 0) {
+        return 1;
+    }
+    if (strcmp(batch, "") != 0 && strcmp(batchLeader, leader) != 0) {
+        return 0;
+    }
+    if ((int)(strlen(batch) + strlen(records)) > room) {
+        return 0;
+    }
+
+    if (strcmp(batch, "") == 0) {
+        memset(batchLeader, 0, IPV6_ADDRESS_LEN);
+        strncpy(batchLeader, leader, IPV6_ADDRESS_LEN-1);
+    }
+    strcat(batch, records);
+    return 1;
+}
+
+// Purpose: put a message from the election engine on the air
+//
+// eng le_engine_t*, the engine
+// to char*, a neighbor's address, or NULL to multicast
+// msg le_msg_t*, the message
+void engineSend(le_engine_t *eng, const char *to, const le_msg_t *msg) {
+    char buf[SERVER_BUFFER_SIZE] = { 0 };
+    char ipv6[46] = { 0 };
+    char portBuf[6] = { 0 };
+    (void)eng;
+    sprintf(portBuf, "%d", SERVER_PORT);
+
+    if (msg->type == LE_MSG_POLL) {
+        strcpy(buf, "le_m?;");
+        metrics_poll();
+    } else {
+        buildLeAck(buf, msg->m, msg->leader, (LE_CLUSTER_HOPS > 0) ? msg->hops : -1);
+    }
+
+    if (to == NULL) {
+        char *argsMsg[] = { "udp_send_multi", portBuf, buf, NULL };
+        udp_send_multi(3, argsMsg);
+        return;
+    }
+
+    strcat(ipv6, "fe80::");
+    strcat(ipv6, to);
+    char *argsMsg[] = { "udp_send", ipv6, portBuf, buf, NULL };
+    udp_send(4, argsMsg);
+    xtimer_usleep(1000); // wait 0.001 seconds
+}
+
+// Purpose: count and log what the election engine reports
+//
+// eng le_engine_t*, the engine
+// event int, LE_EV_*
+// value uint32_t, depends on the event
+void engineEvent(le_engine_t *eng, int event, uint32_t value) {
+    switch (event) {
+    case LE_EV_ROUND:
+        LEPROF_SINCE(LEPROF_REDUCE);
+        metrics_round();
+        TRACE_EVENT(TRACE_ROUND, 0, 0, value);
+        LELOG_INFO("LE: counter reduced to %d\n", (int)value);
+        break;
+    case LE_EV_LEADER:
+        LELOG_INFO("LE: new leader %s, m=%"PRIu32", heard from %d nodes\n", eng->leader, value, eng->countedMs);
+        metrics_leader_change();
+        TRACE_EVENT(TRACE_LEADER, 0, trace_id(eng->leader), value);
+        break;
+    case LE_EV_TIE:
+        LELOG_INFO("LE: lost m value tie (%"PRIu32")\n", value);
+        break;
+    case LE_EV_SILENT:
+        LELOG_ERR("ERROR: we did not hear from %s, continuing anyways\n", eng->nbr[value].addr);
+        break;
+    case LE_EV_WARM:
+        if (value) {
+            LELOG_INFO("LE: incumbent validated, finishing early\n");
+        } else {
+            LELOG_INFO("LE: incumbent not validated, running all %d rounds\n", LE_ROUNDS);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Purpose: randomness for the election engine's trickle timer
+//
+// eng le_engine_t*, the engine
+uint32_t engineRandom(le_engine_t *eng) {
+    (void)eng;
+    return random_uint32();
 }
 
 /*
@@ -144,8 +448,6 @@ void *_udp_server(void *args)
     char IPv6_2[46] = { 0 };              // holder for an address
     char masterIPv6[46] = "unknown";      // address of master node
     char myIPv6[IPV6_ADDRESS_LEN] = "unknown";          // my address
-    char leaderIPv6[IPV6_ADDRESS_LEN] = "unknown";      // the "leader so far"
-    char newLeaderIPv6[IPV6_ADDRESS_LEN] = "unknown";   // leader of the round
     char ipv6_unique[IPV6_ADDRESS_LEN] = { 0 };
     char ipv6_prefix[7] = "fe80::";
     //char ipv6_suffix[12] = { 0 };
@@ -170,8 +472,9 @@ void *_udp_server(void *args)
     bool identComplete = false;
     int rconf = 0;              // did master confirm our results
     int res = 0;                // return value from socket
-    bool polled = false;        // have missing nodes been polled yet
     int sendRes = 0;            // result send attempts
+    uint32_t resNext = 0;       // when the next result send is due
+    int myIndex = -1;           // our bit in the master's results acks
     int tMsgs = 0;
 
     bool discovering = false;
@@ -180,40 +483,72 @@ void *_udp_server(void *args)
     int resetDiscoverLoops = 15;//LE_K/2 + 1;
     int discoverLoops = resetDiscoverLoops;
 
-    // leader election variables
-    uint32_t m = 257;               // my m value
-    uint32_t local_min = 257;       // current local_min found
-    uint32_t new_local_min = 257;   // local_min for the round
-    int counter = LE_K;             // K value for our algorithm
-    int stateLE = 0;                // current leader election state
-    int countedMs = 0;              // m values received this round
-    uint32_t lastT = 0;             // the last T time recorded
+    // leader election variables, the engine holds the protocol state and neighbor table
+    static const le_engine_ops_t engineOps = { engineSend, engineEvent, engineRandom, RECORD_JOURNAL };
+    le_engine_conf_t engineConf = {
+        .rounds = LE_ROUNDS,
+        .period = (uint32_t)LE_T,
+        .clusterHops = LE_CLUSTER_HOPS,
+        .trickle = (LE_TRICKLE == 1),
+        .trickleImin = LE_TRICKLE_IMIN,
+        .trickleDoublings = LE_TRICKLE_DOUBLINGS,
+        .trickleK = LE_TRICKLE_K,
+    };
+    static le_engine_t eng;
+    le_engine_init(&eng, &engineConf, &engineOps, NULL);
     uint32_t startTimeLE = 0;       // when leader election started
     uint32_t endTimeLE = 0;         // when leader election ended
+    energy_snapshot_t energyStart;  // radio counters when leader election started
+    energy_snapshot_t energyEnd;    // radio counters when it ended
+    uint32_t energyLE = 0;          // estimated radio energy of the election, uJ
     uint32_t convergenceTimeLE = 0; // protocol runtime
-    bool gen = false;
+
+    // post-election maintenance variables
+    uint32_t hbSeq = 0;             // last heartbeat sequence I sent
+    uint32_t lastHbSeq = 0;         // last heartbeat sequence I heard
+    uint32_t lastHb = 0;            // when the leader was last heard from
+    bool heardHb = false;           // has the current leader been heard from yet
+    int hbDepth = 0;                // furthest any node is from the leader, carried by the heartbeats
+    uint32_t lastHbSent = 0;        // when I last sent a heartbeat
+    int reelectEpoch = 0;           // number of re-elections seen
+    bool reelecting = false;        // is this election a failover
+    bool startReelect = false;      // join a re-election this loop
+    uint32_t detectTimeLE = 0;      // when the failure was detected
+    int reelectMsgs = 0;            // messages before the re-election
+    char failedLeaderIPv6[IPV6_ADDRESS_LEN] = { 0 };    // leader we lost
+
+    // warm start variables, these survive between experiments
+    uint32_t warmM = 257;           // my m value last election
+    uint32_t warmMin = 257;         // local_min we finished with
+    char warmLeaderIPv6[IPV6_ADDRESS_LEN] = { 0 };      // leader we finished with
+    int warmHops = 0;               // hops to that leader
+
+    // experiment epochs
+    int staleDrops = 0;             // packets dropped from an old experiment
+    char pending[SERVER_BUFFER_SIZE] = { 0 };   // packet that started the next experiment
+    sock_udp_ep_t pendingRemote;
+    int pendingLen = 0;
+    uint32_t rxTime = 0;            // when the packet being handled arrived, for time sync
+
+    // discovery backoff
+    bool pongPending = false;       // a pong is scheduled for pongAt
+    uint32_t pongAt = 0;
+
+    // convergecast of results toward the leader, through the neighbor we adopted it from
+    char *ccBuf = (char*)calloc(SERVER_BUFFER_SIZE, sizeof(char));  // records waiting to go up
+    char *ccOut = (char*)calloc(SERVER_BUFFER_SIZE, sizeof(char));  // batch waiting for its ack
+    char ccLeader[IPV6_ADDRESS_LEN] = { 0 };    // leader of the records in ccBuf
+    int ccOwn = 0;                  // our record: 0 = not added, 1 = in ccBuf, 2 = in ccOut, 3 = delivered
+    bool ccInFlight = false;        // ccOut hasn't been acknowledged yet
+    bool ccDirect = false;          // our parent stopped answering, go to the master
+    int ccSeq = 0;                  // sequence number of ccOut
+    int ccTries = 0;                // sends of ccOut
+    uint32_t ccFirst = 0;           // when the first record went into ccBuf
+    uint32_t ccLastSent = 0;        // when ccOut was last sent
+    uint32_t ccLastActivity = 0;    // last time a batch came in or got acknowledged
     //bool hasElectedLeader = false;  // has a leader been elected
     //int loopCount = 0;
 
-    // neighbor variables
-    int numNeighbors = 0;   // number of neighbors
-    //int tempNumNeighbors = 0;   // number of neighbors
-    char **neighbors = (char**)calloc(MAX_NEIGHBORS, sizeof(char*));    // list of neighbors
-    for(i = 0; i < MAX_NEIGHBORS; i++) {
-        neighbors[i] = (char*)calloc(IPV6_ADDRESS_LEN, sizeof(char));   // neighbor addresses
-    }
-    /*
-    char **tempNeighbors = (char**)calloc(MAX_NEIGHBORS, sizeof(char*));    // list of neighbors
-    for(i = 0; i < MAX_NEIGHBORS; i++) {
-        tempNeighbors[i] = (char*)calloc(IPV6_ADDRESS_LEN, sizeof(char));   // neighbor addresses
-    }
-    */
-    char **neighborsLeaders = (char**)calloc(MAX_NEIGHBORS, sizeof(char*));    // list of neighbors leaders
-    for(i = 0; i < MAX_NEIGHBORS; i++) {
-        neighborsLeaders[i] = (char*)calloc(IPV6_ADDRESS_LEN, sizeof(char));   // leader addresses
-    }
-    uint32_t neighborsVal[MAX_NEIGHBORS] = { 257 };                     // neighbor m values
-
     // socket server setup
     sock_udp_ep_t server = { .port = SERVER_PORT, .family = AF_INET6 };
     sock_udp_ep_t remote;
@@ -227,12 +562,13 @@ void *_udp_server(void *args)
     }
 
     server_running = true;
-    printf("UDP: Success - started UDP server on port %u\n", server.port);
-    printf("UPD: K = %d\n", counter);
+    LELOG_INFO("UDP: Success - started UDP server on port %u\n", server.port);
+    LELOG_INFO("UPD: K = %d\n", eng.counter);
 
+    int tracedState = -1;           // last LE state the trace saw
     int expNum = 1;
     while (true) { // loop forever, so long as master keeps starting
-        printf("UDP: starting experiment %d\n", expNum);
+        LELOG_INFO("UDP: starting experiment %d\n", expNum);
 
         // main server loop
         while (1) {
@@ -247,11 +583,35 @@ void *_udp_server(void *args)
             memset(IPv6_1, 0, 46);
             memset(IPv6_2, 0, 46);
 
+            // time per state and how far the queues back up
+            metrics_state(runningLE ? eng.state : METRICS_STATE_IDLE);
+            metrics_queues(msg_avail(), mbox_avail(&my_sock.reg.mbox));
+            metrics_pktbuf();
+            if ((runningLE ? eng.state : METRICS_STATE_IDLE) != tracedState) {
+                tracedState = runningLE ? eng.state : METRICS_STATE_IDLE;
+                TRACE_EVENT(TRACE_STATE, 0, 0, tracedState);
+            }
+
             if (server_buffer == NULL || SERVER_BUFFER_SIZE - 1 <= 0) {
-                printf("ERROR: failed sock_udp_recv preconditions\n");
+                LELOG_ERR("ERROR: failed sock_udp_recv preconditions\n");
                 return NULL;
             }
 
+            // answer the master's ping once our backoff is up
+            if (pongPending && (int32_t)(xtimer_now_usec() - pongAt) >= 0) {
+                pongPending = false;
+                if (!discovered) {
+                    // report our load so the master can pick m values from it
+                    energy_snapshot_t snap;
+                    energy_snapshot(&snap);
+                    sprintf(msg, "pong;%"PRIu32";%"PRIu32";%"PRIu32";", energy_since_boot(), snap.txPackets,
+                            (uint32_t)(xtimer_now_usec64() / US_PER_SEC));
+                    char *argsMsg[] = { "udp_send", masterIPv6, portBuf, msg, NULL };
+                    udp_send(4, argsMsg);
+                    memset(msg, 0, SERVER_BUFFER_SIZE);
+                }
+            }
+
             // discover nodes
             if (discovering && lastDiscover + wait < xtimer_now_usec()) {
                 // multicast to find nodes
@@ -278,21 +638,80 @@ void *_udp_server(void *args)
                 }
             }
 
-            if ((res = sock_udp_recv(&my_sock, server_buffer,
-                     SERVER_BUFFER_SIZE - 1, 0.005 * US_PER_SEC, //SOCK_NO_TIMEOUT,
-                     &remote)) < 0) {
+            if (pendingLen > 0) {
+                // the packet that ended the last experiment belongs to this one
+                memcpy(server_buffer, pending, pendingLen + 1);
+                remote = pendingRemote;
+                res = pendingLen;
+                pendingLen = 0;
+            } else if (LE_IMPAIR == 1 && (res = impairRelease(server_buffer, &remote)) > 0) {
+                // a packet the impairment layer held back is due
+                rxTime = xtimer_now_usec();
+            } else {
+                LEPROF_START(LEPROF_RECV);
+                res = sock_udp_recv(&my_sock, server_buffer,
+                     SERVER_BUFFER_SIZE - 1,
+                     (LE_IMPAIR == 1) ? impairWait(0.005 * US_PER_SEC) : 0.005 * US_PER_SEC, //SOCK_NO_TIMEOUT,
+                     &remote);
+                rxTime = xtimer_now_usec();
+                if (res > 0) {
+                    LEPROF_STOP(LEPROF_RECV);
+                }
+                if (LE_IMPAIR == 1 && res > 0) {
+                    res = impairRecv(server_buffer, res, &remote);
+                }
+            }
 
+            if (res < 0) {
+                metrics_recv(res);
                 if (res != 0 && res != -ETIMEDOUT && res != -EAGAIN) {
-                    printf("WARN: failed to receive UDP, %d\n", res);
+                    LELOG_WARN("WARN: failed to receive UDP, %d\n", res);
                 }
             }
             else if (res == 0) {
-                printf("WARN: no UDP data associated with message\n");
+                metrics_recv(res);
+                LELOG_WARN("WARN: no UDP data associated with message\n");
             }
             else {
                 server_buffer[res] = '\0';
-                countMsgIn();
+                LEPROF_START(LEPROF_ADDR2STR);
                 ipv6_addr_to_str(IPv6_1, (ipv6_addr_t *)&remote.addr.ipv6, 46);
+                LEPROF_STOP(LEPROF_ADDR2STR);
+
+                // drop anything from an old experiment, a newer one from the master starts the next
+                uint32_t msgEpoch = stripEpoch(server_buffer, rxTime);
+                metrics_msg_in(server_buffer);
+                TRACE_MSG(TRACE_RX, server_buffer, ((uint16_t)((ipv6_addr_t *)&remote.addr.ipv6)->u8[14] << 8) |
+                          ((ipv6_addr_t *)&remote.addr.ipv6)->u8[15]);
+                // a master that restarted counts its epochs from 1 again, so a ping with a
+                // new boot id starts an experiment whatever its epoch
+                uint32_t boot = pingBoot(server_buffer);
+                bool rebooted = (boot != 0 && masterBoot != 0 && boot != masterBoot);
+                if ((msgEpoch > epoch || rebooted) &&
+                    (strncmp(server_buffer,"ping;",5) == 0 || strcmp(IPv6_1, masterIPv6) == 0)) {
+                    if (rebooted) {
+                        LELOG_INFO("UDP: master restarted, boot id %"PRIu32"\n", boot);
+                    }
+                    LELOG_INFO("UDP: experiment epoch %"PRIu32" begins\n", msgEpoch);
+                    epoch = msgEpoch;
+                    if (boot != 0) {
+                        masterBoot = boot;
+                    }
+                    TRACE_EVENT(TRACE_EPOCH, 0, 0, epoch);
+                    record_epoch(epoch);
+
+                    if (discovered || runningLE) {
+                        // finish up this experiment and handle the packet in the next
+                        pendingLen = snprintf(pending, SERVER_BUFFER_SIZE, "%"PRIu32"#%s", msgEpoch, server_buffer);
+                        pendingRemote = remote;
+                        break;
+                    }
+                } else if (msgEpoch != epoch) {
+                    staleDrops++;
+                    res = 0;
+                } else {
+                    countMsgIn();
+                }
 
                 //int len = strlen(IPv6_1)-6;
                 memset(ipv6_unique, 0, IPV6_ADDRESS_LEN);
@@ -300,24 +719,40 @@ void *_udp_server(void *args)
                 strcpy(ipv6_unique, IPv6_1+6);
                 //ipv6_unique[len] = '\0';
 
-                printf("IP: %s\n", ipv6_unique);
+                LELOG_DEBUG("IP: %s\n", ipv6_unique);
 
-                if (DEBUG == 1) {
-                    printf("UDP: recvd size=%d, %s from %s\n", res, server_buffer, IPv6_1);
-                }
+                LELOG_DEBUG("UDP: recvd size=%d, %s from %s\n", res, server_buffer, IPv6_1);
             }
 
             // react to UDP message
+            LEPROF_START(LEPROF_PARSE);
             if (res >= 1) {
                 // the master is discovering us
                 if (strncmp(server_buffer,"ping;",5) == 0) {
-                    if (!discovered) { 
+                    if (!discovered && !pongPending) {
                         strcpy(masterIPv6, IPv6_1);
-                        strcpy(msg, "pong;");
-                        char *argsMsg[] = { "udp_send", masterIPv6, portBuf, msg, NULL };
-                        udp_send(4, argsMsg);
 
-                        printf("UDP: discovery attempt from master node (%s)\n", masterIPv6);
+                        // pick a random slot in the window the master gave us, so
+                        // every node doesn't answer the multicast at once
+                        char *mem = server_buffer + 5;
+                        uint32_t window = 0;
+                        if (strlen(mem) > 1) {
+                            char windowStr[10] = { 0 };
+                            extractMsgSegment(&mem, windowStr);
+                            window = (uint32_t)strtoul(windowStr, NULL, 10);
+                        }
+                        if (window > LE_PONG_WINDOW_MAX_MS) window = LE_PONG_WINDOW_MAX_MS;
+
+                        pongAt = xtimer_now_usec();
+                        if (window > 0) {
+                            uint32_t delay = random_uint32_range(0, window * 1000);
+                            RECORD_DRAW_VALUE(RECORD_DRAW_PONG, delay);
+                            pongAt += delay;
+                        }
+                        pongPending = true;
+
+                        LELOG_INFO("UDP: discovery attempt from master node (%s), pong in %"PRIu32" ms\n",
+                               masterIPv6, (pongAt - xtimer_now_usec()) / 1000);
                     }
 
                 // the master acknowledging our acknowledgement
@@ -333,21 +768,26 @@ void *_udp_server(void *args)
 
                         memset(mStr, 0, 5);
                         extractMsgSegment(&mem,mStr);   // extract my m value
-                        m = (uint32_t)atoi(mStr);       // convert to integer
-                        local_min = m;                  // I am the starting local_min
 
-                        memset(leaderIPv6, 0, IPV6_ADDRESS_LEN);
                         memset(myIPv6, 0, IPV6_ADDRESS_LEN);
                         extractMsgSegment(&mem, myIPv6);
-                        strcpy(leaderIPv6, myIPv6); // I am the starting leader
+                        trace_set_node(myIPv6);
+
+                        // I am the starting local_min and leader
+                        le_engine_set_identity(&eng, (uint32_t)atoi(mStr), myIPv6);
+                        if (strlen(mem) > 0) {
+                            memset(messages, 0, 10);
+                            extractMsgSegment(&mem, messages);
+                            myIndex = atoi(messages);
+                        }
                         //extractMsgSegment(&mem, ipv6_suffix);
 
-                        printf("UDP: my m/IP = %"PRIu32"/%s\n", m,myIPv6);
+                        LELOG_INFO("UDP: my m/IP = %"PRIu32"/%s\n", eng.m, myIPv6);
 
                         identComplete = true;
                     }
 
-                    printf("UDP: master node (%s) confirmed us\n", masterIPv6);
+                    LELOG_INFO("UDP: master node (%s) confirmed us\n", masterIPv6);
 
                 // information about our IP and neighbors
                 } else if (strncmp(server_buffer,"ips;",4) == 0) {
@@ -358,18 +798,17 @@ void *_udp_server(void *args)
 
                         extractMsgSegment(&mem,codeBuf);
 
-                        if (DEBUG == 1) {                    
-                            printf("UDP: ips = %s\n", mem);
-                        }
+                        LELOG_DEBUG("UDP: ips = %s\n", mem);
 
                         // extract neighbors IPs from message
                         while(strlen(mem) > 1) {
-                            extractMsgSegment(&mem,neighbors[numNeighbors]);
-                            numNeighbors++;
+                            memset(IPv6_2, 0, 46);
+                            extractMsgSegment(&mem,IPv6_2);
+                            le_engine_add_neighbor(&eng, IPv6_2);
                         }
                         
                         topoComplete = true;
-                        gen = false;
+                        eng.gen = false;
                     }
 
                 // information about our IP and neighbors for discovery
@@ -381,9 +820,7 @@ void *_udp_server(void *args)
 
                         extractMsgSegment(&mem,codeBuf);
 
-                        if (DEBUG == 1) {                    
-                            printf("UDP: ips = %s\n", mem);
-                        }
+                        LELOG_DEBUG("UDP: ips = %s\n", mem);
 
                         // extract neighbors IPs from message
                         /*
@@ -391,19 +828,19 @@ void *_udp_server(void *args)
                             extractMsgSegment(&mem,tempNeighbors[tempNumNeighbors]);
                             tempNumNeighbors++;
                         }
-                        printf("LE: Received network info, %d possible neighbors:\n",tempNumNeighbors);
+                        LELOG_INFO("LE: Received network info, %d possible neighbors:\n",tempNumNeighbors);
                         for (i = 0; i < tempNumNeighbors; i++) {
                             if (strcmp(tempNeighbors[i],"") == 0) {
                                 continue;
                             }
-                            printf("%2d: %s\n", i+1, tempNeighbors[i]);
+                            LELOG_INFO("%2d: %s\n", i+1, tempNeighbors[i]);
                         }
                         */
                         
                         topoComplete = true;
                         discovering = true;
                         lastDiscover = 0;
-                        gen = true;
+                        eng.gen = true;
                     }
                 
                 // start discovery
@@ -411,15 +848,8 @@ void *_udp_server(void *args)
                     discovering = true;
                     lastDiscover = 0;
 
-                    numNeighbors = 0;
-                    //tempNumNeighbors = 0;
-                    for(i = 0; i < MAX_NEIGHBORS; i++) {
-                        memset(neighbors[i], 0, IPV6_ADDRESS_LEN);
-                        //memset(tempNeighbors[i], 0, IPV6_ADDRESS_LEN);
-                        memset(neighborsLeaders[i], 0, IPV6_ADDRESS_LEN);
-                        neighborsVal[i] = 257;
-                    } 
-                    gen = true;
+                    le_engine_clear_neighbors(&eng);
+                    eng.gen = true;
                 // start leader election
                 } else if (strncmp(server_buffer,"start;",6) == 0) {
                     if (runningLE) {
@@ -428,48 +858,48 @@ void *_udp_server(void *args)
                     }
                     else {
                         // start leader election
-                        printf("UDP: My IPv6 is: %s, m=%"PRIu32"\n", myIPv6, m);
-                        printf("LE: Topology assignment complete, %d neighbors:\n",numNeighbors);
+                        LELOG_INFO("UDP: My IPv6 is: %s, m=%"PRIu32"\n", myIPv6, eng.m);
+                        LELOG_INFO("LE: Topology assignment complete, %d neighbors:\n", eng.numNeighbors);
 
                         // print neighbors for convenience
-                        for (i = 0; i < numNeighbors; i++) {
-                            if (strcmp(neighbors[i],"") == 0) {
+                        for (i = 0; i < eng.numNeighbors; i++) {
+                            if (strcmp(eng.nbr[i].addr,"") == 0) {
                                 continue;
                             }
-                            printf("%2d: %s\n", i+1, neighbors[i]);
+                            LELOG_INFO("%2d: %s\n", i+1, eng.nbr[i].addr);
                         }
 
-                        if (numNeighbors <= 0) {
-                            printf("ERROR: trying to start leader election with no neighbors\n");
+                        if (eng.numNeighbors <= 0) {
+                            LELOG_ERR("ERROR: trying to start leader election with no neighbors\n");
                             xtimer_usleep(5000000); // wait 5 seconds and continue
                             break;
                         }
 
                         // set some initial values
-                        printf("LE: Initiating leader election...\n");
+                        LELOG_INFO("LE: Initiating leader election...\n");
                         runningLE = true;
                         startTimeLE = xtimer_now_usec();
-                        counter = LE_K;
-                        stateLE = 0;
+                        energy_snapshot(&energyStart);
+                        TRACE_EVENT(TRACE_START, 0, trace_id(myIPv6), eng.m);
+                        le_engine_start(&eng, startTimeLE);
+
+                        // the master only asks for a warm start when the node set and m values held,
+                        // we still check our own m and validate the incumbent with our neighbors
+                        if (LE_WARM_START == 1 && strncmp(server_buffer+6,"warm;",5) == 0 &&
+                                warmM == eng.m && strcmp(warmLeaderIPv6, "") != 0) {
+                            le_engine_warm(&eng, warmMin, warmLeaderIPv6, warmHops);
+                            LELOG_INFO("LE: warm start, incumbent %s via m=%"PRIu32"\n", eng.leader, eng.localMin);
+                        }
                     }
 
                 } else if (strncmp(server_buffer,"disc;",5) == 0) {
                     //printf("UDP: discovering %s\n", ipv6_unique);
                     // if node with this ipv6 is already found, ignore
                     // otherwise record them
-                    int found = alreadyANeighbor(neighbors, ipv6_unique);
+                    int found = le_engine_add_neighbor(&eng, ipv6_unique);
                     //printf("For IP=%s, found=%d\n", ipv6, found);
-                    if (found == 0 && numNeighbors < MAX_NEIGHBORS) {
-                        strcpy(neighbors[numNeighbors], ipv6_unique);
-                        if (DEBUG == 1) {
-                            printf("UDP: recorded new node, %s\n", neighbors[numNeighbors]);
-                        }
-
-                        //memset(IPv6_2, 0, 46);
-                        //strcat(IPv6_2, ipv6_prefix);
-                        //strcat(IPv6_2, neighbors[numNeighbors]);
-                        
-                        numNeighbors++;
+                    if (found >= 0) {
+                        LELOG_DEBUG("UDP: recorded new node, %s\n", eng.nbr[found].addr);
 
                         //strcpy(msg, "disc;");
                         //char *argsMsg[] = { "udp_send", IPv6_2, portBuf, msg, NULL };
@@ -488,357 +918,482 @@ void *_udp_server(void *args)
 
                         extractMsgSegment(&mem,codeBuf);    // remove header
 
-                        if (DEBUG == 1) {
-                            printf("LE: m_msg = %s\n", server_buffer);
-                        }
+                        LELOG_DEBUG("LE: m_msg = %s\n", server_buffer);
 
                         extractMsgSegment(&mem,mStr);       // get m value
                         extractMsgSegment(&mem,IPv6_2);     // obtain owner ID
-                        i = getNeighborIndex(neighbors, ipv6_unique);  // check the sender/neighbor
-
-                        if (i < 0) {
-                            printf("ERROR: sender of message not found in neighbor list (%s)\n", IPv6_1);
-                            //continue;
+                        int hops = 0;
+                        if (strlen(mem) > 1) {
+                            extractMsgSegment(&mem,codeBuf);    // hops to the owner
+                            hops = atoi(codeBuf);
                         }
-                        else {
-                            localM = (uint32_t)atoi(mStr);
-                            if (localM <= 0 || localM >= 256) {
-                                printf("ERROR: le_ack, m value is out of range, %"PRIu32"\n", localM);
-                                //continue;
-                            }
-                            else {
-                                countedMs++;
-                                neighborsVal[i] = localM;
-                                memset(neighborsLeaders[i], 0, IPV6_ADDRESS_LEN);
-                                strcpy(neighborsLeaders[i], IPv6_2);
-
-                                printf("LE: m value %"PRIu32"//%s received from %s\n", neighborsVal[i], neighborsLeaders[i], IPv6_1);
-                            }
+                        localM = (uint32_t)atoi(mStr);
+
+                        int ack = le_engine_on_ack(&eng, xtimer_now_usec(), ipv6_unique, localM, IPv6_2, hops);
+                        if (ack == LE_ACK_UNKNOWN) {
+                            LELOG_ERR("ERROR: sender of message not found in neighbor list (%s)\n", IPv6_1);
+                        } else if (ack == LE_ACK_RANGE) {
+                            LELOG_ERR("ERROR: le_ack, m value is out of range, %"PRIu32"\n", localM);
+                        } else if (ack == LE_ACK_IGNORED) {
+                            // stale value from a node that has not joined the re-election
+                            LELOG_INFO("LE: ignoring failed leader %s from %s\n", IPv6_2, IPv6_1);
+                        } else {
+                            LELOG_INFO("LE: m value %"PRIu32"//%s received from %s\n", localM, IPv6_2, IPv6_1);
                         }
                     }
 
                 // someone wants my current local_min
                 } else if (strncmp(server_buffer,"le_m?;",6) == 0) {
-                    // *** message handling component of line 7
-                    memset(mStr, 0, 5);
-                    sprintf(mStr, "%"PRIu32"", local_min);
-                    strcpy(msg, "le_ack;");     // le_ack command
-                    strcat(msg, mStr);          // add on local_min value
-                    strcat(msg, ";");
-                    strcat(msg, leaderIPv6);    // add on leader address
-                    strcat(msg, ";");
-
-                    // answer the m value request
-                    char *argsMsg[] = { "udp_send", IPv6_1, portBuf, msg, NULL };
-                    udp_send(4, argsMsg);
+                    // *** message handling component of line 7, answer the m value request
+                    le_engine_on_poll(&eng, ipv6_unique);
         
-                // a node had a failure
-                } else if (strncmp(server_buffer,"failure;",8) == 0) {
-                    printf("ERROR: a node failed and master told us to terminate\n");
-                    break; // terminate with error
+                // the leader is still alive, pass it on
+                } else if (strncmp(server_buffer,"hb;",3) == 0) {
+                    // followers may still be reporting results when the leader starts
+                    if (eng.state == LE_STATE_DONE || eng.state == LE_STATE_MAINT) {
+                        strcpy(msgP, server_buffer);
+                        char *mem = msgP;
+                        memset(mStr, 0, 5);
+                        memset(IPv6_2, 0, 46);
 
-                // master confirmed our results
-                } else if (strncmp(server_buffer,"rconf",5) == 0) {
-                    rconf = 1;
-                    printf("UDP: master confirmed results, terminating\n");
-                    break; // terminate correctly
-                }
-            }
+                        extractMsgSegment(&mem,codeBuf);    // remove header
+                        extractMsgSegment(&mem,messages);   // heartbeat sequence
+                        extractMsgSegment(&mem,IPv6_2);     // leader address
+                        uint32_t seq = (uint32_t)atoi(messages);
+                        memset(messages, 0, 10);
+                        extractMsgSegment(&mem,messages);   // depth the sender knows of
+                        int depth = atoi(messages);
+                        memset(messages, 0, 10);
 
-            // if running leader election currently
-            if (runningLE) {
+                        if (strcmp(IPv6_2, eng.leader) == 0) {
+                            // the depth only ever grows, so every copy can teach us something
+                            if (depth > hbDepth) {
+                                hbDepth = depth;
+                            }
+                            if (eng.leaderHops > hbDepth) {
+                                hbDepth = eng.leaderHops;
+                            }
 
-                // *** line 5 of pseudocode
-                if (stateLE == 0) { 
-                    if (DEBUG == 1) {
-                        printf("LE: case 0, leader=%s, local_min=%"PRIu32"\n", leaderIPv6, local_min);
-                    }
-                    //le_ack:m;leader;
-                    strcpy(msg, "le_ack;");
-                    sprintf(mStr, "%"PRIu32"",local_min);
-                    strcat(msg,mStr);
-                    strcat(msg,";");
-                    strcat(msg,leaderIPv6);
-                    strcat(msg,";");
-
-                    if (DEBUG == 1) {
-                        printf("LE: sending message %s to all neighbors\n", msg);
-                    }
+                            if (seq > lastHbSeq && strcmp(eng.leader, myIPv6) != 0) {
+                                lastHbSeq = seq;
+                                lastHb = xtimer_now_usec();
+                                heardHb = true;
 
-                    // send initial value to all neighbors
-                    for (i = 0; i < numNeighbors; i++) {
-                        if (strcmp(neighbors[i],"") == 0) {
-                            continue;
+                                sprintf(msg, "hb;%"PRIu32";%s;%d;", seq, eng.leader, hbDepth);
+                                if (eng.gen) {
+                                    char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
+                                    udp_send_multi(3, argsMsg);
+                                } else {
+                                    // the sender only hears it back if we know of a deeper node,
+                                    // that is how the depth works its way in toward the leader
+                                    sendToNeighbors(&eng, msg, (depth < hbDepth) ? NULL : ipv6_unique);
+                                }
+                                memset(msg, 0, SERVER_BUFFER_SIZE);
+                            }
                         }
+                    }
 
-                        if (DEBUG == 1) {
-                            printf(" LE: sending to %s\n", neighbors[i]);
-                        }
+                // a neighbor lost the leader, join the re-election
+                } else if (strncmp(server_buffer,"reelect;",8) == 0) {
+                    if (LE_HEARTBEAT == 1 && eng.state >= LE_STATE_DONE) {
+                        strcpy(msgP, server_buffer);
+                        char *mem = msgP;
 
-                        memset(IPv6_2, 0, 46);
-                        strcat(IPv6_2, ipv6_prefix);
-                        strcat(IPv6_2, neighbors[i]);
+                        extractMsgSegment(&mem,codeBuf);    // remove header
+                        extractMsgSegment(&mem,messages);   // re-election epoch
+                        extractMsgSegment(&mem,IPv6_2);     // the leader that was lost
+                        int reelectNum = atoi(messages);
+                        memset(messages, 0, 10);
 
-                        char *argsMsg[] = { "udp_send", IPv6_2, portBuf, msg, NULL };
-                        udp_send(4, argsMsg);
-                        
-                        xtimer_usleep(1000); // wait 0.001 seconds
+                        // only the lost leader's own nodes re-elect, in cluster mode the other
+                        // heads carry on. If I am that leader someone lost sight of me, so I
+                        // step down rather than lead half the network
+                        if (reelectNum > reelectEpoch && strcmp(IPv6_2, eng.leader) == 0) {
+                            reelectEpoch = reelectNum;
+                            startReelect = true;
+                        }
                     }
 
-                    stateLE = 1;
-                    lastT = xtimer_now_usec();
+                // a node had a failure
+                } else if (strncmp(server_buffer,"failure;",8) == 0) {
+                    LELOG_ERR("ERROR: a node failed and master told us to terminate\n");
+                    break; // terminate with error
 
-                // *** lines 6-7
-                } else if (stateLE == 1) {
-                    if (lastT < xtimer_now_usec() - LE_T) {     // line 6
-                        if (!polled) {
-                            if (!gen) {
-                                strcpy(msg, "le_m?;");
-                                for (i = 0; i < numNeighbors; i++) {    // line 7
-                                    if (neighborsVal[i] == 257) {
-                                        // poll this missing neighbor
+                // results from our subtree, take them if they fit the batch we are building
+                } else if (strncmp(server_buffer,"resb;",5) == 0) {
+                    if (LE_CONVERGECAST == 1 && runningLE) {
+                        char seq[10] = { 0 };
+                        char batchLeader[IPV6_ADDRESS_LEN] = { 0 };
+                        char *mem = server_buffer;
+                        extractMsgSegment(&mem, codeBuf);       // remove header
+                        extractMsgSegment(&mem, seq);           // child's batch number
+                        extractMsgSegment(&mem, batchLeader);   // leader of its records
+
+                        bool wasEmpty = (strcmp(ccBuf, "") == 0);
+                        if (ccAppend(ccBuf, ccLeader, batchLeader, mem)) {
+                            if (wasEmpty) {
+                                ccFirst = xtimer_now_usec();
+                            }
+                            ccLastActivity = xtimer_now_usec();
 
-                                        memset(IPv6_2, 0, 46);
-                                        strcat(IPv6_2, ipv6_prefix);
-                                        strcat(IPv6_2, neighbors[i]);
+                            // no ack means no room, the child will try again
+                            sprintf(msg, "ccack;%s;", seq);
+                            char *argsMsg[] = { "udp_send", IPv6_1, portBuf, msg, NULL };
+                            udp_send(4, argsMsg);
+                            memset(msg, 0, SERVER_BUFFER_SIZE);
+                        }
+                    }
 
-                                        char *argsMsg[] = { "udp_send", IPv6_2, portBuf, msg, NULL };
-                                        udp_send(4, argsMsg);
-                                        xtimer_usleep(1000); // wait 0.001 seconds
-                                    }
-                                }
-                            }
-                            polled = true;
-                            lastT = xtimer_now_usec(); // wait for LE_T
-                        } else {
-                            int quit = 1;
-                            for (i = 0; i < numNeighbors; i++) {    // line 7a and 7ai
-                                if (neighborsVal[i] == 257) {
-                                    // inform master of failure
-                                    //printf("ERROR: we have failed, informing the master\n");
-                                    //strcpy(msg, "failure;");
-                                    //char *argsMsg[] = { "udp_send", masterIPv6, portBuf, msg, NULL };
-                                    //udp_send(4, argsMsg);
-                                    //return NULL;
-
-                                    // for now, don't fail, try to continue on
-                                    printf("ERROR: we did not hear from a node, continuing anyways\n");
-                                } else {
-                                    quit = 0;
-                                }
-                            }
-                            quit = 0;
-                            
-                            if (quit) break;
+                // our parent (or the master) got our batch
+                } else if (strncmp(server_buffer,"ccack;",6) == 0) {
+                    char *mem = server_buffer + 6;
+                    memset(messages, 0, 10);
+                    extractMsgSegment(&mem, messages);
+                    if (ccInFlight && atoi(messages) == ccSeq) {
+                        ccInFlight = false;
+                        if (ccOwn == 2) {
+                            ccOwn = 3;
+                        }
+                        ccLastActivity = xtimer_now_usec();
+                    }
 
-                            stateLE = 2;
-                            lastT = xtimer_now_usec();
+                // the master's bitmap of results it has, we're done once our bit is set
+                } else if (strncmp(server_buffer,"rack;",5) == 0) {
+                    if (LE_CONVERGECAST == 0 && eng.state == LE_STATE_DONE && rconf == 0 && myIndex >= 0) {
+                        char *bits = server_buffer + 5;
+                        int digit = myIndex / 4;
+                        if ((int)strlen(bits) > digit && bits[digit] != ';') {
+                            char nibble[2] = { bits[digit], '\0' };
+                            if ((strtol(nibble, NULL, 16) >> (myIndex % 4)) & 1) {
+                                LELOG_INFO("UDP: master acknowledged our results after %d sends\n", sendRes);
+                                rconf = 1;
+                            }
                         }
-                        
                     }
 
-                // *** lines 8a to 8g
-                } else if (stateLE == 2) { 
-                    if (lastT < xtimer_now_usec() - LE_T) {
+                // master confirmed our results
+                } else if (strncmp(server_buffer,"rconf",5) == 0) {
+                    rconf = 1;
+                    if (LE_HEARTBEAT == 0) {
+                        LELOG_INFO("UDP: master confirmed results, terminating\n");
+                        break; // terminate correctly
+                    }
+                }
+            }
+            if (res >= 1) {
+                LEPROF_STOP(LEPROF_PARSE);
+            }
 
-                        // calculate round local_min, *** line 8a of pseudocode
-                        new_local_min = local_min;
-                        memset(newLeaderIPv6, 0, IPV6_ADDRESS_LEN);
-                        strcpy(newLeaderIPv6, leaderIPv6);
+            // the leader went silent, re-elect among the surviving nodes
+            if (startReelect) {
+                startReelect = false;
+                reelecting = true;
+                detectTimeLE = xtimer_now_usec();
+                memset(failedLeaderIPv6, 0, IPV6_ADDRESS_LEN);
+                strcpy(failedLeaderIPv6, eng.leader);
+                LELOG_INFO("LE: re-election %d, dropping leader %s\n", reelectEpoch, failedLeaderIPv6);
+
+                // bring the rest of the survivors along. The failed leader stays a neighbor,
+                // if it is alive after all it steps down and follows whoever wins
+                sprintf(msg, "reelect;%d;%s;", reelectEpoch, failedLeaderIPv6);
+                if (eng.gen) {
+                    char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
+                    udp_send_multi(3, argsMsg);
+                } else {
+                    sendToNeighbors(&eng, msg, NULL);
+                }
+                memset(msg, 0, SERVER_BUFFER_SIZE);
+
+                // restart from the runner-up, a value can cross the network in 2 * depth rounds
+                int rounds = (hbDepth > 0 && 2*hbDepth + 1 < 255) ? 2*hbDepth + 1 : 0;
+                le_engine_restart(&eng, failedLeaderIPv6, rounds);
+                reelectMsgs = messagesIn + messagesOut;
+                startTimeLE = detectTimeLE;
+                hbSeq = 0;
+                lastHbSeq = 0;
+                heardHb = false;
+                hbDepth = 0;
+            }
 
-                        if (DEBUG == 1) {
-                            printf("\nLE: min/newMin %"PRIu32"/%"PRIu32"\n", local_min, new_local_min);
-                            printf("LE: leader/newLeader, %s/%s\n", leaderIPv6, newLeaderIPv6);
-                        }
+            // if running leader election currently
+            if (runningLE) {
 
-                        for (i = 0; i < numNeighbors; i++) {
-                            if (DEBUG == 1) {
-                                printf(" %d: m=%"PRIu32", curLeader=%s\n", i+1, neighborsVal[i], neighborsLeaders[i]);
-                            }
+                // *** lines 5 to 8g, the engine sends, polls and counts rounds through its callbacks
+                if (eng.state <= LE_STATE_ROUND) {
+                    uint32_t now = xtimer_now_usec();
+                    if (le_engine_round_due(&eng, now)) {
+                        LEPROF_MARK(LEPROF_REDUCE);
+                    }
 
-                            // don't have values from this neighbor, skip them
-                            if (neighborsVal[i] <= 0 || neighborsVal[i] >= 256) {
-                                //printf("  ERROR: stateLE==2, m value is out of range, %"PRIu32"\n", neighborsVal[i]);
-                                continue;
-                            }
+                    // quit, *** lines 8e and 8ei
+                    if (le_engine_tick(&eng, now) == 1) {
+                        LELOG_INFO("LE: counter < 0 so quit\n");
+
+                        // remember the result to seed the next election
+                        warmM = eng.m;
+                        warmMin = eng.localMin;
+                        memset(warmLeaderIPv6, 0, IPV6_ADDRESS_LEN);
+                        strcpy(warmLeaderIPv6, eng.leader);
+                        warmHops = eng.leaderHops;
+
+                        // compute runtime
+                        int digits = 0;
+                        endTimeLE = xtimer_now_usec();
+                        convergenceTimeLE = (endTimeLE - startTimeLE);
+                        energy_snapshot(&energyEnd);
+                        energyLE = energy_between(&energyStart, &energyEnd);
+                        TRACE_EVENT(TRACE_END, 0, trace_id(eng.leader), eng.localMin);
+                        memset(offset, 0, 15);
+                        memset(seconds, 0, 15);
+                        memset(decimal, 0, 15);
+
+                        if (convergenceTimeLE >= 1000000) {
+                            digits = 6;
+                        } else if (convergenceTimeLE >= 100000) {
+                            digits = 5;
+                        } else if (convergenceTimeLE >= 10000) {
+                            digits = 4;
+                        } // smaller shouldn't happen ever
+
+                        if (digits == 6) {
+                            // last 6 is fractional seconds, before that is seconds
+                            sprintf(offset, "%"PRIu32, convergenceTimeLE);
+                            substr(offset, 0, strlen(offset)-6, seconds);
+                            substr(offset, strlen(offset)-6, 6, decimal);
 
-                            // find minimum of neighborhood
-                            if (neighborsVal[i] < new_local_min) {
-                                memset(newLeaderIPv6, 0, IPV6_ADDRESS_LEN);
-                                strcpy(newLeaderIPv6, neighborsLeaders[i]); // new round leader
-                                new_local_min = neighborsVal[i];            // new local_min round value
-                                //printf("LE: new_local_min=%"PRIu32", newLeaderIPv6=%s\n", new_local_min, newLeaderIPv6);
-
-                            // if a tie has occured
-                            } else if (neighborsVal[i] == new_local_min) {
-                                // break the tie
-                                if (strcmp(newLeaderIPv6, neighborsLeaders[i]) > 0) {
-                                    // new guy won the tie
-                                    printf("LE: lost m value tie (%"PRIu32"), %s vs %s\n",new_local_min, newLeaderIPv6, neighborsLeaders[i]);
-                                    memset(newLeaderIPv6, 0, IPV6_ADDRESS_LEN);
-                                    strcpy(newLeaderIPv6, neighborsLeaders[i]);
-                                }
-                            }
+                            memset(offset, 0, 15);
+                            sprintf(offset, "%s.%s", seconds, decimal);
+                        } else if (digits == 5) {
+                            // value is fractional seconds, 0 whole seconds
+                            sprintf(offset, "0.%"PRIu32, convergenceTimeLE);
+                        } else if (digits == 4) {
+                            // whole number is fractional seconds, 0 whole seconds
+                            sprintf(offset, "0.0%"PRIu32, convergenceTimeLE);
                         }
+                    }
 
-                        counter -= 1;       // reduce counter, *** line 8b of pseudocode
-                        printf("LE: counter reduced to %d\n", counter);
-
-                        // new leader found, either by m value or tie break
-                        if (strcmp(leaderIPv6, newLeaderIPv6) != 0) { // *** line 8d of pseudocode
-                            printf("LE: new leader, new_local_min %"PRIu32" < %"PRIu32", heard from %d nodes\n", new_local_min, local_min, countedMs);
+                // protocol complete, *** line 9
+                } else if (eng.state == LE_STATE_DONE) {
+                    if (reelecting) {
+                        // report how long the failover took, measured from the last heartbeat
+                        uint32_t detectDelay = detectTimeLE - lastHb;
+                        uint32_t failoverTime = endTimeLE - lastHb;
+                        tMsgs = messagesIn + messagesOut - reelectMsgs;
+
+                        LELOG_INFO("\nLE: %s re-elected as the leader, via m=%"PRIu32"!\n", eng.leader, eng.localMin);
+                        LELOG_INFO("LE:   detect=%"PRIu32"\n", detectDelay);
+                        LELOG_INFO("LE: failover=%"PRIu32"\n", failoverTime);
+                        LELOG_INFO("LE: messages=%d\n\n", tMsgs);
+
+                        sprintf(msg, "failover;%s;%s;%"PRIu32";%"PRIu32";%d;", eng.leader,
+                                failedLeaderIPv6, detectDelay, failoverTime, tMsgs);
+                        char *argsMsg[] = { "udp_send", masterIPv6, portBuf, msg, NULL };
+                        udp_send(4, argsMsg);
 
-                            local_min = new_local_min;  // *** line 8dii of pseudocode
-                            memset(leaderIPv6, 0, IPV6_ADDRESS_LEN);
-                            strcpy(leaderIPv6, newLeaderIPv6); // *** line 8diii of pseudocode                
+                        reelecting = false;
+                        le_engine_maintain(&eng);
+                        lastHb = xtimer_now_usec();
+                        lastHbSent = 0;
 
-                            // send out new info: le_ack:m;leader;
-                            strcpy(msg, "le_ack;");
-                            sprintf(mStr, "%"PRIu32"",local_min);
-                            strcat(msg,mStr);
-                            strcat(msg,";");
-                            strcat(msg,leaderIPv6);
-                            strcat(msg,";");
+                    // send results with a jittered backoff until acknowledged, or hand them up the tree
+                    } else if (rconf == 0 && sendRes < LE_RES_MAX_TRIES &&
+                               (LE_CONVERGECAST == 1 || sendRes == 0 || (int32_t)(xtimer_now_usec() - resNext) >= 0)) {
+                        // display election result
+                        if (sendRes == 0) {
+                            LELOG_INFO("\nLE: %s elected as the leader, via m=%"PRIu32"!\n", eng.leader, eng.localMin);
+                            if (strcmp(eng.leader, myIPv6) == 0) {
+                                LELOG_INFO("LE: Hey, that's me! I'm the leader!\n");
+                            }
 
-                            if (DEBUG == 1) {
-                                printf("LE: sending message %s to neighbors who need it\n", msg);
+                            tMsgs = messagesIn+messagesOut;
+                            LELOG_INFO("LE:    start=%"PRIu32"\n", startTimeLE);
+                            LELOG_INFO("LE:      end=%"PRIu32"\n", endTimeLE);
+                            LELOG_INFO("LE: converge=%"PRIu32"\n", convergenceTimeLE);
+                            LELOG_INFO("LE: messages=%d\n", tMsgs);
+                            LELOG_INFO("LE:   energy=%"PRIu32" uJ\n", energyLE);
+                            if (eng.trickle.active) {
+                                LELOG_INFO("LE:  trickle=%d sent, %d suppressed\n", eng.trickle.sent, eng.trickle.suppressed);
                             }
+                            LELOG_INFO("\n");
 
-                            // send local_min value to neighbors that don't have it yet
+                            //hasElectedLeader = true;
+                            eng.countedMs = 0;
+                        }
 
-                            if (gen) {
-                                // broadcast
-                                char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
-                                udp_send_multi(3, argsMsg);
-                            } else {
-                                // unicast
-                                for (i = 0; i < numNeighbors; i++) {
-                                    // if neighbor slot is blank, skip
-                                    if (strcmp(neighbors[i],"") == 0) {
-                                        continue;
-                                    }
+                        if (LE_CONVERGECAST == 1) {
+                            sendRes = 1;
 
-                                    // if this neighbor already has the leader, skip
-                                    if (strcmp(neighborsLeaders[i], leaderIPv6) == 0) {
-                                        continue;
+                            // our own record joins the batch headed for the leader
+                            if (ccOwn == 0) {
+                                if (LE_CLUSTER_HOPS > 0) {
+                                    sprintf(msg, "%s,%s,%d,%d,%d;", myIPv6, offset, tMsgs, eng.numNeighbors, eng.leaderHops);
+                                } else {
+                                    sprintf(msg, "%s,%s,%d,%d;", myIPv6, offset, tMsgs, eng.numNeighbors);
+                                }
+                                bool wasEmpty = (strcmp(ccBuf, "") == 0);
+                                if (ccAppend(ccBuf, ccLeader, eng.leader, msg)) {
+                                    if (wasEmpty) {
+                                        ccFirst = xtimer_now_usec();
                                     }
+                                    ccOwn = 1;
+                                }
+                                memset(msg, 0, SERVER_BUFFER_SIZE);
+                            }
 
-                                    if (DEBUG == 1) {
-                                        printf(" LE: sending to %s\n", neighbors[i]);
+                            // give the subtree a moment to add to the batch, then seal it
+                            if (!ccInFlight && strcmp(ccBuf, "") != 0 && xtimer_now_usec() - ccFirst >= LE_CC_HOLD) {
+                                ccSeq++;
+                                snprintf(ccOut, SERVER_BUFFER_SIZE, "resb;%d;%s;%s", ccSeq, ccLeader, ccBuf);
+                                memset(ccBuf, 0, SERVER_BUFFER_SIZE);
+                                if (ccOwn == 1) {
+                                    ccOwn = 2;
+                                }
+                                ccInFlight = true;
+                                ccTries = 0;
+                                ccLastSent = 0;
+                            }
+
+                            if (ccInFlight && (ccLastSent == 0 || xtimer_now_usec() - ccLastSent >= LE_CC_RETRY)) {
+                                if (ccTries >= LE_CC_MAX_TRIES) {
+                                    LELOG_INFO("LE: giving up on results batch %d\n", ccSeq);
+                                    ccInFlight = false;
+                                    if (ccOwn == 2) {
+                                        ccOwn = 3;
+                                    }
+                                } else {
+                                    if (ccTries == LE_CC_PARENT_TRIES && eng.parent >= 0 && !ccDirect) {
+                                        LELOG_INFO("LE: parent %s isn't acknowledging, sending results to master\n", eng.nbr[eng.parent].addr);
+                                        ccDirect = true;
                                     }
 
                                     memset(IPv6_2, 0, 46);
-                                    strcat(IPv6_2, ipv6_prefix);
-                                    strcat(IPv6_2, neighbors[i]);
+                                    if (eng.parent < 0 || ccDirect) {
+                                        strcpy(IPv6_2, masterIPv6);
+                                    } else {
+                                        strcat(IPv6_2, ipv6_prefix);
+                                        strcat(IPv6_2, eng.nbr[eng.parent].addr);
+                                    }
 
-                                    char *argsMsg[] = { "udp_send", IPv6_2, portBuf, msg, NULL };
+                                    LELOG_INFO("LE: attempt %d of sending results batch %d to %s\n", ccTries, ccSeq, IPv6_2);
+                                    char *argsMsg[] = { "udp_send", IPv6_2, portBuf, ccOut, NULL };
                                     udp_send(4, argsMsg);
-                                    
-                                    xtimer_usleep(1000); // wait 0.001 seconds
+                                    ccTries++;
+                                    ccLastSent = xtimer_now_usec();
                                 }
                             }
-                        }
 
-                        // quit, *** lines 8e and 8ei
-                        else if (counter < 0) {
-                            printf("LE: counter < 0 so quit\n");
-                            lastT = 0;
-                            stateLE = 3;
+                            // our record is delivered and the subtree has gone quiet
+                            if (ccOwn == 3 && !ccInFlight && strcmp(ccBuf, "") == 0 &&
+                                    xtimer_now_usec() - ccLastActivity >= LE_CC_LINGER) {
+                                rconf = 1;
+                            }
+                        } else {
+                            // build results package
+                            strcpy(msg, "results;");
+                            strcat(msg, eng.leader);
+                            strcat(msg, ";");
+
+                            // Runtime
+                            strcat(msg, offset);
+                            strcat(msg, ";");
+
+                            memset(messages, 0, 10);
+                            sprintf(messages, "%d" , tMsgs);
+                            strcat(msg, messages);
+                            strcat(msg, ";");
+                            memset(messages, 0, 10);
+                            sprintf(messages, "%d" , eng.numNeighbors);
+                            strcat(msg, messages);
+                            strcat(msg, ";");
+
+                            // cluster mode, how far away our head is
+                            if (LE_CLUSTER_HOPS > 0) {
+                                memset(messages, 0, 10);
+                                sprintf(messages, "%d" , eng.leaderHops);
+                                strcat(msg, messages);
+                                strcat(msg, ";");
+                            }
 
-                            // compute runtime
-                            int digits = 0;
-                            endTimeLE = xtimer_now_usec();
-                            convergenceTimeLE = (endTimeLE - startTimeLE);
-                            memset(offset, 0, 15);
-                            memset(seconds, 0, 15);
-                            memset(decimal, 0, 15);
-
-                            if (convergenceTimeLE >= 1000000) {
-                                digits = 6;
-                            } else if (convergenceTimeLE >= 100000) {
-                                digits = 5;
-                            } else if (convergenceTimeLE >= 10000) {
-                                digits = 4;
-                            } // smaller shouldn't happen ever
-
-                            if (digits == 6) {
-                                // last 6 is fractional seconds, before that is seconds
-                                sprintf(offset, "%"PRIu32, convergenceTimeLE);
-                                substr(offset, 0, strlen(offset)-6, seconds);
-                                substr(offset, strlen(offset)-6, 6, decimal);
-
-                                memset(offset, 0, 15);
-                                sprintf(offset, "%s.%s", seconds, decimal);
-                            } else if (digits == 5) {
-                                // value is fractional seconds, 0 whole seconds
-                                sprintf(offset, "0.%"PRIu32, convergenceTimeLE);
-                            } else if (digits == 4) {
-                                // whole number is fractional seconds, 0 whole seconds
-                                sprintf(offset, "0.0%"PRIu32, convergenceTimeLE);
+                            // which attempt this is, for the master's retry histogram
+                            memset(messages, 0, 10);
+                            sprintf(messages, "%d" , sendRes);
+                            strcat(msg, messages);
+                            strcat(msg, ";");
+
+                            // a few of our counters, so the master can spot starved nodes
+                            char metricsStr[64] = { 0 };
+                            metrics_summary(metricsStr, sizeof(metricsStr));
+                            strcat(msg, metricsStr);
+                            strcat(msg, ";");
+
+                            // estimated radio energy of the election
+                            char energyStr[12] = { 0 };
+                            sprintf(energyStr, "%"PRIu32, energyLE);
+                            strcat(msg, energyStr);
+                            strcat(msg, ";");
+
+                            // start and end on the master's clock with the error bound, as we estimate it now
+                            char syncStr[36] = "-";
+                            if (tsync_synced()) {
+                                sprintf(syncStr, "%"PRIu32",%"PRIu32",%"PRIu32, tsync_global(startTimeLE),
+                                        tsync_global(endTimeLE), tsync_error());
                             }
+                            strcat(msg, syncStr);
+                            strcat(msg, ";");
+
+                            LELOG_INFO("LE: attempt %d of sending results to master\n", sendRes);
 
-                        } 
+                            // send results
+                            char *argsMsg[] = { "udp_send", masterIPv6, portBuf, msg, NULL };
+                            udp_send(4, argsMsg);
 
-                        // *** go to next iteration of psuedocode while loop
-                        if (stateLE == 2) {
-                            countedMs = 0;
-                            lastT = xtimer_now_usec(); 
+                            // back off exponentially, at a random point in the upper half so retries spread out
+                            uint32_t backoff = LE_RES_RETRY_BASE <<
+                                    (sendRes < LE_RES_RETRY_DOUBLINGS ? sendRes : LE_RES_RETRY_DOUBLINGS);
+                            uint32_t extra = random_uint32_range(0, backoff/2);
+                            RECORD_DRAW_VALUE(RECORD_DRAW_RESULTS, extra);
+                            resNext = xtimer_now_usec() + backoff/2 + extra;
+
+                            sendRes += 1;
+                        }
+                    } else if (rconf == 1 || (sendRes >= LE_RES_MAX_TRIES && (int32_t)(xtimer_now_usec() - resNext) >= 0)) {
+                        if (LE_HEARTBEAT == 1) {
+                            LELOG_INFO("LE: entering maintenance, watching leader %s\n", eng.leader);
+                            le_engine_maintain(&eng);
+                            lastHb = xtimer_now_usec();
+                            lastHbSent = 0;
+                        } else {
+                            runningLE = false;
+                            break;
                         }
                     }
 
-                // protocol complete, *** line 9
-                } else if (stateLE == 3) {
-                    // send results every second until confirmed
-                    if (rconf == 0 && lastT < xtimer_now_usec() - 1000000) {
-                        // display election result
-                        if (sendRes == 0) {
-                            printf("\nLE: %s elected as the leader, via m=%"PRIu32"!\n", leaderIPv6, local_min);
-                            if (strcmp(leaderIPv6, myIPv6) == 0) {
-                                printf("LE: Hey, that's me! I'm the leader!\n");
+                // post-election maintenance, watch the leader
+                } else if (eng.state == LE_STATE_MAINT) {
+                    if (strcmp(eng.leader, myIPv6) == 0) {
+                        // I am the leader, let everyone know I am alive
+                        if (lastHbSent == 0 || xtimer_now_usec() - lastHbSent >= LE_HB_PERIOD) {
+                            hbSeq++;
+                            sprintf(msg, "hb;%"PRIu32";%s;%d;", hbSeq, eng.leader, hbDepth);
+                            if (eng.gen) {
+                                char *argsMsg[] = { "udp_send_multi", portBuf, msg, NULL };
+                                udp_send_multi(3, argsMsg);
+                            } else {
+                                sendToNeighbors(&eng, msg, NULL);
                             }
-
-                            tMsgs = messagesIn+messagesOut;
-                            printf("LE:    start=%"PRIu32"\n", startTimeLE);
-                            printf("LE:      end=%"PRIu32"\n", endTimeLE);
-                            printf("LE: converge=%"PRIu32"\n", convergenceTimeLE);
-                            printf("LE: messages=%d\n\n", tMsgs);
-
-                            //hasElectedLeader = true;
-                            countedMs = 0;
+                            lastHbSent = xtimer_now_usec();
                         }
-
-                        // build results package
-                        strcpy(msg, "results;");
-                        strcat(msg, leaderIPv6);
-                        strcat(msg, ";");
-
-                        // Runtime
-                        strcat(msg, offset);
-                        strcat(msg, ";");
-
-                        memset(messages, 0, 10);
-                        sprintf(messages, "%d" , tMsgs);
-                        strcat(msg, messages);
-                        strcat(msg, ";");
-                        memset(messages, 0, 10);
-                        sprintf(messages, "%d" , numNeighbors);
-                        strcat(msg, messages);
-                        strcat(msg, ";");
-
-                        printf("LE: attempt %d of sending results to master\n", sendRes);
-
-                        // send results
-                        char *argsMsg[] = { "udp_send", masterIPv6, portBuf, msg, NULL };
-                        udp_send(4, argsMsg);
-
-                        sendRes += 1;
-                        lastT = xtimer_now_usec(); 
-                    } else if (rconf == 1 || sendRes >= 20) { // try for 20 seconds
-                        runningLE = false;
-                        break;
+                    } else if (xtimer_now_usec() - lastHb > (heardHb ? LE_HB_PERIOD * LE_HB_MISSES : LE_HB_GRACE)) {
+                        if (heardHb) {
+                            LELOG_INFO("LE: missed %d heartbeats from leader %s\n", LE_HB_MISSES, eng.leader);
+                        } else {
+                            LELOG_INFO("LE: never heard a heartbeat from leader %s\n", eng.leader);
+                        }
+                        reelectEpoch++;
+                        startReelect = true;
                     }
                 } else {
-                    printf("ERROR: leader election in invalid state %d\n", stateLE);
+                    LELOG_ERR("ERROR: leader election in invalid state %d\n", eng.state);
                     break;
                 }
             }
@@ -848,24 +1403,9 @@ void *_udp_server(void *args)
         }
 
         // reset variables
-        numNeighbors = 0;
-        //tempNumNeighbors = 0;
-        for(i = 0; i < MAX_NEIGHBORS; i++) {
-            memset(neighbors[i], 0, IPV6_ADDRESS_LEN);
-            //memset(tempNeighbors[i], 0, IPV6_ADDRESS_LEN);
-            memset(neighborsLeaders[i], 0, IPV6_ADDRESS_LEN);
-            neighborsVal[i] = 257;
-        } 
-
-        int z = 20;
-        while (z > 0) {
-            //printf("clearing queue");
-            sock_udp_recv(&my_sock, server_buffer,
-                 SERVER_BUFFER_SIZE - 1, 0, //SOCK_NO_TIMEOUT,
-                 &remote);
-            z -= 1;
-        }
+        le_engine_reset(&eng);
 
+        // no need to drain the socket, anything left over carries an old epoch
         runningLE = false;
         messagesIn = 0;
         messagesOut = 0;
@@ -876,41 +1416,50 @@ void *_udp_server(void *args)
         identComplete = false;
         rconf = 0;
         res = 0;
-        polled = false; 
         sendRes = 0;
+        resNext = 0;
+        myIndex = -1;
 
-        m = 257;
-        local_min = 257; 
-        new_local_min = 257;
-        counter = LE_K;
-        stateLE = 0;
-        countedMs = 0;
-        lastT = 0;
         startTimeLE = 0;
         endTimeLE = 0;
+        energyLE = 0;
         convergenceTimeLE = 0;
 
+        hbSeq = 0;
+        lastHbSeq = 0;
+        lastHb = 0;
+        heardHb = false;
+        hbDepth = 0;
+        lastHbSent = 0;
+        reelectEpoch = 0;
+        reelecting = false;
+        startReelect = false;
+        detectTimeLE = 0;
+        reelectMsgs = 0;
+        pongPending = false;
+        memset(ccBuf, 0, SERVER_BUFFER_SIZE);
+        memset(ccOut, 0, SERVER_BUFFER_SIZE);
+        memset(ccLeader, 0, IPV6_ADDRESS_LEN);
+        ccOwn = 0;
+        ccInFlight = false;
+        ccDirect = false;
+        ccTries = 0;
+        ccFirst = 0;
+        ccLastSent = 0;
+        ccLastActivity = 0;
+        memset(failedLeaderIPv6, 0, IPV6_ADDRESS_LEN);
+
         //memset(masterIPv6, 0, 46);
         //memset(myIPv6, 0, IPV6_ADDRESS_LEN);
-        memset(leaderIPv6, 0, IPV6_ADDRESS_LEN);
-        memset(newLeaderIPv6, 0, IPV6_ADDRESS_LEN);
 
-        strcpy(newLeaderIPv6, "unknown");
-
-        if (DEBUG == 1) {
-            printf("UDP: variables reset, starting new experiment\n");
-        }
+        LELOG_DEBUG("UDP: variables reset, dropped %d stale packets, starting new experiment\n", staleDrops);
+        staleDrops = 0;
+        metrics_new_experiment();
 
         expNum++;
     }
 
     // free memory
-    for(int i = 0; i < MAX_NEIGHBORS; i++) {
-        free(neighbors[i]);
-        free(neighborsLeaders[i]);
-    }
-    free(neighbors);
-    free(neighborsLeaders);
     free(msgP);
 
     return NULL;
@@ -924,6 +1473,8 @@ int udp_send(int argc, char **argv)
 {
     int res;
     sock_udp_ep_t remote = { .family = AF_INET6 };
+    char tagged[SERVER_BUFFER_SIZE+EPOCH_HDR_LEN+TSYNC_HDR_LEN];
+    char stamp[TSYNC_HDR_LEN];
 
     if (argc != 4) {
         (void) puts("UDP: Usage - udp <ipv6-addr> <port> <payload>");
@@ -940,14 +1491,20 @@ int udp_send(int argc, char **argv)
         remote.netif = (uint16_t)netif->pid;
     }
     remote.port = atoi(argv[2]);
-    if((res = sock_udp_send(NULL, argv[3], strlen(argv[3]), &remote)) < 0) {
-        printf("UDP: Error (%d) - could not send message \"%s\" to %s\n", res, argv[3], argv[1]);
+    LEPROF_START(LEPROF_SEND);
+    tsync_stamp(stamp);
+    sprintf(tagged, "%"PRIu32"%s#%s", epoch, stamp, argv[3]);
+    res = sock_udp_send(NULL, tagged, strlen(tagged), &remote);
+    LEPROF_STOP(LEPROF_SEND);
+    if (res < 0) {
+        LELOG_ERR("UDP: Error (%d) - could not send message \"%s\" to %s\n", res, argv[3], argv[1]);
+        metrics_send_fail();
     }
     else {
-        if (DEBUG == 1) {
-            printf("UDP: Success - sent %u bytes to %s\n", (unsigned) res, argv[1]);
-        }
+        LELOG_DEBUG("UDP: Success - sent %u bytes to %s\n", (unsigned) res, argv[1]);
         countMsgOut();
+        metrics_msg_out(argv[3]);
+        TRACE_MSG(TRACE_TX, argv[3], trace_id(argv[1]));
     }
     return 0;
 }
@@ -962,6 +1519,8 @@ int udp_send_multi(int argc, char **argv)
     int res;
     sock_udp_ep_t remote = { .family = AF_INET6 };
     char ipv6[IPV6_ADDRESS_LEN] = { 0 };
+    char tagged[SERVER_BUFFER_SIZE+EPOCH_HDR_LEN+TSYNC_HDR_LEN];
+    char stamp[TSYNC_HDR_LEN];
 
     if (argc != 3) {
         (void) puts("UDP: Usage - udp <port> <payload>");
@@ -977,14 +1536,20 @@ int udp_send_multi(int argc, char **argv)
     }
     remote.port = atoi(argv[1]);
     ipv6_addr_to_str(ipv6, (ipv6_addr_t *)&remote.addr.ipv6, IPV6_ADDRESS_LEN);
-    if((res = sock_udp_send(NULL, argv[2], strlen(argv[2]), &remote)) < 0) {
-        printf("UDP: Error - could not send message \"%s\" to %s\n", argv[2], ipv6);
+    LEPROF_START(LEPROF_SEND);
+    tsync_stamp(stamp);
+    sprintf(tagged, "%"PRIu32"%s#%s", epoch, stamp, argv[2]);
+    res = sock_udp_send(NULL, tagged, strlen(tagged), &remote);
+    LEPROF_STOP(LEPROF_SEND);
+    if (res < 0) {
+        LELOG_ERR("UDP: Error - could not send message \"%s\" to %s\n", argv[2], ipv6);
+        metrics_send_fail();
     }
     else {
-        if (DEBUG == 1) {
-            printf("UDP: Success - sent %u bytes to %s\n", (unsigned)res, ipv6);
-        }
+        LELOG_DEBUG("UDP: Success - sent %u bytes to %s\n", (unsigned)res, ipv6);
         countMsgOut();
+        metrics_msg_out(argv[2]);
+        TRACE_MSG(TRACE_TX, argv[2], TRACE_PEER_MULTICAST);
     }
     return 0;
 }
@@ -1003,6 +1568,9 @@ int udp_server(int argc, char **argv)
 
     kernel_pid_t pid = 0;
     if (server_running == false) {
+        lelog_init();
+        leprof_init();
+        impair_init(&udpImpair, LE_IMPAIR_SEED);
         printf("MAIN: before thread_create\n");
         pid = thread_create(server_stack, sizeof(server_stack), THREAD_PRIORITY_MAIN - 1,
                       THREAD_CREATE_STACKTEST, _udp_server, NULL, "UDP_Server_Thread");